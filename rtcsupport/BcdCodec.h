@@ -0,0 +1,67 @@
+#ifndef BCDCODEC_H
+#define BCDCODEC_H
+
+#include "LocalTypes.h"
+
+namespace rtc
+{
+    namespace bcd
+    {
+        constexpr byte Decode(byte value)
+        {
+            return byte((value >> 4) * 10 + (value & 0x0F));
+        }
+
+        constexpr byte Encode(byte value)
+        {
+            return byte(((value / 10) << 4) | (value % 10));
+        }
+
+        template<int... I>
+        struct Indices
+        {
+        };
+
+        template<int N, int... I>
+        struct MakeIndices : MakeIndices<N - 1, N - 1, I...>
+        {
+        };
+
+        template<int... I>
+        struct MakeIndices<0, I...>
+        {
+            typedef Indices<I...> Type;
+        };
+
+        struct Table
+        {
+            //every byte value, including invalid BCD digits
+            byte Decoded[256];
+            //0-99
+            byte Encoded[100];
+        };
+
+        template<int... D, int... E>
+        constexpr Table MakeTable(Indices<D...>, Indices<E...>)
+        {
+            return Table { { Decode(byte(D))... }, { Encode(byte(E))... } };
+        }
+
+        //built by the compiler, one copy per translation unit
+        constexpr Table Lookup = MakeTable(MakeIndices<256>::Type(), MakeIndices<100>::Type());
+
+        inline byte FromBcd(byte value)
+        {
+            return Lookup.Decoded[value];
+        }
+
+        inline byte ToBcd(byte value)
+        {
+            return value < 100
+                ? Lookup.Encoded[value]
+                : Encode(value);
+        }
+    } //bcd
+} //namespace rtc
+
+#endif // BCDCODEC_H
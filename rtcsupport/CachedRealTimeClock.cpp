@@ -0,0 +1,382 @@
+#include "CachedRealTimeClock.h"
+#include "RealTimeClockPrivate.h"
+#include "LogSupport.h"
+#include <time.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <algorithm>
+
+using namespace rtc;
+
+static const int64_t NsPerSecond = 1000000000LL;
+static const int64_t NsPerMs = 1000000LL;
+
+//never resync more often than the device can change its answer
+static const int MinResyncIntervalMs = 1000;
+
+//alert callbacks can trail the edge they report by a few milliseconds
+static const int64_t EdgeLatencyNs = 5 * NsPerMs;
+
+static int64_t FloorDiv(int64_t value, int64_t divisor)
+{
+    auto result = value / divisor;
+    if (value % divisor < 0)
+    {
+        result -= 1;
+    }
+    return result;
+}
+
+//how far value lies outside [low, high], 0 inside
+static int64_t Beyond(int64_t value, int64_t low, int64_t high)
+{
+    return value > high
+        ? value - high
+        : value < low
+            ? value - low
+            : 0;
+}
+
+CachedRealTimeClock::CachedRealTimeClock(RealTimeClock* clock, const CachedClockOptions& options /*= CachedClockOptions()*/)
+    : _clock(clock),
+      _options(options),
+      _anchored(false),
+      _anchorSeconds(0),
+      _anchorMonotonicNs(0),
+      _anchorDay(0),
+      _anchorAligned(false),
+      _resyncIntervalMs(std::max(options.ResyncIntervalMs, MinResyncIntervalMs)),
+      _resyncDeadlineNs(0),
+      _lastSeconds(0),
+      _edgeSource(nullptr),
+      _lastEdgeNs(0),
+      _appliedEdgeNs(0)
+{
+}
+
+int64_t CachedRealTimeClock::MonotonicNs()
+{
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return int64_t(now.tv_sec) * NsPerSecond + now.tv_nsec;
+}
+
+bool CachedRealTimeClock::Initialize()
+{
+    Invalidate();
+
+    return _clock->Initialize();
+}
+
+void CachedRealTimeClock::Shutdown()
+{
+    Invalidate();
+
+    _clock->Shutdown();
+}
+
+void CachedRealTimeClock::Invalidate()
+{
+    _anchored = false;
+}
+
+RtcClockState CachedRealTimeClock::GetClockState() const
+{
+    return _clock->GetClockState();
+}
+
+bool CachedRealTimeClock::Refresh(int64_t& now) const
+{
+    now = MonotonicNs();
+
+    if (!_anchored || now >= _resyncDeadlineNs)
+    {
+        //keep serving the previous anchor if the device could not be read
+        if (!Resync(now) && !_anchored)
+        {
+            return false;
+        }
+
+        now = MonotonicNs();
+    }
+
+    ApplyEdge();
+
+    return true;
+}
+
+void CachedRealTimeClock::GetDateTime(RtcDateTime& value) const
+{
+    int64_t now;
+
+    if (!Refresh(now))
+    {
+        return;
+    }
+
+    auto seconds = _anchorSeconds + (now - _anchorMonotonicNs) / NsPerSecond;
+    if (seconds != _lastSeconds)
+    {
+        Extrapolate(seconds, _lastValue);
+        _lastSeconds = seconds;
+    }
+
+    value = _lastValue;
+}
+
+int64_t CachedRealTimeClock::GetEpochNanoseconds() const
+{
+    int64_t now;
+
+    if (!Refresh(now))
+    {
+        return 0;
+    }
+
+    return _anchorSeconds * NsPerSecond + (now - _anchorMonotonicNs);
+}
+
+void CachedRealTimeClock::SetDateTime(const RtcDateTime& value)
+{
+    Invalidate();
+
+    _clock->SetDateTime(value);
+}
+
+float CachedRealTimeClock::GetTemperature() const
+{
+    return _clock->GetTemperature();
+}
+
+void CachedRealTimeClock::SetAlarm(AlarmId id, const RtcAlarm& alarm)
+{
+    _clock->SetAlarm(id, alarm);
+}
+
+void CachedRealTimeClock::GetAlarm(AlarmId id, RtcAlarm& alarm) const
+{
+    _clock->GetAlarm(id, alarm);
+}
+
+void CachedRealTimeClock::SetAlarmInterruptState(AlarmInterruptState firstAlarmState, AlarmInterruptState secondAlarmState)
+{
+    _clock->SetAlarmInterruptState(firstAlarmState, secondAlarmState);
+}
+
+AlarmInterruptStatus CachedRealTimeClock::GetAlarmInterruptStatus() const
+{
+    return _clock->GetAlarmInterruptStatus();
+}
+
+AlarmTriggerState CachedRealTimeClock::GetAlarmTriggerState() const
+{
+    return _clock->GetAlarmTriggerState();
+}
+
+void CachedRealTimeClock::SetSquareWave(SquareWaveRate rate)
+{
+    _clock->SetSquareWave(rate);
+}
+
+bool CachedRealTimeClock::AttachEdgeSource(RtcEdgeSource* source)
+{
+    DetachEdgeSource();
+
+    auto started = source->Start([this](int64_t monotonicNs)
+    {
+        _lastEdgeNs.store(monotonicNs, std::memory_order_release);
+    });
+
+    if (started)
+    {
+        _edgeSource = source;
+    }
+
+    return started;
+}
+
+void CachedRealTimeClock::DetachEdgeSource()
+{
+    if (_edgeSource == nullptr)
+    {
+        return;
+    }
+
+    _edgeSource->Stop();
+    _edgeSource = nullptr;
+
+    _lastEdgeNs.store(0, std::memory_order_release);
+    _appliedEdgeNs = 0;
+}
+
+//move the anchor onto the latest edge, which marks a second boundary
+void CachedRealTimeClock::ApplyEdge() const
+{
+    auto edgeNs = _lastEdgeNs.load(std::memory_order_acquire);
+    if (edgeNs == _appliedEdgeNs || !_anchored)
+    {
+        return;
+    }
+
+    _appliedEdgeNs = edgeNs;
+
+    auto predictedNs = _anchorSeconds * NsPerSecond + (edgeNs - _anchorMonotonicNs);
+
+    //an aligned anchor predicts the boundary to within jitter, so take the
+    //nearest second. An unaligned anchor sits somewhere inside its second,
+    //so the edge is the first boundary after it.
+    _anchorSeconds = _anchorAligned
+        ? FloorDiv(predictedNs + NsPerSecond / 2, NsPerSecond)
+        : FloorDiv(predictedNs + NsPerSecond - 1, NsPerSecond);
+    _anchorMonotonicNs = edgeNs;
+    _anchorAligned = true;
+}
+
+//read the device and note the monotonic time half way through the read
+bool CachedRealTimeClock::ReadDevice(RtcDateTime& value, int64_t& monotonicNs) const
+{
+    RtcDateTime probe;
+
+    auto before = MonotonicNs();
+    _clock->GetDateTime(probe);
+    auto after = MonotonicNs();
+
+    //the clock leaves the value untouched when the read fails
+    if (probe.Month == Months::None)
+    {
+        return false;
+    }
+
+    value = probe;
+    monotonicNs = before + (after - before) / 2;
+
+    return true;
+}
+
+bool CachedRealTimeClock::Resync(int64_t now) const
+{
+    RtcDateTime observed;
+    int64_t observedNs;
+
+    if (!ReadDevice(observed, observedNs))
+    {
+        logError << "rtc resync failed, retrying in " << MinResyncIntervalMs << "ms";
+
+        _resyncDeadlineNs = now + MinResyncIntervalMs * NsPerMs;
+        return false;
+    }
+
+    auto aligned = false;
+
+    if (_edgeSource != nullptr)
+    {
+        //a read that completes inside the second started by the last edge
+        //shows that second, so the edge is the anchor
+        auto edgeNs = _lastEdgeNs.load(std::memory_order_acquire);
+        if (edgeNs != 0 &&
+            edgeNs < observedNs &&
+            observedNs - edgeNs < NsPerSecond - EdgeLatencyNs)
+        {
+            observedNs = edgeNs;
+            aligned = true;
+        }
+
+        _appliedEdgeNs = edgeNs;
+    }
+    else if (_options.AlignToRollover)
+    {
+        //the rollover lies between the last read that showed the old
+        //second and the first read that shows the new one
+        auto previousNs = observedNs;
+        auto limitNs = observedNs + 2 * NsPerSecond;
+
+        RtcDateTime next;
+        int64_t nextNs;
+
+        while (previousNs < limitNs)
+        {
+            usleep(_options.RolloverPollUs);
+
+            if (!ReadDevice(next, nextNs))
+            {
+                break;
+            }
+
+            if (next.Time.Second != observed.Time.Second)
+            {
+                observed = next;
+                observedNs = previousNs + (nextNs - previousNs) / 2;
+                aligned = true;
+                break;
+            }
+
+            previousNs = nextNs;
+        }
+    }
+
+    auto observedSeconds = pvt::ToEpochSeconds(observed);
+
+    if (_anchored)
+    {
+        auto predictedNs = _anchorSeconds * NsPerSecond + (observedNs - _anchorMonotonicNs);
+
+        //An unaligned anchor trails the device by an unknown part of a
+        //second, and without a rollover the device only tells us the whole
+        //second. Differences those explain are phase, not drift.
+        auto errorMs = aligned
+            ? (observedSeconds * NsPerSecond - predictedNs) / NsPerMs
+            : (observedSeconds - FloorDiv(predictedNs, NsPerSecond)) * 1000;
+
+        if (aligned && !_anchorAligned)
+        {
+            errorMs = Beyond(errorMs, 0, 1000);
+        }
+        else if (!aligned)
+        {
+            errorMs = Beyond(errorMs, _anchorAligned ? -1000 : 0, 1000);
+        }
+
+        if (llabs(errorMs) > _options.DriftBoundMs)
+        {
+            _resyncIntervalMs = std::max(_resyncIntervalMs / 2, MinResyncIntervalMs);
+
+            logInfo << "rtc drift " << errorMs << "ms exceeds "
+                << _options.DriftBoundMs << "ms, resync interval now "
+                << _resyncIntervalMs << "ms";
+        }
+        else if (_resyncIntervalMs < _options.ResyncIntervalMs)
+        {
+            _resyncIntervalMs = std::min(_resyncIntervalMs * 2, _options.ResyncIntervalMs);
+        }
+    }
+
+    _anchorValue = observed;
+    _anchorSeconds = observedSeconds;
+    _anchorMonotonicNs = observedNs;
+    _anchorDay = FloorDiv(observedSeconds, 86400);
+    _anchorAligned = aligned;
+    _anchored = true;
+
+    _lastValue = observed;
+    _lastSeconds = observedSeconds;
+
+    _resyncDeadlineNs = observedNs + _resyncIntervalMs * NsPerMs;
+
+    return true;
+}
+
+void CachedRealTimeClock::Extrapolate(int64_t seconds, RtcDateTime& value) const
+{
+    pvt::FromEpochSeconds(seconds, _anchorValue.Time.Mode, value);
+
+    //the weekday register is user defined, so advance the anchored
+    //weekday rather than trusting the calendar
+    if (_anchorValue.WeekDay != DayOfWeek::None)
+    {
+        auto dayOffset = FloorDiv(seconds, 86400) - _anchorDay;
+        auto weekDay = (int(_anchorValue.WeekDay) - int(DayOfWeek::Sun) + dayOffset % 7 + 7) % 7;
+
+        value.WeekDay = DayOfWeek(weekDay + int(DayOfWeek::Sun));
+    }
+}
@@ -0,0 +1,130 @@
+#if !defined(CACHEDREALTIMECLOCK_H)
+#define CACHEDREALTIMECLOCK_H
+
+#include "LocalTypes.h"
+#include "RealTimeClock.h"
+#include "RtcEdgeSource.h"
+#include "RtcTimestamp.h"
+#include <stdint.h>
+#include <atomic>
+
+namespace rtc
+{
+    struct CachedClockOptions
+    {
+        //how long an anchor is trusted before the device is read again
+        int ResyncIntervalMs;
+
+        //largest tolerated difference between the extrapolated time and
+        //the device at a resync. Exceeding it shortens the resync interval.
+        int DriftBoundMs;
+
+        //Poll the seconds register until it rolls over so the anchor sits
+        //on a second boundary instead of somewhere inside the second. The
+        //polling happens in whichever GetDateTime call resyncs, and takes
+        //up to a second of device reads every RolloverPollUs, so it is off
+        //by default. Not needed once an edge source is attached.
+        bool AlignToRollover;
+        int RolloverPollUs;
+
+        CachedClockOptions() :
+            ResyncIntervalMs(60000),
+            DriftBoundMs(50),
+            AlignToRollover(false),
+            RolloverPollUs(1000)
+        {
+        }
+    };
+
+    //Serves GetDateTime from CLOCK_MONOTONIC, extrapolated from a single
+    //device read, and only goes back to the device once the resync
+    //interval expires. Every other call is forwarded unchanged.
+    //
+    //With an edge source on the 1Hz square wave every rollover re-phases
+    //the extrapolation, and device reads are taken just after an edge so
+    //the anchor lands on the second boundary.
+    //
+    //Not thread safe: the cached state is updated by the const reads, so
+    //calls must come from one thread at a time. Only the edge callback
+    //may run on another thread.
+    class CachedRealTimeClock : public RealTimeClock
+    {
+        RealTimeClock* _clock;
+        CachedClockOptions _options;
+
+        mutable bool _anchored;
+        mutable RtcDateTime _anchorValue;
+        mutable int64_t _anchorSeconds;
+        mutable int64_t _anchorMonotonicNs;
+        mutable int64_t _anchorDay;
+        mutable bool _anchorAligned;
+
+        mutable int _resyncIntervalMs;
+        mutable int64_t _resyncDeadlineNs;
+
+        //last value handed out, reused while the second has not changed
+        mutable int64_t _lastSeconds;
+        mutable RtcDateTime _lastValue;
+
+        RtcEdgeSource* _edgeSource;
+        std::atomic<int64_t> _lastEdgeNs;
+        mutable int64_t _appliedEdgeNs;
+
+    public:
+        CachedRealTimeClock(RealTimeClock* clock, const CachedClockOptions& options = CachedClockOptions());
+
+        bool Initialize();
+        void Shutdown();
+
+        RtcClockState GetClockState() const;
+
+        void GetDateTime(RtcDateTime& value) const;
+        void SetDateTime(const RtcDateTime& value);
+
+        float GetTemperature() const;
+
+        void SetAlarm(AlarmId id, const RtcAlarm& alarm);
+        void GetAlarm(AlarmId id, RtcAlarm& alarm) const;
+
+        void SetAlarmInterruptState(AlarmInterruptState firstAlarmState, AlarmInterruptState secondAlarmState);
+        AlarmInterruptStatus GetAlarmInterruptStatus() const;
+
+        AlarmTriggerState GetAlarmTriggerState() const;
+
+        void SetSquareWave(SquareWaveRate rate);
+
+        //Phase align to the seconds rollover reported by an edge source
+        //watching the square wave output, which must run at 1Hz.
+        bool AttachEdgeSource(RtcEdgeSource* source);
+        void DetachEdgeSource();
+
+        //extrapolated device time in nanoseconds since the epoch, with the
+        //device time taken as UTC. Returns 0 if the device cannot be read.
+        int64_t GetEpochNanoseconds() const;
+
+        RtcTimestamp GetTimestamp() const
+        {
+            return RtcTimestamp(GetEpochNanoseconds());
+        }
+
+        //drop the anchor so the next GetDateTime reads the device
+        void Invalidate();
+
+        //current resync interval, shortened while drift exceeds the bound
+        int ResyncIntervalMs() const
+        {
+            return _resyncIntervalMs;
+        }
+
+        static int64_t MonotonicNs();
+
+    private:
+        bool Refresh(int64_t& now) const;
+        void ApplyEdge() const;
+        bool Resync(int64_t now) const;
+        bool ReadDevice(RtcDateTime& value, int64_t& monotonicNs) const;
+        void Extrapolate(int64_t seconds, RtcDateTime& value) const;
+    };
+} //namespace rtc
+
+#endif //CACHEDREALTIMECLOCK_H
@@ -0,0 +1,98 @@
+#include "DS3231AsyncClock.h"
+
+#if defined(RTC_COROUTINES)
+
+#include "DS3231RealTimeClock.h"
+#include "DS3231TimeCodec.h"
+
+using namespace rtc;
+
+DS3231AsyncClock::DS3231AsyncClock(RtcEventLoop& loop, I2CAsyncBus& adapter, I2CBus* device /*= nullptr*/)
+    : _loop(&loop),
+      _adapter(&adapter),
+      _device(device != nullptr ? device : adapter.Bus())
+{
+}
+
+RtcTask<Status> DS3231AsyncClock::Submit(DS3231RegisterCache::Request request)
+{
+    if (request.Empty())
+    {
+        co_return Status::Ok;
+    }
+
+    _transaction.Clear();
+
+    if (!_cache.Queue(_transaction, request))
+    {
+        co_return Status::Fail;
+    }
+
+    auto result = co_await _loop->Transfer(*_adapter, *_device, _transaction);
+
+    _cache.Complete(request, result);
+
+    co_return result;
+}
+
+RtcTask<Status> DS3231AsyncClock::GetDateTime(RtcDateTime& value)
+{
+    auto result = co_await Submit(_cache.FetchRequest(DS3231RegisterId::Seconds, DS3231RegisterId::Year));
+    if (result == Status::Ok)
+    {
+        DS3231TimeCodec::Decode(_cache.Registers().AddressOf(DS3231RegisterId::Seconds), value);
+    }
+
+    co_return result;
+}
+
+RtcTask<Status> DS3231AsyncClock::SetDateTime(RtcDateTime value)
+{
+    DS3231TimeCodec::Encode(value, _cache.Registers().AddressOf(DS3231RegisterId::Seconds));
+
+    //as DS3231RealTimeClock, the time goes out with the control/status fetch
+    _cache.MarkDirty(DS3231RegisterId::Seconds, DS3231RegisterId::Year);
+
+    auto result = co_await Submit(_cache.SyncRequest(DS3231RegisterId::Control, DS3231RegisterId::Status));
+    if (result != Status::Ok)
+    {
+        co_return result;
+    }
+
+    DS3231RealTimeClock::MarkTimeValid(_cache);
+
+    co_return co_await Submit(_cache.FlushRequest());
+}
+
+RtcTask<Status> DS3231AsyncClock::GetTemperature(float& celsius)
+{
+    auto result = co_await Submit(_cache.FetchRequest(DS3231RegisterId::TempMsb, DS3231RegisterId::TempLsb));
+    if (result == Status::Ok)
+    {
+        celsius = DS3231RealTimeClock::DecodeTemperature(_cache.Registers());
+    }
+
+    co_return result;
+}
+
+RtcTask<Status> DS3231AsyncClock::SetAlarm(AlarmId id, RtcAlarm alarm)
+{
+    DS3231RealTimeClock::EncodeAlarm(id, alarm, _cache);
+
+    co_return co_await Submit(_cache.FlushRequest());
+}
+
+RtcTask<Status> DS3231AsyncClock::GetAlarmTriggerState(AlarmTriggerState& state)
+{
+    auto result = co_await Submit(_cache.FetchRequest(DS3231RegisterId::Status, DS3231RegisterId::Status));
+    if (result != Status::Ok)
+    {
+        co_return result;
+    }
+
+    state = DS3231RealTimeClock::TakeTriggerState(_cache);
+
+    co_return co_await Submit(_cache.FlushRequest());
+}
+
+#endif // RTC_COROUTINES
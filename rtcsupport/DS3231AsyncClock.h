@@ -0,0 +1,57 @@
+#ifndef DS3231ASYNCCLOCK_H
+#define DS3231ASYNCCLOCK_H
+
+#include "RtcEventLoop.h"
+
+#if defined(RTC_COROUTINES)
+
+#include "RtcTime.h"
+#include "RtcAlarm.h"
+#include "DS3231RegisterCache.h"
+
+namespace rtc
+{
+    //co_await-able DS3231 operations. Each one queues the same transfers
+    //as DS3231RealTimeClock and suspends while they are on the bus, so a
+    //single RtcEventLoop thread can run sessions for hundreds of clocks.
+    //
+    //Operations on one clock must not overlap: await each one before
+    //starting the next. Out parameters must outlive the operation.
+    class DS3231AsyncClock
+    {
+        RtcEventLoop* _loop;
+        I2CAsyncBus* _adapter;
+        I2CBus* _device;
+
+        DS3231RegisterCache _cache;
+        I2CTransaction _transaction;
+
+    public:
+        //device is the clock's bus when it is not the adapter's own
+        DS3231AsyncClock(RtcEventLoop& loop, I2CAsyncBus& adapter, I2CBus* device = nullptr);
+
+        DS3231AsyncClock(const DS3231AsyncClock&) = delete;
+
+        void InvalidateCache()
+        {
+            _cache.Invalidate();
+        }
+
+        RtcTask<Status> GetDateTime(RtcDateTime& value);
+        RtcTask<Status> SetDateTime(RtcDateTime value);
+
+        RtcTask<Status> GetTemperature(float& celsius);
+
+        RtcTask<Status> SetAlarm(AlarmId id, RtcAlarm alarm);
+
+        //clears the alarm flags that were set
+        RtcTask<Status> GetAlarmTriggerState(AlarmTriggerState& state);
+
+    private:
+        RtcTask<Status> Submit(DS3231RegisterCache::Request request);
+    };
+} //namespace rtc
+
+#endif // RTC_COROUTINES
+
+#endif // DS3231ASYNCCLOCK_H
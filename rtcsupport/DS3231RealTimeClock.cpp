@@ -3,6 +3,7 @@
 #include "I2CBus.h"
 #include "LogSupport.h"
 #include "DS3231RegisterSet.h"
+#include "DS3231TimeCodec.h"
 
 using namespace rtc;
 using namespace google;
@@ -18,6 +19,8 @@ DS3231RealTimeClock::~DS3231RealTimeClock()
 
 bool DS3231RealTimeClock::Initialize()
 {
+    _cache.Invalidate();
+
     return true;
 }
 
@@ -25,12 +28,16 @@ void DS3231RealTimeClock::Shutdown()
 {
 }
 
+void DS3231RealTimeClock::InvalidateCache()
+{
+    _cache.Invalidate();
+}
+
 RtcClockState DS3231RealTimeClock::GetClockState() const
 {
-    DS3231RegisterSet r;
-    DS3231RegisterSet registers;
+    auto& registers = _cache.Registers();
 
-    if (registers.Read(_bus, DS3231RegisterId::Control) != Status::Ok)
+    if (_cache.Fetch(_bus, DS3231RegisterId::Status) != Status::Ok)
 	{
 		return RtcClockState::Unknown;
 	}
@@ -44,126 +51,78 @@ RtcClockState DS3231RealTimeClock::GetClockState() const
 
 void DS3231RealTimeClock::GetDateTime(RtcDateTime& value) const
 {
-    DS3231RegisterSet registers;
+    auto& registers = _cache.Registers();
 	
-    if (registers.Read(_bus, DS3231RegisterId::Seconds, 7) != Status::Ok)
+    if (_cache.Fetch(_bus, DS3231RegisterId::Seconds, DS3231RegisterId::Year) != Status::Ok)
 	{
 		return;
 	}
 	
-    value.Time.Second = registers.FromBcd(DS3231RegisterId::Seconds, DS3231RegisterMasks::SecondsMsb, DS3231RegisterMasks::SecondsLsb);
-    value.Time.Minute = registers.FromBcd(DS3231RegisterId::Minutes, DS3231RegisterMasks::MinutesMsb, DS3231RegisterMasks::MinutesLsb);
-	
-    value.Time.Mode = registers.IsBitSet(DS3231RegisterId::Hours, DS3231RegisterMasks::HourMode)
-		? ClockMode::WallClock
-		: ClockMode::MilitaryClock;
-	
-	value.Time.Period = Meridiem::None;
-	if (value.Time.Mode == ClockMode::WallClock)
-	{
-        value.Time.Period = registers.IsBitSet(DS3231RegisterId::Hours, DS3231RegisterMasks::HourPeriod)
-			? Meridiem::Pm
-			: Meridiem::Am;
-        value.Time.Hour = registers.FromBcd(DS3231RegisterId::Hours, DS3231RegisterMasks::HourWallMsb, DS3231RegisterMasks::HourLsb);
-	}
-	else
-	{
-        value.Time.Hour = registers.FromBcd(DS3231RegisterId::Hours, DS3231RegisterMasks::HourLinearMsb, DS3231RegisterMasks::HourLsb);
-	}	
-	
-	
-    value.WeekDay = pvt::ToDayOfWeek(registers.Masked(DS3231RegisterId::WeekDay, DS3231RegisterMasks::WeekDay));
-    value.Day = registers.FromBcd(DS3231RegisterId::Date, DS3231RegisterMasks::DateMsb, DS3231RegisterMasks::DateLsb);
-    value.Month = pvt::ToMonth(registers.FromBcd(DS3231RegisterId::Month, DS3231RegisterMasks::MonthMsb, DS3231RegisterMasks::MonthLsb));
-    value.Year = registers.FromBcd(DS3231RegisterId::Year, DS3231RegisterMasks::YearMsb, DS3231RegisterMasks::YearLsb);
-	
-    value.Year += registers.IsBitSet(DS3231RegisterId::Month, DS3231RegisterMasks::MonthCentury)
-		? 2000
-		: 1900;
+    DS3231TimeCodec::Decode(registers.AddressOf(DS3231RegisterId::Seconds), value);
 }
 
 void DS3231RealTimeClock::SetDateTime(const RtcDateTime& value)
 {
-    DS3231RegisterSet registers;
-	
-    registers.ToBcd(DS3231RegisterId::Seconds, value.Time.Second, DS3231RegisterMasks::SecondsMsb, DS3231RegisterMasks::SecondsLsb);
-    registers.ToBcd(DS3231RegisterId::Minutes, value.Time.Minute, DS3231RegisterMasks::MinutesMsb, DS3231RegisterMasks::MinutesLsb);
-	
-	if (value.Time.Mode == ClockMode::WallClock)
-	{
-        registers.ApplyBit(DS3231RegisterId::Hours, DS3231RegisterMasks::HourMode);
-		if (value.Time.Period == Meridiem::Pm)
-		{
-            registers.ApplyBit(DS3231RegisterId::Hours, DS3231RegisterMasks::HourPeriod);
-		}
-		
-        registers.ToBcd(DS3231RegisterId::Hours, value.Time.Hour, DS3231RegisterMasks::HourWallMsb, DS3231RegisterMasks::HourLsb);
-	}
-    else
-    {
-        registers.ToBcd(DS3231RegisterId::Hours, value.Time.Hour, DS3231RegisterMasks::HourLinearMsb, DS3231RegisterMasks::HourLsb);
-    }
+    auto& registers = _cache.Registers();
 
-    registers[DS3231RegisterId::WeekDay] = pvt::FromDayOfWeek(value.WeekDay);
-    registers.ToBcd(DS3231RegisterId::Date, value.Day, DS3231RegisterMasks::DateMsb, DS3231RegisterMasks::DateLsb);
+    DS3231TimeCodec::Encode(value, registers.AddressOf(DS3231RegisterId::Seconds));
 
-    auto year = value.Year;
-    if (year >= 2000)
-    {
-        year -= 2000;
-        registers.ApplyBit(DS3231RegisterId::Month, DS3231RegisterMasks::MonthCentury);
-    }
-    else
+    //write the time and fetch the control/status pair in one transfer,
+    //control is served from the shadow once it has been read
+    _cache.MarkDirty(DS3231RegisterId::Seconds, DS3231RegisterId::Year);
+
+    if (_cache.Sync(_bus, DS3231RegisterId::Control, DS3231RegisterId::Status) != Status::Ok)
     {
-        year -= 1900;
+        return;
     }
 
-    registers.ToBcd(DS3231RegisterId::Month, pvt::FromMonth(value.Month), DS3231RegisterMasks::MonthMsb, DS3231RegisterMasks::MonthLsb);
-
-    registers.ToBcd(DS3231RegisterId::Year, year, DS3231RegisterMasks::YearMsb, DS3231RegisterMasks::YearLsb);
+    MarkTimeValid(_cache);
 
-    registers.Write(_bus, DS3231RegisterId::Seconds, DS3231RegisterId::Year);
+    _cache.Flush(_bus);
+}
 
-    registers.Read(_bus, DS3231RegisterId::Control, DS3231RegisterId::Status);
+void DS3231RealTimeClock::MarkTimeValid(DS3231RegisterCache& cache)
+{
+    auto& registers = cache.Registers();
 
     auto oscDisabledOnBattery = registers.IsBitSet(DS3231RegisterId::Control, DS3231RegisterMasks::ControlDisableOscBat);
     auto oscStopped = registers.IsBitSet(DS3231RegisterId::Status, DS3231RegisterMasks::StatusOscStopped);
-	
+
 	//if the clock time was invalid, clear the invalid state
     if (oscStopped)
 	{
         registers.RemoveBit(DS3231RegisterId::Status, DS3231RegisterMasks::StatusOscStopped);
-        registers.Write(_bus, DS3231RegisterId::Status);
+        cache.MarkDirty(DS3231RegisterId::Status);
 	}
 	
     if (oscDisabledOnBattery)
 	{
         registers.RemoveBit(DS3231RegisterId::Control, DS3231RegisterMasks::ControlDisableOscBat);
-        registers.Write(_bus, DS3231RegisterId::Control);
+        cache.MarkDirty(DS3231RegisterId::Control);
 	}
 }
 
 float DS3231RealTimeClock::GetTemperature() const
 {
-    DS3231RegisterSet registers;
+    auto& registers = _cache.Registers();
+
+    //the shadow still holds the last reading, report 0 as the uncached
+    //reads did
+    if (_cache.Fetch(_bus, DS3231RegisterId::TempMsb, DS3231RegisterId::TempLsb) != Status::Ok)
+    {
+        return 0;
+    }
+
+    return DecodeTemperature(registers);
+}
+
+float DS3231RealTimeClock::DecodeTemperature(const DS3231RegisterSet& registers)
+{
+    //10 bit two's complement in quarter degrees, left aligned over MSB/LSB
+    auto raw = int16_t((registers[DS3231RegisterId::TempMsb] << 8) | registers[DS3231RegisterId::TempLsb]);
+
+    auto temp = (raw >> 6) * 0.25f;
 
-    registers.Read(_bus, DS3231RegisterId::TempMsb, DS3231RegisterId::TempLsb);
-	
-    auto tempLsb = registers[DS3231RegisterId::TempLsb] >> 6;
-    auto tempMsb = registers.Masked(DS3231RegisterId::TempMsb, DS3231RegisterMasks::TempMsb);
-    auto isNegative = registers.IsBitSet(DS3231RegisterId::TempMsb, DS3231RegisterMasks::TempSign);
-	
-    if (isNegative)
-	{
-		tempMsb = ~tempMsb + 1;
-	}
-	
-	auto temp = float(tempMsb) + (0.25 * tempLsb);
-    if (isNegative)
-	{
-		temp = -temp;
-	}
-	
 	return temp;
 }
 
@@ -193,7 +152,14 @@ void SetAlarmValue(DS3231RegisterSet& registers, DS3231RegisterId reg, AlarmInte
 
 void DS3231RealTimeClock::SetAlarm(AlarmId id, const RtcAlarm& alarm)
 {
-    DS3231RegisterSet registers;
+    EncodeAlarm(id, alarm, _cache);
+
+    _cache.Flush(_bus);
+}
+
+void DS3231RealTimeClock::EncodeAlarm(AlarmId id, const RtcAlarm& alarm, DS3231RegisterCache& cache)
+{
+    auto& registers = cache.Registers();
 
     DS3231RegisterId minuteRegister;
     DS3231RegisterId hourRegister;
@@ -205,6 +171,8 @@ void DS3231RealTimeClock::SetAlarm(AlarmId id, const RtcAlarm& alarm)
         hourRegister = DS3231RegisterId::Alarm1Hours;
         dateRegister = DS3231RegisterId::Alarm1Day;
 
+        registers.Clear(DS3231RegisterId::Alarm1Seconds, DS3231RegisterId::Alarm1Day);
+
         SetAlarmValue(registers, DS3231RegisterId::Alarm1Seconds, alarm.Interval, AlarmInterval::Seconds,
                  alarm.Second, DS3231RegisterMasks::Alarm1SecondsLsb, DS3231RegisterMasks::Alarm1SecondsMsb);
     }
@@ -213,6 +181,8 @@ void DS3231RealTimeClock::SetAlarm(AlarmId id, const RtcAlarm& alarm)
         minuteRegister = DS3231RegisterId::Alarm2Minutes;
         hourRegister = DS3231RegisterId::Alarm2Hours;
         dateRegister = DS3231RegisterId::Alarm2Day;
+
+        registers.Clear(DS3231RegisterId::Alarm2Minutes, DS3231RegisterId::Alarm2Day);
     }
 
     SetAlarmValue(registers, minuteRegister, alarm.Interval, AlarmInterval::Minutes,
@@ -261,11 +231,11 @@ void DS3231RealTimeClock::SetAlarm(AlarmId id, const RtcAlarm& alarm)
 
     if (id == AlarmId::First)
     {
-        registers.Write(_bus, DS3231RegisterId::Alarm1Seconds, DS3231RegisterId::Alarm1Day);
+        cache.MarkDirty(DS3231RegisterId::Alarm1Seconds, DS3231RegisterId::Alarm1Day);
     }
     else
     {
-        registers.Write(_bus, DS3231RegisterId::Alarm2Minutes, DS3231RegisterId::Alarm2Day);
+        cache.MarkDirty(DS3231RegisterId::Alarm2Minutes, DS3231RegisterId::Alarm2Day);
     }
 }
 
@@ -300,7 +270,7 @@ static AlarmInterval DetermineInterval(const DS3231RegisterSet& registers, Alarm
 
 void DS3231RealTimeClock::GetAlarm(AlarmId id, RtcAlarm& alarm) const
 {
-    DS3231RegisterSet registers;
+    auto& registers = _cache.Registers();
 
     DS3231RegisterId minuteRegister;
     DS3231RegisterId hourRegister;
@@ -312,7 +282,10 @@ void DS3231RealTimeClock::GetAlarm(AlarmId id, RtcAlarm& alarm) const
         hourRegister = DS3231RegisterId::Alarm1Hours;
         dateRegister = DS3231RegisterId::Alarm1Day;
 
-        registers.Read(_bus, DS3231RegisterId::Alarm1Seconds, DS3231RegisterId::Alarm1Day);
+        if (_cache.Fetch(_bus, DS3231RegisterId::Alarm1Seconds, DS3231RegisterId::Alarm1Day) != Status::Ok)
+        {
+            return;
+        }
 
         if (alarm.Interval >= AlarmInterval::Seconds)
         {
@@ -325,7 +298,10 @@ void DS3231RealTimeClock::GetAlarm(AlarmId id, RtcAlarm& alarm) const
         hourRegister = DS3231RegisterId::Alarm2Hours;
         dateRegister = DS3231RegisterId::Alarm2Day;
 
-        registers.Read(_bus, DS3231RegisterId::Alarm2Minutes, DS3231RegisterId::Alarm2Day);
+        if (_cache.Fetch(_bus, DS3231RegisterId::Alarm2Minutes, DS3231RegisterId::Alarm2Day) != Status::Ok)
+        {
+            return;
+        }
     }
 
     alarm.Interval = DetermineInterval(registers, id, minuteRegister, hourRegister, dateRegister);
@@ -375,22 +351,39 @@ void DS3231RealTimeClock::GetAlarm(AlarmId id, RtcAlarm& alarm) const
 
 void DS3231RealTimeClock::SetAlarmInterruptState(AlarmInterruptState firstAlarmState, AlarmInterruptState secondAlarmState)
 {
-    DS3231RegisterSet registers;
+    auto& registers = _cache.Registers();
+
+    if (_cache.Fetch(_bus, DS3231RegisterId::Control) != Status::Ok)
+    {
+        return;
+    }
 
-    registers.Read(_bus, DS3231RegisterId::Control);
+    auto control = registers[DS3231RegisterId::Control];
 
     registers.SetBit(DS3231RegisterId::Control, firstAlarmState == AlarmInterruptState::On, DS3231RegisterMasks::ControlAlarm1IntEnable);
     registers.SetBit(DS3231RegisterId::Control, secondAlarmState == AlarmInterruptState::On, DS3231RegisterMasks::ControlAlarm2IntEnable);
 
-    registers.Write(_bus, DS3231RegisterId::Control);
+    //nothing to write if the interrupt enables did not change
+    if (registers[DS3231RegisterId::Control] != control)
+    {
+        _cache.MarkDirty(DS3231RegisterId::Control);
+        _cache.Flush(_bus);
+    }
 }
 
 AlarmInterruptStatus DS3231RealTimeClock::GetAlarmInterruptStatus() const
 {
-    DS3231RegisterSet registers;
-    registers.Read(_bus, DS3231RegisterId::Control);
+    auto& registers = _cache.Registers();
 
     AlarmInterruptStatus state;
+    state.FirstAlarm = AlarmInterruptState::Off;
+    state.SecondAlarm = AlarmInterruptState::Off;
+
+    if (_cache.Fetch(_bus, DS3231RegisterId::Control) != Status::Ok)
+    {
+        return state;
+    }
+
     state.FirstAlarm = registers.IsBitSet(DS3231RegisterId::Control, DS3231RegisterMasks::ControlAlarm1IntEnable)
             ? AlarmInterruptState::On
             : AlarmInterruptState::Off;
@@ -402,11 +395,70 @@ AlarmInterruptStatus DS3231RealTimeClock::GetAlarmInterruptStatus() const
     return state;
 }
 
+void DS3231RealTimeClock::SetSquareWave(SquareWaveRate rate)
+{
+    auto& registers = _cache.Registers();
+
+    if (_cache.Fetch(_bus, DS3231RegisterId::Control) != Status::Ok)
+    {
+        return;
+    }
+
+    auto control = registers[DS3231RegisterId::Control];
+
+    //RS2/RS1 select the rate, INTCN switches the pin between the
+    //square wave and the alarm interrupt
+    byte frequency = 0;
+    switch (rate)
+    {
+    case SquareWaveRate::Disabled:
+    case SquareWaveRate::Rate1Hz:
+        frequency = 0b00000000;
+        break;
+    case SquareWaveRate::Rate1024Hz:
+        frequency = 0b00001000;
+        break;
+    case SquareWaveRate::Rate4096Hz:
+        frequency = 0b00010000;
+        break;
+    case SquareWaveRate::Rate8192Hz:
+        frequency = 0b00011000;
+        break;
+    }
+
+    registers.RemoveBit(DS3231RegisterId::Control, DS3231RegisterMasks::ControlSqFreq);
+    registers.ApplyBit(DS3231RegisterId::Control, frequency);
+    registers.SetBit(DS3231RegisterId::Control, rate == SquareWaveRate::Disabled, DS3231RegisterMasks::ControlInterruptCtl);
+
+    if (registers[DS3231RegisterId::Control] != control)
+    {
+        _cache.MarkDirty(DS3231RegisterId::Control);
+        _cache.Flush(_bus);
+    }
+}
+
 AlarmTriggerState DS3231RealTimeClock::GetAlarmTriggerState() const
 {
-    DS3231RegisterSet registers;
+    //nothing is reported or cleared from a stale status
+    if (_cache.Fetch(_bus, DS3231RegisterId::Status) != Status::Ok)
+    {
+        AlarmTriggerState state;
+        state.FirstTriggered = false;
+        state.SecondTriggered = false;
+
+        return state;
+    }
+
+    auto state = TakeTriggerState(_cache);
+
+    _cache.Flush(_bus);
 
-    registers.Read(_bus, DS3231RegisterId::Status);
+    return state;
+}
+
+AlarmTriggerState DS3231RealTimeClock::TakeTriggerState(DS3231RegisterCache& cache)
+{
+    auto& registers = cache.Registers();
 
 	AlarmTriggerState state;
     state.FirstTriggered = registers.IsBitSet(DS3231RegisterId::Status, DS3231RegisterMasks::StatusAlarm1Trigger);
@@ -414,12 +466,12 @@ AlarmTriggerState DS3231RealTimeClock::GetAlarmTriggerState() const
 	
 	if (state.Triggered())
 	{
-		//clear the alarm status bits if an alarm was triggered
-
-        registers.RemoveBit(DS3231RegisterId::Status, DS3231RegisterMasks::StatusAlarm1Trigger);
-        registers.RemoveBit(DS3231RegisterId::Status, DS3231RegisterMasks::StatusAlarm2Trigger);
+		//clear only the flags that were seen set. Writing 1 leaves a flag
+		//alone, so an alarm that fires after the read is not lost.
+        registers.SetBit(DS3231RegisterId::Status, !state.FirstTriggered, DS3231RegisterMasks::StatusAlarm1Trigger);
+        registers.SetBit(DS3231RegisterId::Status, !state.SecondTriggered, DS3231RegisterMasks::StatusAlarm2Trigger);
 
-        registers.Write(_bus, DS3231RegisterId::Status);
+        cache.MarkDirty(DS3231RegisterId::Status);
 	}
 	
     return state;
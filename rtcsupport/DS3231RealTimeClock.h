@@ -3,6 +3,7 @@
 
 #include "LocalTypes.h"
 #include "RealTimeClock.h"
+#include "DS3231RegisterCache.h"
 
 class I2CBus;
 
@@ -11,6 +12,9 @@ namespace rtc
     class DS3231RealTimeClock : public RealTimeClock
 	{
 		I2CBus* _bus;
+
+        //shadow of the device registers, shared by the const accessors
+        mutable DS3231RegisterCache _cache;
 	
 	public:
         DS3231RealTimeClock(I2CBus* bus);
@@ -19,6 +23,10 @@ namespace rtc
 	
         bool Initialize();
         void Shutdown();
+
+        //forget the shadowed alarm/control registers, e.g. after another
+        //process has reprogrammed the device
+        void InvalidateCache();
 		
         RtcClockState GetClockState() const;
 		
@@ -40,6 +48,22 @@ namespace rtc
 		
         AlarmTriggerState GetAlarmTriggerState() const;
 
+        void SetSquareWave(SquareWaveRate rate);
+
+        //Register level halves of the operations above, shared with
+        //DS3231AsyncClock. Changes are marked dirty, not written.
+
+        //clear OSF and re-enable the oscillator on battery once the time
+        //is set, needs control and status fetched
+        static void MarkTimeValid(DS3231RegisterCache& cache);
+
+        static float DecodeTemperature(const DS3231RegisterSet& registers);
+
+        static void EncodeAlarm(AlarmId id, const RtcAlarm& alarm, DS3231RegisterCache& cache);
+
+        //read the alarm flags from a fetched status and clear them
+        static AlarmTriggerState TakeTriggerState(DS3231RegisterCache& cache);
+
     private:
 	};
 } //namespace rtc
@@ -0,0 +1,264 @@
+#ifndef DS3231REGISTERCACHE_H
+#define DS3231REGISTERCACHE_H
+
+#include "I2CBus.h"
+#include "I2CTransaction.h"
+#include "DS3231Registers.h"
+#include "DS3231RegisterSet.h"
+
+//Persistent shadow of the DS3231 register file.
+//
+//Registers the device changes on its own (time, status and temperature)
+//are volatile and always fetched from the device. The alarm, control and
+//aging registers only change when we write them, so once fetched they are
+//served from the shadow.
+//
+//Modified registers are marked dirty and written back by Flush/Sync, one
+//block write per contiguous dirty range, all in a single transaction.
+class DS3231RegisterCache
+{
+    static const int RegisterCount = byte(DS3231RegisterId::RegisterCount);
+
+    static const unsigned VolatileMask =
+        0x0000007F |                                //Seconds - Year
+        (1u << byte(DS3231RegisterId::Status)) |
+        (1u << byte(DS3231RegisterId::TempMsb)) |
+        (1u << byte(DS3231RegisterId::TempLsb));
+
+    DS3231RegisterSet _registers;
+
+    unsigned _validMask;
+    unsigned _dirtyMask;
+
+public:
+    DS3231RegisterCache() :
+        _validMask(0),
+        _dirtyMask(0)
+    {
+    }
+
+    DS3231RegisterSet& Registers()
+    {
+        return _registers;
+    }
+
+    const DS3231RegisterSet& Registers() const
+    {
+        return _registers;
+    }
+
+    static bool IsVolatile(DS3231RegisterId id)
+    {
+        return (VolatileMask & (1u << byte(id))) != 0;
+    }
+
+    bool IsDirty() const
+    {
+        return _dirtyMask != 0;
+    }
+
+    //drop every shadowed value, including unflushed changes
+    void Invalidate()
+    {
+        _validMask = 0;
+        _dirtyMask = 0;
+    }
+
+    void MarkDirty(DS3231RegisterId id)
+    {
+        MarkDirty(id, id);
+    }
+
+    void MarkDirty(DS3231RegisterId startRegister, DS3231RegisterId endRegister)
+    {
+        _dirtyMask |= RangeMask(startRegister, endRegister);
+    }
+
+    //Bring the inclusive range up to date. Only registers that are volatile
+    //or not yet shadowed are read, pending writes are never overwritten.
+    Status Fetch(I2CBus* bus, DS3231RegisterId startRegister, DS3231RegisterId endRegister)
+    {
+        return Submit(bus, false, FetchMask(startRegister, endRegister));
+    }
+
+    Status Fetch(I2CBus* bus, DS3231RegisterId id)
+    {
+        return Fetch(bus, id, id);
+    }
+
+    //write back every dirty register
+    Status Flush(I2CBus* bus)
+    {
+        return Submit(bus, true, 0);
+    }
+
+    //flush and fetch in one transaction, writes are issued first
+    Status Sync(I2CBus* bus, DS3231RegisterId startRegister, DS3231RegisterId endRegister)
+    {
+        return Submit(bus, true, FetchMask(startRegister, endRegister));
+    }
+
+    //Fetch, Flush and Sync in two halves for callers that submit the
+    //transaction themselves: Queue the request, submit, then Complete it
+    //with the result before touching the cache again.
+    struct Request
+    {
+        unsigned WriteMask;
+        unsigned FetchMask;
+
+        bool Empty() const
+        {
+            return WriteMask == 0 && FetchMask == 0;
+        }
+    };
+
+    Request FetchRequest(DS3231RegisterId startRegister, DS3231RegisterId endRegister) const
+    {
+        return MakeRequest(false, FetchMask(startRegister, endRegister));
+    }
+
+    Request FlushRequest() const
+    {
+        return MakeRequest(true, 0);
+    }
+
+    Request SyncRequest(DS3231RegisterId startRegister, DS3231RegisterId endRegister) const
+    {
+        return MakeRequest(true, FetchMask(startRegister, endRegister));
+    }
+
+    bool Queue(I2CTransaction& transaction, const Request& request)
+    {
+        return QueueRanges(transaction, request.WriteMask, true) &&
+            QueueRanges(transaction, request.FetchMask, false);
+    }
+
+    void Complete(const Request& request, Status result)
+    {
+#if defined(RTC_TRACE)
+        Trace(request, result);
+#endif
+
+        //a failed write leaves the device state unknown, so forget the
+        //pending values and let the next fetch read them back
+        _dirtyMask &= ~request.WriteMask;
+
+        if (result == Status::Ok)
+        {
+            _validMask |= request.WriteMask | request.FetchMask;
+        }
+        else
+        {
+            _validMask &= ~request.WriteMask;
+        }
+    }
+
+private:
+    static unsigned RangeMask(DS3231RegisterId startRegister, DS3231RegisterId endRegister)
+    {
+        auto count = (byte(endRegister) - byte(startRegister)) + 1;
+
+        return ((1u << count) - 1) << byte(startRegister);
+    }
+
+    unsigned FetchMask(DS3231RegisterId startRegister, DS3231RegisterId endRegister) const
+    {
+        auto shadowed = _validMask & ~VolatileMask;
+
+        return RangeMask(startRegister, endRegister) & ~shadowed & ~_dirtyMask;
+    }
+
+    //calls visit(startRegister, endRegister) for each contiguous run of
+    //set bits in mask, stopping at the first one that returns false
+    template <typename Visit>
+    static bool ForEachRange(unsigned mask, Visit visit)
+    {
+        auto idx = 0;
+
+        while (idx < RegisterCount)
+        {
+            if ((mask & (1u << idx)) == 0)
+            {
+                idx++;
+                continue;
+            }
+
+            auto start = idx;
+            while (idx < RegisterCount && (mask & (1u << idx)) != 0)
+            {
+                idx++;
+            }
+
+            if (!visit(DS3231RegisterId(start), DS3231RegisterId(idx - 1)))
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    //queue one segment per contiguous run of set bits in mask
+    bool QueueRanges(I2CTransaction& transaction, unsigned mask, bool write)
+    {
+        return ForEachRange(mask, [this, &transaction, write](DS3231RegisterId startRegister, DS3231RegisterId endRegister)
+        {
+            return write
+                ? _registers.QueueWrite(transaction, startRegister, endRegister)
+                : _registers.QueueRead(transaction, startRegister, endRegister);
+        });
+    }
+
+#if defined(RTC_TRACE)
+    //one record per segment of a submitted request, a failed read traces
+    //no data
+    void Trace(const Request& request, Status result)
+    {
+        ForEachRange(request.WriteMask, [this, result](DS3231RegisterId startRegister, DS3231RegisterId endRegister)
+        {
+            auto count = (byte(endRegister) - byte(startRegister)) + 1;
+            RTC_TRACE_REGISTERS(RegisterWrite, byte(startRegister), _registers.AddressOf(startRegister), count, result);
+            return true;
+        });
+
+        ForEachRange(request.FetchMask, [this, result](DS3231RegisterId startRegister, DS3231RegisterId endRegister)
+        {
+            auto count = (byte(endRegister) - byte(startRegister)) + 1;
+            RTC_TRACE_REGISTERS(RegisterRead, byte(startRegister), _registers.AddressOf(startRegister), result == Status::Ok ? count : 0, result);
+            return true;
+        });
+    }
+#endif
+
+    Request MakeRequest(bool flush, unsigned fetchMask) const
+    {
+        Request request;
+        request.WriteMask = flush ? _dirtyMask : 0;
+        request.FetchMask = fetchMask;
+        return request;
+    }
+
+    Status Submit(I2CBus* bus, bool flush, unsigned fetchMask)
+    {
+        auto request = MakeRequest(flush, fetchMask);
+        if (request.Empty())
+        {
+            return Status::Ok;
+        }
+
+        I2CTransaction transaction;
+
+        if (!Queue(transaction, request))
+        {
+            return Status::Fail;
+        }
+
+        auto result = bus->Submit(transaction);
+
+        Complete(request, result);
+
+        return result;
+    }
+};
+
+#endif // DS3231REGISTERCACHE_H
@@ -2,8 +2,11 @@
 #define DS3231REGISTERSET_H
 
 #include "I2CBus.h"
+#include "I2CTransaction.h"
 #include "LocalTypes.h"
 #include "DS3231Registers.h"
+#include "BcdCodec.h"
+#include "RtcTrace.h"
 #include <stdlib.h>
 
 class DS3231RegisterSet
@@ -23,6 +26,13 @@ public:
         memset(static_cast<void*>(_registers), 0, RegisterCount);
     }
 
+    void Clear(DS3231RegisterId startRegister, DS3231RegisterId endRegister)
+    {
+        auto count = (byte(endRegister) - byte(startRegister)) + 1;
+
+        memset(static_cast<void*>(_registers + byte(startRegister)), 0, count);
+    }
+
     byte* AddressOf(DS3231RegisterId id)
     {
         return ((byte*) _registers) + byte(id);
@@ -85,37 +95,30 @@ public:
 
     byte FromBcd(DS3231RegisterId id, byte msbMask, byte lsbMask) const
     {
-        auto msb = Masked(id, msbMask);
-        auto lsb = Masked(id, lsbMask);
-
-        auto result = lsb + (msb >> 4) * 10;
-
-        return result;
+        return rtc::bcd::FromBcd(Masked(id, msbMask | lsbMask));
     }
 
     void ToBcd(DS3231RegisterId id, byte value, byte msbMask, byte lsbMask)
     {
-        auto& r = _registers[byte(id)];
-
-        //((val / 10) << 4) + val % 10;
-
-        r |= byte(value / 10 << 4) & msbMask;
-        r |= byte(value % 10) & lsbMask;
+        _registers[byte(id)] |= rtc::bcd::ToBcd(value) & (msbMask | lsbMask);
     }
 
     Status Read(I2CBus* bus, DS3231RegisterId id)
     {
-        printf("Reading register %d\n", byte(id));
-
         byte value;
         auto result = bus->Receive((int)id, value);
         if (result == Status::Ok)
         {
             _registers[byte(id)] = value;
         }
+
+        //value is only set when the read succeeded, a failure traces no data
+        RTC_TRACE_REGISTERS(RegisterRead, byte(id), &value, result == Status::Ok ? 1 : 0, result);
+
         return result;
     }
 
+    //prints every register, for debugging only
     void Dump()
     {
         for(int i = 0; i < RegisterCount; i++)
@@ -126,17 +129,14 @@ public:
 
     Status Read(I2CBus* bus, DS3231RegisterId startId, int count)
     {
-        if (int(startId) + count >= int(DS3231RegisterId::RegisterCount))
+        if (int(startId) + count > int(DS3231RegisterId::RegisterCount))
         {
             return Status::ReceiveFail;
         }
 
-        printf("Reading start: %d, count: %d\n", byte(startId), byte(count));
-
         auto result = bus->Receive((int)startId, _registers + byte(startId), count);
 
-        Dump();
-        printf("\n");
+        RTC_TRACE_REGISTERS(RegisterRead, byte(startId), _registers + byte(startId), count, result);
 
         return result;
     }
@@ -151,30 +151,79 @@ public:
 
     Status Write(I2CBus* bus, DS3231RegisterId id)
     {
-        return bus->Send((int)id, _registers[byte(id)]);
+        auto result = bus->Send((int)id, _registers[byte(id)]);
+
+        RTC_TRACE_REGISTERS(RegisterWrite, byte(id), _registers + byte(id), 1, result);
+
+        return result;
     }
 
     Status Write(I2CBus* bus, DS3231RegisterId startId, int count)
     {
-        if (int(startId) + count >= int(DS3231RegisterId::RegisterCount))
+        if (int(startId) + count > int(DS3231RegisterId::RegisterCount))
         {
             return Status::SendFail;
         }
 
-        printf("Writing start: %d, count: %d\n", byte(startId), byte(count));
+        auto result = bus->Send((int)startId, _registers + byte(startId), count);
 
-        Dump();
-        printf("\n");
+        RTC_TRACE_REGISTERS(RegisterWrite, byte(startId), _registers + byte(startId), count, result);
 
-        return bus->Send((int)startId, _registers + byte(startId), count);
+        return result;
     }
 
     Status Write(I2CBus* bus, DS3231RegisterId startRegister, DS3231RegisterId endRegister)
     {
-        auto count = byte(endRegister) - byte(startRegister);
+        auto count = (byte(endRegister) - byte(startRegister)) + 1;
 
         return Write(bus, startRegister, count);
     }
+
+    //Queue a read of the inclusive register range into this set.
+    //The registers are updated once the transaction is submitted.
+    bool QueueRead(I2CTransaction& transaction, DS3231RegisterId startRegister, DS3231RegisterId endRegister)
+    {
+        if (!InRange(startRegister, endRegister))
+        {
+            return false;
+        }
+
+        auto count = (byte(endRegister) - byte(startRegister)) + 1;
+
+        return transaction.Read(byte(startRegister), _registers + byte(startRegister), count);
+    }
+
+    bool QueueRead(I2CTransaction& transaction, DS3231RegisterId id)
+    {
+        return QueueRead(transaction, id, id);
+    }
+
+    //Queue a write of the inclusive register range. The current register
+    //values are copied into the transaction when queued.
+    bool QueueWrite(I2CTransaction& transaction, DS3231RegisterId startRegister, DS3231RegisterId endRegister)
+    {
+        if (!InRange(startRegister, endRegister))
+        {
+            return false;
+        }
+
+        auto count = (byte(endRegister) - byte(startRegister)) + 1;
+
+        return transaction.Write(byte(startRegister), _registers + byte(startRegister), count);
+    }
+
+    bool QueueWrite(I2CTransaction& transaction, DS3231RegisterId id)
+    {
+        return QueueWrite(transaction, id, id);
+    }
+
+private:
+    //an inclusive range that lies within the register file
+    static bool InRange(DS3231RegisterId startRegister, DS3231RegisterId endRegister)
+    {
+        return startRegister <= endRegister &&
+            int(endRegister) < RegisterCount;
+    }
 };
 
 #endif // DS3231REGISTERSET_H
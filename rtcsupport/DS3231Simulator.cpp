@@ -0,0 +1,506 @@
+#include "DS3231Simulator.h"
+#include "DS3231TimeCodec.h"
+#include "RealTimeClockPrivate.h"
+#include <string.h>
+#include <math.h>
+#include <chrono>
+
+using namespace rtc;
+
+static const int64_t NsPerSecond = 1000000000LL;
+
+//the aging offset trims the crystal by about 0.1ppm per LSB, positive
+//values slow the oscillator down
+static const double AgingPpmPerLsb = 0.1;
+
+static int64_t MonotonicNs()
+{
+    auto now = std::chrono::steady_clock::now().time_since_epoch();
+
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(now).count();
+}
+
+DS3231Simulator::DS3231Simulator(TimeSource timeSource /*= TimeSource::Manual*/)
+    : _pointer(0),
+      _timeSource(timeSource),
+      _nowNs(timeSource == TimeSource::RealTime ? MonotonicNs() : 0),
+      _phaseNs(0),
+      _driftPpm(0),
+      _batteryPower(false),
+      _oscillatorStopped(false),
+      _intAsserted(false)
+{
+    Reset();
+}
+
+//power on state: 2000-01-01 00:00:00, square wave off, interrupts on the
+//pin, OSF set because the time has never been written
+void DS3231Simulator::Reset()
+{
+    memset(_registers, 0, sizeof(_registers));
+
+    _registers[byte(DS3231RegisterId::WeekDay)] = 0x01;
+    _registers[byte(DS3231RegisterId::Date)] = 0x01;
+    _registers[byte(DS3231RegisterId::Month)] = 0x01 | DS3231RegisterMasks::MonthCentury;
+
+    _registers[byte(DS3231RegisterId::Control)] =
+        DS3231RegisterMasks::ControlSqFreq |
+        DS3231RegisterMasks::ControlInterruptCtl;
+    _registers[byte(DS3231RegisterId::Status)] =
+        DS3231RegisterMasks::StatusOscStopped |
+        DS3231RegisterMasks::StatusEnable32kOutput;
+
+    _registers[byte(DS3231RegisterId::TempMsb)] = 25;
+}
+
+int64_t DS3231Simulator::NowNs() const
+{
+    std::lock_guard<std::mutex> lock(_lock);
+
+    return _nowNs;
+}
+
+void DS3231Simulator::Update()
+{
+    if (_timeSource == TimeSource::RealTime)
+    {
+        AdvanceTo(MonotonicNs());
+    }
+}
+
+void DS3231Simulator::Advance(int64_t ns)
+{
+    {
+        std::lock_guard<std::mutex> lock(_lock);
+
+        if (_timeSource == TimeSource::Manual)
+        {
+            AdvanceTo(_nowNs + ns);
+        }
+    }
+
+    DeliverEdges();
+}
+
+bool DS3231Simulator::OscillatorRunning() const
+{
+    auto eosc = (_registers[byte(DS3231RegisterId::Control)] & DS3231RegisterMasks::ControlDisableOscBat) != 0;
+
+    return !_oscillatorStopped && !(_batteryPower && eosc);
+}
+
+void DS3231Simulator::AdvanceTo(int64_t nowNs)
+{
+    auto elapsed = nowNs - _nowNs;
+    if (elapsed <= 0)
+    {
+        return;
+    }
+
+    if (OscillatorRunning())
+    {
+        auto aging = int8_t(_registers[byte(DS3231RegisterId::AgingOffset)]);
+        auto ppm = _driftPpm - aging * AgingPpmPerLsb;
+
+        _phaseNs += elapsed + int64_t(elapsed * ppm * 1e-6);
+
+        while (_phaseNs >= NsPerSecond)
+        {
+            _phaseNs -= NsPerSecond;
+            Tick(nowNs - _phaseNs);
+        }
+    }
+
+    _nowNs = nowNs;
+}
+
+//one second rollover at edgeNs
+void DS3231Simulator::Tick(int64_t edgeNs)
+{
+    auto time = _registers + byte(DS3231RegisterId::Seconds);
+
+    RtcDateTime value;
+    DS3231TimeCodec::Decode(time, value);
+
+    //the chip counts 00-99 with every fourth year a leap year whatever
+    //the century bit says, which is the 2000-2099 calendar
+    auto century = time[byte(DS3231RegisterId::Month)] & DS3231RegisterMasks::MonthCentury;
+    value.Year = value.Year % 100 + 2000;
+
+    auto seconds = pvt::ToEpochSeconds(value);
+
+    //the weekday register is a free running 1-7 counter that steps at
+    //midnight, it is not derived from the date
+    auto weekDay = time[byte(DS3231RegisterId::WeekDay)];
+    if ((seconds + 1) % 86400 == 0)
+    {
+        weekDay = weekDay % 7 + 1;
+    }
+
+    pvt::FromEpochSeconds(seconds + 1, value.Time.Mode, value);
+
+    //the years register wraps from 99 to 00 and toggles the century bit
+    if (value.Year == 2100)
+    {
+        value.Year = 2000;
+        century ^= DS3231RegisterMasks::MonthCentury;
+    }
+
+    DS3231TimeCodec::Encode(value, time);
+    time[byte(DS3231RegisterId::WeekDay)] = weekDay;
+    time[byte(DS3231RegisterId::Month)] = (time[byte(DS3231RegisterId::Month)] & ~DS3231RegisterMasks::MonthCentury) | century;
+
+    auto& status = _registers[byte(DS3231RegisterId::Status)];
+    if (MatchAlarm1())
+    {
+        status |= DS3231RegisterMasks::StatusAlarm1Trigger;
+    }
+    if (MatchAlarm2())
+    {
+        status |= DS3231RegisterMasks::StatusAlarm2Trigger;
+    }
+
+    //1Hz square wave, the falling edge marks the rollover
+    auto control = _registers[byte(DS3231RegisterId::Control)];
+    if ((control & (DS3231RegisterMasks::ControlInterruptCtl | DS3231RegisterMasks::ControlSqFreq)) == 0)
+    {
+        _pendingEdges.push_back(edgeNs);
+    }
+
+    UpdateInterrupt(edgeNs);
+}
+
+int DS3231Simulator::MilitaryHour(byte value) const
+{
+    if (value & DS3231RegisterMasks::HourMode)
+    {
+        auto hour = bcd::FromBcd(value & (DS3231RegisterMasks::HourWallMsb | DS3231RegisterMasks::HourLsb)) % 12;
+        return (value & DS3231RegisterMasks::HourPeriod)
+            ? hour + 12
+            : hour;
+    }
+
+    return bcd::FromBcd(value & (DS3231RegisterMasks::HourLinearMsb | DS3231RegisterMasks::HourLsb));
+}
+
+//every field whose mask bit is clear has to match the time
+bool DS3231Simulator::MatchAlarm1() const
+{
+    auto r = _registers;
+
+    auto a1 = r[byte(DS3231RegisterId::Alarm1Seconds)];
+    auto a2 = r[byte(DS3231RegisterId::Alarm1Minutes)];
+    auto a3 = r[byte(DS3231RegisterId::Alarm1Hours)];
+    auto a4 = r[byte(DS3231RegisterId::Alarm1Day)];
+
+    auto second = (a1 & 0x7F) == (r[byte(DS3231RegisterId::Seconds)] & 0x7F);
+    auto minute = (a2 & 0x7F) == (r[byte(DS3231RegisterId::Minutes)] & 0x7F);
+    auto hour = MilitaryHour(a3 & 0x7F) == MilitaryHour(r[byte(DS3231RegisterId::Hours)]);
+    auto day = (a4 & DS3231RegisterMasks::AlarmDateMode)
+        ? (a4 & DS3231RegisterMasks::AlarmWeekDay) == (r[byte(DS3231RegisterId::WeekDay)] & DS3231RegisterMasks::WeekDay)
+        : (a4 & 0x3F) == (r[byte(DS3231RegisterId::Date)] & 0x3F);
+
+    return ((a1 & DS3231RegisterMasks::AlarmExcludeInterval) || second) &&
+        ((a2 & DS3231RegisterMasks::AlarmExcludeInterval) || minute) &&
+        ((a3 & DS3231RegisterMasks::AlarmExcludeInterval) || hour) &&
+        ((a4 & DS3231RegisterMasks::AlarmExcludeInterval) || day);
+}
+
+//alarm 2 has no seconds register and only fires at 00 seconds
+bool DS3231Simulator::MatchAlarm2() const
+{
+    auto r = _registers;
+
+    if (r[byte(DS3231RegisterId::Seconds)] != 0)
+    {
+        return false;
+    }
+
+    auto a2 = r[byte(DS3231RegisterId::Alarm2Minutes)];
+    auto a3 = r[byte(DS3231RegisterId::Alarm2Hours)];
+    auto a4 = r[byte(DS3231RegisterId::Alarm2Day)];
+
+    auto minute = (a2 & 0x7F) == (r[byte(DS3231RegisterId::Minutes)] & 0x7F);
+    auto hour = MilitaryHour(a3 & 0x7F) == MilitaryHour(r[byte(DS3231RegisterId::Hours)]);
+    auto day = (a4 & DS3231RegisterMasks::AlarmDateMode)
+        ? (a4 & DS3231RegisterMasks::AlarmWeekDay) == (r[byte(DS3231RegisterId::WeekDay)] & DS3231RegisterMasks::WeekDay)
+        : (a4 & 0x3F) == (r[byte(DS3231RegisterId::Date)] & 0x3F);
+
+    return ((a2 & DS3231RegisterMasks::AlarmExcludeInterval) || minute) &&
+        ((a3 & DS3231RegisterMasks::AlarmExcludeInterval) || hour) &&
+        ((a4 & DS3231RegisterMasks::AlarmExcludeInterval) || day);
+}
+
+//INT is active low and held while an enabled alarm flag is set
+void DS3231Simulator::UpdateInterrupt(int64_t nowNs)
+{
+    auto control = _registers[byte(DS3231RegisterId::Control)];
+    auto status = _registers[byte(DS3231RegisterId::Status)];
+
+    auto asserted = (control & DS3231RegisterMasks::ControlInterruptCtl) &&
+        (((control & DS3231RegisterMasks::ControlAlarm1IntEnable) && (status & DS3231RegisterMasks::StatusAlarm1Trigger)) ||
+         ((control & DS3231RegisterMasks::ControlAlarm2IntEnable) && (status & DS3231RegisterMasks::StatusAlarm2Trigger)));
+
+    if (asserted && !_intAsserted)
+    {
+        _pendingEdges.push_back(nowNs);
+    }
+
+    _intAsserted = asserted;
+}
+
+void DS3231Simulator::SetPointer(byte value)
+{
+    std::lock_guard<std::mutex> lock(_lock);
+
+    _pointer = value % RegisterCount;
+}
+
+byte DS3231Simulator::Pointer() const
+{
+    std::lock_guard<std::mutex> lock(_lock);
+
+    return _pointer;
+}
+
+void DS3231Simulator::WriteRegister(byte id, byte value)
+{
+    auto& r = _registers[id];
+
+    switch (DS3231RegisterId(id))
+    {
+    default:
+        r = value;
+        break;
+
+    case DS3231RegisterId::Seconds:
+        //writing the seconds restarts the countdown chain
+        r = value;
+        _phaseNs = 0;
+        break;
+
+    case DS3231RegisterId::Control:
+        //the conversion completes at once, the temperature registers
+        //always hold the current value
+        r = value & ~DS3231RegisterMasks::ControlTempConv;
+        UpdateOscillator();
+        break;
+
+    case DS3231RegisterId::Status:
+    {
+        //the flags can only be cleared, BSY is read only
+        const byte flags = DS3231RegisterMasks::StatusOscStopped |
+            DS3231RegisterMasks::StatusAlarm2Trigger |
+            DS3231RegisterMasks::StatusAlarm1Trigger;
+
+        r = (r & value & flags) |
+            (value & DS3231RegisterMasks::StatusEnable32kOutput) |
+            (r & DS3231RegisterMasks::StatusTempConvBusy);
+        break;
+    }
+
+    case DS3231RegisterId::TempMsb:
+    case DS3231RegisterId::TempLsb:
+        break;
+    }
+}
+
+void DS3231Simulator::Write(const byte* data, int dataLen)
+{
+    {
+        std::lock_guard<std::mutex> lock(_lock);
+
+        Update();
+
+        for (auto idx = 0; idx < dataLen; idx++)
+        {
+            WriteRegister(_pointer, data[idx]);
+            _pointer = (_pointer + 1) % RegisterCount;
+        }
+
+        UpdateInterrupt(_nowNs);
+    }
+
+    DeliverEdges();
+}
+
+void DS3231Simulator::Read(byte* data, int dataLen)
+{
+    {
+        std::lock_guard<std::mutex> lock(_lock);
+
+        Update();
+
+        for (auto idx = 0; idx < dataLen; idx++)
+        {
+            data[idx] = _registers[_pointer];
+            _pointer = (_pointer + 1) % RegisterCount;
+        }
+    }
+
+    DeliverEdges();
+}
+
+void DS3231Simulator::SetDateTime(const RtcDateTime& value)
+{
+    std::lock_guard<std::mutex> lock(_lock);
+
+    Update();
+
+    DS3231TimeCodec::Encode(value, _registers + byte(DS3231RegisterId::Seconds));
+    _phaseNs = 0;
+}
+
+RtcDateTime DS3231Simulator::GetDateTime()
+{
+    RtcDateTime value;
+
+    {
+        std::lock_guard<std::mutex> lock(_lock);
+
+        Update();
+
+        DS3231TimeCodec::Decode(_registers + byte(DS3231RegisterId::Seconds), value);
+    }
+
+    DeliverEdges();
+
+    return value;
+}
+
+void DS3231Simulator::SetTemperature(float celsius)
+{
+    std::lock_guard<std::mutex> lock(_lock);
+
+    //10 bit two's complement in quarter degrees, left aligned over MSB/LSB
+    auto quarters = int(lroundf(celsius * 4));
+
+    _registers[byte(DS3231RegisterId::TempMsb)] = byte(quarters >> 2);
+    _registers[byte(DS3231RegisterId::TempLsb)] = byte((quarters & 0x03) << 6);
+}
+
+void DS3231Simulator::SetDriftPpm(double ppm)
+{
+    std::lock_guard<std::mutex> lock(_lock);
+
+    Update();
+    _driftPpm = ppm;
+}
+
+void DS3231Simulator::UpdateOscillator()
+{
+    if (!OscillatorRunning())
+    {
+        _registers[byte(DS3231RegisterId::Status)] |= DS3231RegisterMasks::StatusOscStopped;
+    }
+}
+
+void DS3231Simulator::SetBatteryPower(bool battery)
+{
+    std::lock_guard<std::mutex> lock(_lock);
+
+    Update();
+
+    _batteryPower = battery;
+    UpdateOscillator();
+}
+
+void DS3231Simulator::StopOscillator()
+{
+    std::lock_guard<std::mutex> lock(_lock);
+
+    Update();
+
+    _oscillatorStopped = true;
+    UpdateOscillator();
+}
+
+void DS3231Simulator::StartOscillator()
+{
+    std::lock_guard<std::mutex> lock(_lock);
+
+    Update();
+
+    _oscillatorStopped = false;
+}
+
+bool DS3231Simulator::InterruptAsserted()
+{
+    {
+        std::lock_guard<std::mutex> lock(_lock);
+
+        Update();
+    }
+
+    DeliverEdges();
+
+    std::lock_guard<std::mutex> lock(_lock);
+
+    return _intAsserted;
+}
+
+byte DS3231Simulator::Peek(DS3231RegisterId id)
+{
+    std::lock_guard<std::mutex> lock(_lock);
+
+    Update();
+
+    return _registers[byte(id)];
+}
+
+void DS3231Simulator::Poke(DS3231RegisterId id, byte value)
+{
+    std::lock_guard<std::mutex> lock(_lock);
+
+    Update();
+
+    _registers[byte(id)] = value;
+    UpdateInterrupt(_nowNs);
+}
+
+bool DS3231Simulator::Start(const EdgeHandler& handler)
+{
+    std::lock_guard<std::mutex> lock(_lock);
+
+    _edgeHandler = handler;
+    _pendingEdges.clear();
+
+    return true;
+}
+
+void DS3231Simulator::Stop()
+{
+    std::lock_guard<std::mutex> lock(_lock);
+
+    _edgeHandler = nullptr;
+    _pendingEdges.clear();
+}
+
+//edge handlers run without the lock held so they may use the device
+void DS3231Simulator::DeliverEdges()
+{
+    std::vector<int64_t> edges;
+    EdgeHandler handler;
+
+    {
+        std::lock_guard<std::mutex> lock(_lock);
+
+        if (_pendingEdges.empty())
+        {
+            return;
+        }
+
+        edges.swap(_pendingEdges);
+        handler = _edgeHandler;
+    }
+
+    if (!handler)
+    {
+        return;
+    }
+
+    for (auto edgeNs : edges)
+    {
+        handler(edgeNs);
+    }
+}
@@ -0,0 +1,122 @@
+#ifndef DS3231SIMULATOR_H
+#define DS3231SIMULATOR_H
+
+#include "LocalTypes.h"
+#include "DS3231Registers.h"
+#include "RtcEdgeSource.h"
+#include "RtcTime.h"
+#include <stdint.h>
+#include <mutex>
+#include <vector>
+
+//In-memory model of the DS3231 register file.
+//
+//The model is second accurate: the time registers tick in BCD with the
+//device's 12/24 hour, month length and century rules, alarms are matched
+//on every second and set their flags, and the INT/SQW pin is reported
+//through the RtcEdgeSource interface. OSF is set at power up and when the
+//oscillator is stopped, temperature and the aging offset are modelled.
+//
+//Time either follows CLOCK_MONOTONIC or only moves when Advance is
+//called, which keeps benchmarks and regressions deterministic. The model
+//catches up whenever it is accessed, so edges are reported late but
+//carry the time they happened.
+class DS3231Simulator : public rtc::RtcEdgeSource
+{
+public:
+    static const int RegisterCount = byte(DS3231RegisterId::RegisterCount);
+
+    enum class TimeSource
+    {
+        //follow CLOCK_MONOTONIC
+        RealTime,
+        //only move on Advance
+        Manual
+    };
+
+private:
+    mutable std::mutex _lock;
+
+    byte _registers[RegisterCount];
+    byte _pointer;
+
+    TimeSource _timeSource;
+    int64_t _nowNs;
+    int64_t _phaseNs;
+    double _driftPpm;
+
+    bool _batteryPower;
+    bool _oscillatorStopped;
+    bool _intAsserted;
+
+    EdgeHandler _edgeHandler;
+    std::vector<int64_t> _pendingEdges;
+
+public:
+    DS3231Simulator(TimeSource timeSource = TimeSource::Manual);
+
+    DS3231Simulator(const DS3231Simulator&) = delete;
+
+    //register pointer access as seen over I2C, the pointer wraps after
+    //the last register
+    void SetPointer(byte value);
+    byte Pointer() const;
+
+    void Write(const byte* data, int dataLen);
+    void Read(byte* data, int dataLen);
+
+    TimeSource Source() const
+    {
+        return _timeSource;
+    }
+
+    //move the manual time source forward, ignored for RealTime
+    void Advance(int64_t ns);
+
+    //time the model has caught up to, CLOCK_MONOTONIC for RealTime
+    int64_t NowNs() const;
+
+    //load the time registers directly, the second starts now
+    void SetDateTime(const rtc::RtcDateTime& value);
+    rtc::RtcDateTime GetDateTime();
+
+    //die temperature in 0.25C steps
+    void SetTemperature(float celsius);
+
+    //oscillator error, the aging offset register is applied on top
+    void SetDriftPpm(double ppm);
+
+    //losing Vcc stops the oscillator if EOSC is set
+    void SetBatteryPower(bool battery);
+
+    //fault injection: stop the oscillator and set OSF, time stands still
+    //until the oscillator is started again
+    void StopOscillator();
+    void StartOscillator();
+
+    bool InterruptAsserted();
+
+    //raw register value, bypassing the pointer and write rules
+    byte Peek(DS3231RegisterId id);
+    void Poke(DS3231RegisterId id, byte value);
+
+    // RtcEdgeSource interface, reports falling edges on INT/SQW
+    bool Start(const EdgeHandler& handler) override;
+    void Stop() override;
+
+private:
+    void Reset();
+    void Update();
+    void UpdateOscillator();
+    void AdvanceTo(int64_t nowNs);
+    void Tick(int64_t edgeNs);
+    bool OscillatorRunning() const;
+    void WriteRegister(byte id, byte value);
+    void UpdateInterrupt(int64_t nowNs);
+    bool MatchAlarm1() const;
+    bool MatchAlarm2() const;
+    int MilitaryHour(byte value) const;
+    void DeliverEdges();
+};
+
+#endif // DS3231SIMULATOR_H
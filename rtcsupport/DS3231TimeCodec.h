@@ -0,0 +1,120 @@
+#ifndef DS3231TIMECODEC_H
+#define DS3231TIMECODEC_H
+
+#include "LocalTypes.h"
+#include "BcdCodec.h"
+#include "DS3231Registers.h"
+#include "RtcTime.h"
+
+namespace rtc
+{
+    //Single pass conversion between the seven DS3231 time registers
+    //(Seconds through Year) and RtcDateTime. Each field is one mask and
+    //one table lookup, the hour format is picked by table as well.
+    class DS3231TimeCodec
+    {
+        struct HourFormat
+        {
+            ClockMode Mode;
+            Meridiem Period;
+            byte Mask;
+        };
+
+        //indexed by the 12/24 and AM/PM bits of the hours register. In 24
+        //hour mode the AM/PM bit is the 20 hour digit.
+        static const HourFormat* HourFormats()
+        {
+            static const HourFormat formats[4] =
+            {
+                { ClockMode::MilitaryClock, Meridiem::None, DS3231RegisterMasks::HourLinearMsb | DS3231RegisterMasks::HourLsb },
+                { ClockMode::MilitaryClock, Meridiem::None, DS3231RegisterMasks::HourLinearMsb | DS3231RegisterMasks::HourLsb },
+                { ClockMode::WallClock, Meridiem::Am, DS3231RegisterMasks::HourWallMsb | DS3231RegisterMasks::HourLsb },
+                { ClockMode::WallClock, Meridiem::Pm, DS3231RegisterMasks::HourWallMsb | DS3231RegisterMasks::HourLsb }
+            };
+            return formats;
+        }
+
+        //register value 1-7 to DayOfWeek, Monday is day 1
+        static const DayOfWeek* WeekDays()
+        {
+            static const DayOfWeek days[8] =
+            {
+                DayOfWeek::None,
+                DayOfWeek::Mon, DayOfWeek::Tue, DayOfWeek::Wed, DayOfWeek::Thu,
+                DayOfWeek::Fri, DayOfWeek::Sat, DayOfWeek::Sun
+            };
+            return days;
+        }
+
+        //DayOfWeek to register value, the inverse of WeekDays
+        static const byte* WeekDayValues()
+        {
+            static const byte values[8] = { 0, 7, 1, 2, 3, 4, 5, 6 };
+            return values;
+        }
+
+        //decoded month register (0-19 for valid BCD in the month mask) to Months
+        static const Months* MonthValues()
+        {
+            static const Months months[32] =
+            {
+                Months::None,
+                Months::Jan, Months::Feb, Months::Mar, Months::Apr,
+                Months::May, Months::Jun, Months::Jul, Months::Aug,
+                Months::Sep, Months::Oct, Months::Nov, Months::Dec
+            };
+            return months;
+        }
+
+    public:
+        static const int RegisterCount = 7;
+
+        static void Decode(const byte* registers, RtcDateTime& value)
+        {
+            const auto& bcd = bcd::Lookup.Decoded;
+
+            auto hours = registers[2];
+            const auto& format = HourFormats()[(hours >> 5) & 0x03];
+
+            value.Time.Second = bcd[registers[0] & (DS3231RegisterMasks::SecondsMsb | DS3231RegisterMasks::SecondsLsb)];
+            value.Time.Minute = bcd[registers[1] & (DS3231RegisterMasks::MinutesMsb | DS3231RegisterMasks::MinutesLsb)];
+            value.Time.Mode = format.Mode;
+            value.Time.Period = format.Period;
+            value.Time.Hour = bcd[hours & format.Mask];
+
+            value.WeekDay = WeekDays()[registers[3] & DS3231RegisterMasks::WeekDay];
+            value.Day = bcd[registers[4] & (DS3231RegisterMasks::DateMsb | DS3231RegisterMasks::DateLsb)];
+            value.Month = MonthValues()[bcd[registers[5] & (DS3231RegisterMasks::MonthMsb | DS3231RegisterMasks::MonthLsb)]];
+            value.Year = bcd[registers[6]] + ((registers[5] & DS3231RegisterMasks::MonthCentury) ? 2000 : 1900);
+        }
+
+        static void Encode(const RtcDateTime& value, byte* registers)
+        {
+            registers[0] = bcd::ToBcd(byte(value.Time.Second)) & (DS3231RegisterMasks::SecondsMsb | DS3231RegisterMasks::SecondsLsb);
+            registers[1] = bcd::ToBcd(byte(value.Time.Minute)) & (DS3231RegisterMasks::MinutesMsb | DS3231RegisterMasks::MinutesLsb);
+
+            if (value.Time.Mode == ClockMode::WallClock)
+            {
+                registers[2] = DS3231RegisterMasks::HourMode |
+                    (value.Time.Period == Meridiem::Pm ? DS3231RegisterMasks::HourPeriod : 0) |
+                    (bcd::ToBcd(byte(value.Time.Hour)) & (DS3231RegisterMasks::HourWallMsb | DS3231RegisterMasks::HourLsb));
+            }
+            else
+            {
+                registers[2] = bcd::ToBcd(byte(value.Time.Hour)) & (DS3231RegisterMasks::HourLinearMsb | DS3231RegisterMasks::HourLsb);
+            }
+
+            registers[3] = WeekDayValues()[int(value.WeekDay) & 0x07];
+            registers[4] = bcd::ToBcd(byte(value.Day)) & (DS3231RegisterMasks::DateMsb | DS3231RegisterMasks::DateLsb);
+
+            auto century = value.Year >= 2000;
+            auto year = value.Year - (century ? 2000 : 1900);
+
+            registers[5] = (bcd::ToBcd(byte(value.Month)) & (DS3231RegisterMasks::MonthMsb | DS3231RegisterMasks::MonthLsb)) |
+                (century ? DS3231RegisterMasks::MonthCentury : 0);
+            registers[6] = bcd::ToBcd(byte(year));
+        }
+    };
+} //namespace rtc
+
+#endif // DS3231TIMECODEC_H
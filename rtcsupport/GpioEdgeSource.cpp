@@ -0,0 +1,86 @@
+#include "GpioEdgeSource.h"
+#include "I2CGpioBus.h"
+#include "LogSupport.h"
+#include "gpio/pigpio.h"
+#include <time.h>
+
+using namespace rtc;
+
+GpioEdgeSource::GpioEdgeSource(int gpio, EdgeDirection direction /*= EdgeDirection::Falling*/)
+    : _gpio(gpio),
+      _direction(direction),
+      _started(false)
+{
+}
+
+GpioEdgeSource::~GpioEdgeSource()
+{
+    Stop();
+}
+
+bool GpioEdgeSource::Start(const EdgeHandler& handler)
+{
+    if (_started)
+    {
+        return false;
+    }
+
+    if (!I2CGpioBus::AcquireGpio())
+    {
+        return false;
+    }
+
+    _handler = handler;
+
+    //SQW and INT are open drain
+    gpioSetMode(_gpio, PI_INPUT);
+    gpioSetPullUpDown(_gpio, PI_PUD_UP);
+
+    auto result = gpioSetAlertFuncEx(_gpio, &GpioEdgeSource::Alert, this);
+    if (result < 0)
+    {
+        logError << "gpioSetAlertFuncEx failed with (" << result << ")";
+
+        I2CGpioBus::ReleaseGpio();
+        return false;
+    }
+
+    _started = true;
+
+    return true;
+}
+
+void GpioEdgeSource::Stop()
+{
+    if (!_started)
+    {
+        return;
+    }
+
+    gpioSetAlertFuncEx(_gpio, nullptr, nullptr);
+    I2CGpioBus::ReleaseGpio();
+
+    _started = false;
+}
+
+void GpioEdgeSource::Alert(int /*gpio*/, int level, uint32_t tick, void* userdata)
+{
+    auto source = static_cast<GpioEdgeSource*>(userdata);
+
+    //level 2 is a watchdog timeout rather than an edge
+    auto wanted = source->_direction == EdgeDirection::Falling ? 0 : 1;
+    if (level != wanted)
+    {
+        return;
+    }
+
+    //translate the sample tick into CLOCK_MONOTONIC by measuring how long
+    //ago it was, the unsigned subtraction copes with the tick wrapping
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    uint32_t age = gpioTick() - tick;
+
+    auto nowNs = int64_t(now.tv_sec) * 1000000000LL + now.tv_nsec;
+
+    source->_handler(nowNs - int64_t(age) * 1000);
+}
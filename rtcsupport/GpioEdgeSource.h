@@ -0,0 +1,42 @@
+#ifndef GPIOEDGESOURCE_H
+#define GPIOEDGESOURCE_H
+
+#include "RtcEdgeSource.h"
+
+namespace rtc
+{
+    enum class EdgeDirection
+    {
+        Rising,
+        Falling
+    };
+
+    //Edge source watching a user gpio through pigpio alerts. The alert
+    //carries the tick of the sample that saw the change, so the time
+    //stamp is accurate to the pigpio sample rate even though the
+    //callback itself arrives up to a millisecond later.
+    class GpioEdgeSource : public RtcEdgeSource
+    {
+        int _gpio;
+        EdgeDirection _direction;
+
+        EdgeHandler _handler;
+        bool _started;
+
+    public:
+        //the DS3231 seconds register advances on the falling edge of the
+        //1Hz output, and INT is active low
+        GpioEdgeSource(int gpio, EdgeDirection direction = EdgeDirection::Falling);
+        ~GpioEdgeSource();
+
+        GpioEdgeSource(const GpioEdgeSource&) = delete;
+
+        bool Start(const EdgeHandler& handler) override;
+        void Stop() override;
+
+    private:
+        static void Alert(int gpio, int level, uint32_t tick, void* userdata);
+    };
+} //namespace rtc
+
+#endif // GPIOEDGESOURCE_H
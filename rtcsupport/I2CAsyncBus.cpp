@@ -0,0 +1,305 @@
+#include "I2CAsyncBus.h"
+#include "LogSupport.h"
+
+//empty ring checks before the I/O thread sleeps
+static const int DefaultSpinCount = 2000;
+
+I2CAsyncBus::I2CAsyncBus(I2CBus* bus)
+    : _bus(bus),
+      _pendingCompletions(0),
+      _started(false),
+      _stopping(false),
+      _sleeping(false),
+      _spinCount(DefaultSpinCount)
+{
+    //spinning only helps when the submitting thread runs on another core
+    if (std::thread::hardware_concurrency() == 1)
+    {
+        _spinCount = 0;
+    }
+}
+
+I2CAsyncBus::~I2CAsyncBus()
+{
+    Stop();
+}
+
+bool I2CAsyncBus::Start()
+{
+    if (_started)
+    {
+        return true;
+    }
+
+    _stopping.store(false);
+    _thread = std::thread(&I2CAsyncBus::Run, this);
+    _started = true;
+
+    return true;
+}
+
+void I2CAsyncBus::Stop()
+{
+    if (!_started)
+    {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(_lock);
+        _stopping.store(true);
+    }
+
+    _wake.notify_one();
+    _thread.join();
+
+    _started = false;
+}
+
+bool I2CAsyncBus::Enqueue(Request&& request)
+{
+    if (!_submissions.Push(std::move(request)))
+    {
+        return false;
+    }
+
+    //pairs with the fence in Run: either the I/O thread sees the request
+    //before it sleeps or we see it sleeping and wake it
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (_sleeping.load(std::memory_order_relaxed))
+    {
+        std::lock_guard<std::mutex> lock(_lock);
+        _wake.notify_one();
+    }
+
+    return true;
+}
+
+bool I2CAsyncBus::SubmitAsync(I2CTransaction& transaction, CompletionHandler handler)
+{
+    return SubmitAsync(*_bus, transaction, std::move(handler));
+}
+
+bool I2CAsyncBus::SubmitAsync(I2CBus& device, I2CTransaction& transaction, CompletionHandler handler)
+{
+    if (!_started || _pendingCompletions == int(QueueDepth))
+    {
+        return false;
+    }
+
+    Request request;
+    request.Target = &device;
+    request.Transaction = &transaction;
+    request.Handler = std::move(handler);
+
+    if (!Enqueue(std::move(request)))
+    {
+        return false;
+    }
+
+    _pendingCompletions++;
+
+    return true;
+}
+
+std::future<Status> I2CAsyncBus::SubmitAsync(I2CTransaction& transaction)
+{
+    Request request;
+    request.Target = _bus;
+    request.Transaction = &transaction;
+    request.Promise.reset(new std::promise<Status>());
+
+    auto future = request.Promise->get_future();
+
+    if (!_started || !Enqueue(std::move(request)))
+    {
+        std::promise<Status> busy;
+        busy.set_value(Status::Busy);
+        return busy.get_future();
+    }
+
+    return future;
+}
+
+int I2CAsyncBus::Poll()
+{
+    auto count = 0;
+
+    Completion completion;
+    while (_completions.Pop(completion))
+    {
+        _pendingCompletions--;
+        count++;
+
+        completion.Handler(completion.Result);
+    }
+
+    return count;
+}
+
+void I2CAsyncBus::Drain()
+{
+    while (_pendingCompletions > 0)
+    {
+        if (Poll() == 0)
+        {
+            std::this_thread::yield();
+        }
+    }
+}
+
+Status I2CAsyncBus::Call(const std::function<Status(I2CBus&)>& operation)
+{
+    if (!_started)
+    {
+        return operation(*_bus);
+    }
+
+    Request request;
+    request.Target = _bus;
+    request.Operation = operation;
+    request.Promise.reset(new std::promise<Status>());
+
+    auto future = request.Promise->get_future();
+
+    //a blocking call waits for room rather than failing
+    while (!Enqueue(std::move(request)))
+    {
+        std::this_thread::yield();
+    }
+
+    return future.get();
+}
+
+void I2CAsyncBus::Run()
+{
+    auto idle = 0;
+
+    for (;;)
+    {
+        Request request;
+        if (_submissions.Pop(request))
+        {
+            Execute(request);
+            idle = 0;
+            continue;
+        }
+
+        //only leave once everything queued before Stop has run
+        if (_stopping.load())
+        {
+            return;
+        }
+
+        if (idle++ < _spinCount)
+        {
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(_lock);
+
+        _sleeping.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        if (_submissions.Empty() && !_stopping.load())
+        {
+            _wake.wait(lock);
+        }
+
+        _sleeping.store(false, std::memory_order_relaxed);
+        idle = 0;
+    }
+}
+
+void I2CAsyncBus::Execute(Request& request)
+{
+    auto result = request.Transaction != nullptr
+        ? request.Target->Submit(*request.Transaction)
+        : request.Operation(*request.Target);
+
+    if (request.Promise)
+    {
+        request.Promise->set_value(result);
+        request.Promise.reset();
+    }
+
+    if (request.Handler)
+    {
+        Completion completion;
+        completion.Handler = std::move(request.Handler);
+        completion.Result = result;
+
+        //cannot fail, submissions stop once QueueDepth handlers are pending
+        if (!_completions.Push(std::move(completion)))
+        {
+            logError << "i2c completion ring overflow";
+        }
+
+        if (_completionNotify)
+        {
+            _completionNotify();
+        }
+    }
+
+    request.Operation = nullptr;
+    request.Handler = nullptr;
+}
+
+Status I2CAsyncBus::Send(byte value)
+{
+    return Call([value](I2CBus& bus) { return bus.Send(value); });
+}
+
+Status I2CAsyncBus::Send(byte cmd, byte value)
+{
+    return Call([cmd, value](I2CBus& bus) { return bus.Send(cmd, value); });
+}
+
+Status I2CAsyncBus::Send(byte cmd, byte* data, int dataLen)
+{
+    return Call([cmd, data, dataLen](I2CBus& bus) { return bus.Send(cmd, data, dataLen); });
+}
+
+Status I2CAsyncBus::Send(byte cmd, word value)
+{
+    return Call([cmd, value](I2CBus& bus) { return bus.Send(cmd, value); });
+}
+
+Status I2CAsyncBus::Receive(byte& value)
+{
+    auto target = &value;
+    return Call([target](I2CBus& bus) { return bus.Receive(*target); });
+}
+
+Status I2CAsyncBus::Receive(byte cmd, byte& value)
+{
+    auto target = &value;
+    return Call([cmd, target](I2CBus& bus) { return bus.Receive(cmd, *target); });
+}
+
+Status I2CAsyncBus::Receive(byte cmd, byte* data, int dataLen)
+{
+    return Call([cmd, data, dataLen](I2CBus& bus) { return bus.Receive(cmd, data, dataLen); });
+}
+
+Status I2CAsyncBus::Receive(byte cmd, word& value)
+{
+    auto target = &value;
+    return Call([cmd, target](I2CBus& bus) { return bus.Receive(cmd, *target); });
+}
+
+Status I2CAsyncBus::Send(byte cmd, const I2CSpan* spans, int spanCount)
+{
+    return Call([cmd, spans, spanCount](I2CBus& bus) { return bus.Send(cmd, spans, spanCount); });
+}
+
+Status I2CAsyncBus::Receive(byte cmd, const I2CSpan* spans, int spanCount)
+{
+    return Call([cmd, spans, spanCount](I2CBus& bus) { return bus.Receive(cmd, spans, spanCount); });
+}
+
+Status I2CAsyncBus::Submit(I2CTransaction& transaction)
+{
+    auto target = &transaction;
+    return Call([target](I2CBus& bus) { return bus.Submit(*target); });
+}
@@ -0,0 +1,164 @@
+#ifndef I2CASYNCBUS_H
+#define I2CASYNCBUS_H
+
+#include "I2CBus.h"
+#include "I2CRing.h"
+#include "I2CTransaction.h"
+#include <stdint.h>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+//Moves every transfer on a bus onto a dedicated I/O thread. Requests go
+//through a lock-free submission ring and handlers come back through a
+//completion ring, so the submitting thread never waits on the bus unless
+//it asks to.
+//
+//Requests are I2CTransactions. A transaction and its read destinations
+//belong to the I/O thread from submission until its handler runs or its
+//future is ready. Handlers run on the submitting thread from Poll, futures
+//are made ready by the I/O thread.
+//
+//The rings are single producer: submit, Poll and the blocking I2CBus calls
+//from one thread. The blocking calls queue behind anything already
+//submitted. Transactions can name another bus on the same adapter, so
+//one I/O thread can serve every device on it.
+class I2CAsyncBus : public I2CBus
+{
+public:
+    static const size_t QueueDepth = 64;
+
+    typedef std::function<void(Status)> CompletionHandler;
+
+private:
+    struct Request
+    {
+        I2CBus* Target;
+        I2CTransaction* Transaction;
+        //used for the blocking calls that have no transaction form
+        std::function<Status(I2CBus&)> Operation;
+
+        CompletionHandler Handler;
+        std::unique_ptr<std::promise<Status>> Promise;
+
+        Request() :
+            Target(nullptr),
+            Transaction(nullptr)
+        {
+        }
+    };
+
+    struct Completion
+    {
+        CompletionHandler Handler;
+        Status Result;
+    };
+
+    I2CBus* _bus;
+
+    I2CRing<Request, QueueDepth> _submissions;
+    I2CRing<Completion, QueueDepth> _completions;
+
+    //handlers submitted but not run by Poll yet, submitting thread only.
+    //Never more than QueueDepth, so the completion ring cannot overflow.
+    int _pendingCompletions;
+
+    std::thread _thread;
+    bool _started;
+    std::atomic<bool> _stopping;
+
+    //the I/O thread sleeps on the condition once the ring stays empty
+    std::mutex _lock;
+    std::condition_variable _wake;
+    std::atomic<bool> _sleeping;
+    int _spinCount;
+
+    std::function<void()> _completionNotify;
+
+public:
+    I2CAsyncBus(I2CBus* bus);
+    ~I2CAsyncBus();
+
+    I2CAsyncBus(const I2CAsyncBus&) = delete;
+
+    I2CBus* Bus() const
+    {
+        return _bus;
+    }
+
+    //how often the I/O thread checks an empty ring before sleeping,
+    //trading a core for wake up latency. Set before Start.
+    void SetSpinCount(int count)
+    {
+        _spinCount = count;
+    }
+
+    //called on the I/O thread after each handler completion is queued,
+    //so an event loop can sleep until there is something to Poll. Set
+    //before Start.
+    void SetCompletionNotify(std::function<void()> notify)
+    {
+        _completionNotify = std::move(notify);
+    }
+
+    bool Start();
+
+    //finishes the queued requests first, handlers still need a Poll
+    void Stop();
+
+    bool Running() const
+    {
+        return _started;
+    }
+
+    //queue a transaction, false if the ring is full
+    bool SubmitAsync(I2CTransaction& transaction, CompletionHandler handler);
+
+    //queue a transaction for another bus on the same adapter, such as a
+    //second device address, so one I/O thread serves the whole adapter
+    bool SubmitAsync(I2CBus& device, I2CTransaction& transaction, CompletionHandler handler);
+
+    //queue a transaction, the future holds Busy if the ring is full
+    std::future<Status> SubmitAsync(I2CTransaction& transaction);
+
+    //run the handlers of the completed transactions, returns how many ran
+    int Poll();
+
+    //wait until every handler submitted so far has run
+    void Drain();
+
+    int PendingCompletions() const
+    {
+        return _pendingCompletions;
+    }
+
+    // I2CBus interface, each call waits for its own completion. Before
+    // Start the calls go straight to the wrapped bus.
+public:
+    Status Send(byte value) override;
+    Status Send(byte cmd, byte value) override;
+    Status Send(byte cmd, byte* data, int dataLen) override;
+    Status Send(byte cmd, word value) override;
+
+    Status Receive(byte& value) override;
+    Status Receive(byte cmd, byte& value) override;
+    Status Receive(byte cmd, byte* data, int dataLen) override;
+    Status Receive(byte cmd, word& value) override;
+
+    Status Send(byte cmd, const I2CSpan* spans, int spanCount) override;
+    Status Receive(byte cmd, const I2CSpan* spans, int spanCount) override;
+
+    Status Submit(I2CTransaction& transaction) override;
+
+private:
+    bool Enqueue(Request&& request);
+    Status Call(const std::function<Status(I2CBus&)>& operation);
+    void Run();
+    void Execute(Request& request);
+};
+
+#endif // I2CASYNCBUS_H
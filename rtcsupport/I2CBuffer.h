@@ -2,6 +2,7 @@
 #define I2CBUFFER_H
 
 #include "IoBuffer.h"
+#include "I2CZipFrame.h"
 
 class I2CBuffer : public IoBuffer
 {
@@ -17,43 +18,211 @@ class I2CBuffer : public IoBuffer
 		Write = 7
 	};
 	
-
+	typedef rtc::zip::Slot8 Slot8;
+	typedef rtc::zip::Slot16 Slot16;
+	
+	typedef rtc::zip::Frame<byte(Commands::Address)> AddressPart;
+	typedef rtc::zip::Frame<byte(Commands::Start)> StartPart;
+	typedef rtc::zip::Frame<byte(Commands::Stop), byte(Commands::End)> StopPart;
+	typedef rtc::zip::Frame<byte(Commands::Write)> ShortWritePart;
+	typedef rtc::zip::Frame<byte(Commands::Escape), byte(Commands::Write)> LongWritePart;
+	typedef rtc::zip::Frame<byte(Commands::Write), 1> RegisterPart;
+	typedef rtc::zip::Frame<byte(Commands::Read)> ShortReadPart;
+	typedef rtc::zip::Frame<byte(Commands::Escape), byte(Commands::Read)> LongReadPart;
+	
+	//Frame shapes, part 1 is always the address. Short shapes carry
+	//lengths up to 255 in one byte, long ones escape to two bytes.
+	
+	//address, start, read count, stop, end
+	typedef rtc::zip::Shape<AddressPart, Slot8, StartPart, ShortReadPart, Slot8, StopPart> ShortRead;
+	typedef rtc::zip::Shape<AddressPart, Slot8, StartPart, LongReadPart, Slot16, StopPart> LongRead;
+	
+	//address, start, write the register, restart, read count, stop, end
+	typedef rtc::zip::Shape<AddressPart, Slot8, StartPart, RegisterPart, Slot8, StartPart, ShortReadPart, Slot8, StopPart> ShortRegisterRead;
+	typedef rtc::zip::Shape<AddressPart, Slot8, StartPart, RegisterPart, Slot8, StartPart, LongReadPart, Slot16, StopPart> LongRegisterRead;
+	
+	//address, start, write length, the register when there is one. The
+	//payload follows, then StopPart.
+	typedef rtc::zip::Shape<AddressPart, Slot8, StartPart, ShortWritePart, Slot8> ShortWrite;
+	typedef rtc::zip::Shape<AddressPart, Slot8, StartPart, LongWritePart, Slot16> LongWrite;
+	typedef rtc::zip::Shape<AddressPart, Slot8, StartPart, ShortWritePart, Slot8, Slot8> ShortRegisterWrite;
+	typedef rtc::zip::Shape<AddressPart, Slot8, StartPart, LongWritePart, Slot16, Slot8> LongRegisterWrite;
+	
 public:
 	explicit I2CBuffer(int capacity) :
         IoBuffer(capacity)
 	{
 	}
 	
+	I2CBuffer(byte* data, int capacity) :
+		IoBuffer(data, capacity)
+	{
+	}
+	
+	I2CBuffer(I2CBuffer&& other) = default;
+	I2CBuffer& operator=(I2CBuffer&& other) = default;
+	
+	//Encoded lengths, for checking a whole frame with CanWrite before
+	//building it. The commands below do not check the capacity.
+	static constexpr int MarkerLength()
+	{
+		return 1;
+	}
+	
+	static constexpr int AddressLength()
+	{
+		return 2;
+	}
+	
+	//the Send command followed by its length bytes of data
+	static constexpr int SendLength(int length)
+	{
+		return (length > 255 ? 4 : 2) + length;
+	}
+	
+	static constexpr int ReceiveLength(int receiveLength)
+	{
+		return receiveLength > 255 ? 4 : 2;
+	}
+	
+	//the longest frame for transfers of up to dataLength bytes: address,
+	//start, a register write, restart, the transfer, stop and end
+	static constexpr int FrameLength(int dataLength)
+	{
+		return AddressLength() + 4 * MarkerLength() + SendLength(dataLength + 1) + ReceiveLength(dataLength);
+	}
+	
+	static constexpr int ReadFrameLength(int count)
+	{
+		return count > 255 ? LongRead::Length : ShortRead::Length;
+	}
+	
+	static constexpr int RegisterReadFrameLength(int count)
+	{
+		return count > 255 ? LongRegisterRead::Length : ShortRegisterRead::Length;
+	}
+	
+	static constexpr int WriteFrameLength(int length)
+	{
+		return (length > 255 ? LongWrite::Length : ShortWrite::Length) + length + StopPart::Length;
+	}
+	
+	//length counts the payload, not the register
+	static constexpr int RegisterWriteFrameLength(int length)
+	{
+		return (length + 1 > 255 ? LongRegisterWrite::Length : ShortRegisterWrite::Length) + length + StopPart::Length;
+	}
+	
+	//Whole frames, copied from the templates above with the address,
+	//register, lengths and payload patched in. Like the commands below
+	//they do not check the capacity, use the *FrameLength helpers.
+	void ReadFrame(byte address, int count)
+	{
+		if (count > 255)
+		{
+			auto frame = Emit<LongRead>();
+			frame[LongRead::Offset<1>()] = address;
+			rtc::zip::Patch16(frame + LongRead::Offset<4>(), count);
+		}
+		else
+		{
+			auto frame = Emit<ShortRead>();
+			frame[ShortRead::Offset<1>()] = address;
+			frame[ShortRead::Offset<4>()] = byte(count);
+		}
+	}
+	
+	void RegisterReadFrame(byte address, byte cmd, int count)
+	{
+		if (count > 255)
+		{
+			auto frame = Emit<LongRegisterRead>();
+			frame[LongRegisterRead::Offset<1>()] = address;
+			frame[LongRegisterRead::Offset<4>()] = cmd;
+			rtc::zip::Patch16(frame + LongRegisterRead::Offset<7>(), count);
+		}
+		else
+		{
+			auto frame = Emit<ShortRegisterRead>();
+			frame[ShortRegisterRead::Offset<1>()] = address;
+			frame[ShortRegisterRead::Offset<4>()] = cmd;
+			frame[ShortRegisterRead::Offset<7>()] = byte(count);
+		}
+	}
+	
+	void WriteFrame(byte address, const byte* data, int length)
+	{
+		if (length > 255)
+		{
+			auto frame = Emit<LongWrite>();
+			frame[LongWrite::Offset<1>()] = address;
+			rtc::zip::Patch16(frame + LongWrite::Offset<4>(), length);
+		}
+		else
+		{
+			auto frame = Emit<ShortWrite>();
+			frame[ShortWrite::Offset<1>()] = address;
+			frame[ShortWrite::Offset<4>()] = byte(length);
+		}
+		
+		Put(data, length);
+		Emit<rtc::zip::Shape<StopPart>>();
+	}
+	
+	void RegisterWriteFrame(byte address, byte cmd, const byte* data, int length)
+	{
+		//the register is part of the write
+		auto sendLength = length + 1;
+		
+		if (sendLength > 255)
+		{
+			auto frame = Emit<LongRegisterWrite>();
+			frame[LongRegisterWrite::Offset<1>()] = address;
+			rtc::zip::Patch16(frame + LongRegisterWrite::Offset<4>(), sendLength);
+			frame[LongRegisterWrite::Offset<5>()] = cmd;
+		}
+		else
+		{
+			auto frame = Emit<ShortRegisterWrite>();
+			frame[ShortRegisterWrite::Offset<1>()] = address;
+			frame[ShortRegisterWrite::Offset<4>()] = byte(sendLength);
+			frame[ShortRegisterWrite::Offset<5>()] = cmd;
+		}
+		
+		Put(data, length);
+		Emit<rtc::zip::Shape<StopPart>>();
+	}
+	
 	void Start()
 	{
-		Write(byte(Commands::Start));
+		Put(byte(Commands::Start));
 	}
 
     //Same command as Start but the semantics are different
     void Restart()
     {
-        Write(byte(Commands::Start));
+        Put(byte(Commands::Start));
     }
 
 	void Stop()
 	{
-		Write(byte(Commands::Stop));
+		Put(byte(Commands::Stop));
 	}
 
 	void End()
 	{
-		Write(byte(Commands::End));
+		Put(byte(Commands::End));
 	}
 
     void StopAndEnd()
     {
-        Write(byte(Commands::Stop));
-        Write(byte(Commands::End));
+        Put(byte(Commands::Stop));
+        Put(byte(Commands::End));
     }
 
 	void Escape()
 	{
-		Write(byte(Commands::Escape));
+		Put(byte(Commands::Escape));
 	}
 
 	void Send(int length)
@@ -63,7 +232,7 @@ public:
 			Escape();
 		}
 		
-		Write(byte(Commands::Write));
+		Put(byte(Commands::Write));
 		WriteNumber(length);
 	}
 	
@@ -74,28 +243,37 @@ public:
 			Escape();
 		}
 		
-		Write(byte(Commands::Read));
+		Put(byte(Commands::Read));
 		WriteNumber(receiveLength);
 	}
 	
 	// currently only 127 bit addresses are supported
 	void Address(byte address)
 	{
-		Write(byte(Commands::Address));
-		Write(address);
+		Put(byte(Commands::Address));
+		Put(address);
 	}
 	
 private:
+	//a single memcpy of the template, returns where it starts
+	template <typename Shape>
+	byte* Emit()
+	{
+		auto frame = Data() + WriteLength();
+		Put(Shape::Template::Data, Shape::Length);
+		return frame;
+	}
+	
 	void WriteNumber(int value)
 	{
 		if (value > 255)
 		{
-			Write(byte(value & 0xFF));
-			Write(byte((value >> 8) & 0xFF));
+			Put(byte(value & 0xFF));
+			Put(byte((value >> 8) & 0xFF));
 		}
 		else
 		{
-			Write(byte(value & 0xFF));
+			Put(byte(value & 0xFF));
 		}
 	}
 };
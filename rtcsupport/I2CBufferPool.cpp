@@ -0,0 +1,49 @@
+#include "I2CBufferPool.h"
+
+void I2CBufferPool::Handle::Release()
+{
+    if (_pool != nullptr)
+    {
+        _pool->Release(_block);
+
+        _pool = nullptr;
+        _block = -1;
+        _buffer = I2CBuffer(nullptr, 0);
+    }
+}
+
+I2CBufferPool::I2CBufferPool(int blockCount, int blockSize)
+    : _blockSize((blockSize + 63) & ~63),
+      _blockCount(blockCount < MaxBlocks ? blockCount : MaxBlocks),
+      _storage(new byte[size_t(_blockSize) * _blockCount]),
+      _free(_blockCount == 64 ? ~uint64_t(0) : (uint64_t(1) << _blockCount) - 1)
+{
+}
+
+I2CBufferPool::Handle I2CBufferPool::Acquire()
+{
+    auto free = _free.load(std::memory_order_relaxed);
+
+    while (free != 0)
+    {
+        auto block = __builtin_ctzll(free);
+        auto taken = free & ~(uint64_t(1) << block);
+
+        if (_free.compare_exchange_weak(free, taken, std::memory_order_acquire, std::memory_order_relaxed))
+        {
+            return Handle(this, block, _storage.get() + size_t(block) * _blockSize, _blockSize);
+        }
+    }
+
+    return Handle();
+}
+
+void I2CBufferPool::Release(int block)
+{
+    _free.fetch_or(uint64_t(1) << block, std::memory_order_release);
+}
+
+int I2CBufferPool::Available() const
+{
+    return __builtin_popcountll(_free.load(std::memory_order_relaxed));
+}
@@ -0,0 +1,126 @@
+#ifndef I2CBUFFERPOOL_H
+#define I2CBUFFERPOOL_H
+
+#include "I2CBuffer.h"
+#include <stdint.h>
+#include <atomic>
+#include <memory>
+
+//Fixed set of equally sized frame buffers carved from one allocation.
+//Acquire and release are a single atomic operation on a bitmap of free
+//blocks, safe from any thread, and nothing is zeroed, so the cost does not
+//depend on the block size. Size blocks with I2CBuffer::FrameLength.
+class I2CBufferPool
+{
+public:
+    static const int MaxBlocks = 64;
+
+    //Owns one block while alive, move-only. An empty handle means the
+    //pool had no free block.
+    class Handle
+    {
+        friend class I2CBufferPool;
+
+        I2CBufferPool* _pool;
+        int _block;
+        I2CBuffer _buffer;
+
+        Handle(I2CBufferPool* pool, int block, byte* data, int capacity) :
+            _pool(pool),
+            _block(block),
+            _buffer(data, capacity)
+        {
+        }
+
+    public:
+        Handle() :
+            _pool(nullptr),
+            _block(-1),
+            _buffer(nullptr, 0)
+        {
+        }
+
+        Handle(Handle&& other) :
+            _pool(other._pool),
+            _block(other._block),
+            _buffer(std::move(other._buffer))
+        {
+            other._pool = nullptr;
+            other._block = -1;
+        }
+
+        Handle& operator=(Handle&& other)
+        {
+            if (this != &other)
+            {
+                Release();
+
+                _pool = other._pool;
+                _block = other._block;
+                _buffer = std::move(other._buffer);
+
+                other._pool = nullptr;
+                other._block = -1;
+            }
+
+            return *this;
+        }
+
+        ~Handle()
+        {
+            Release();
+        }
+
+        explicit operator bool() const
+        {
+            return _pool != nullptr;
+        }
+
+        I2CBuffer& operator*()
+        {
+            return _buffer;
+        }
+
+        I2CBuffer* operator->()
+        {
+            return &_buffer;
+        }
+
+        //give the block back early, the handle is empty afterwards
+        void Release();
+    };
+
+private:
+    int _blockSize;
+    int _blockCount;
+    std::unique_ptr<byte[]> _storage;
+
+    //a set bit is a free block
+    std::atomic<uint64_t> _free;
+
+public:
+    //blockSize is rounded up to a multiple of 64 bytes
+    I2CBufferPool(int blockCount, int blockSize);
+
+    I2CBufferPool(const I2CBufferPool&) = delete;
+
+    //an empty handle when every block is in use
+    Handle Acquire();
+
+    int BlockSize() const
+    {
+        return _blockSize;
+    }
+
+    int BlockCount() const
+    {
+        return _blockCount;
+    }
+
+    int Available() const;
+
+private:
+    void Release(int block);
+};
+
+#endif // I2CBUFFERPOOL_H
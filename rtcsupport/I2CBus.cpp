@@ -0,0 +1,93 @@
+#include "I2CBus.h"
+#include "I2CTransaction.h"
+#include <algorithm>
+
+//staging buffer for the default vectored transfers
+static const int StagingSize = 64;
+
+Status I2CBus::Send(byte cmd, const I2CSpan* spans, int spanCount)
+{
+    if (spanCount == 1)
+    {
+        return Send(cmd, spans[0].Data, spans[0].DataLen);
+    }
+
+    I2CSpanCursor cursor(spans, spanCount);
+    auto total = I2CSpanCursor::TotalLength(spans, spanCount);
+
+    byte staging[StagingSize];
+
+    auto offset = 0;
+    while (offset < total)
+    {
+        auto chunk = std::min(StagingSize, total - offset);
+
+        cursor.CopyOut(staging, chunk);
+
+        auto result = Send(byte(cmd + offset), staging, chunk);
+        if (result != Status::Ok)
+        {
+            return result;
+        }
+
+        offset += chunk;
+    }
+
+    return Status::Ok;
+}
+
+Status I2CBus::Receive(byte cmd, const I2CSpan* spans, int spanCount)
+{
+    if (spanCount == 1)
+    {
+        return Receive(cmd, spans[0].Data, spans[0].DataLen);
+    }
+
+    I2CSpanCursor cursor(spans, spanCount);
+    auto total = I2CSpanCursor::TotalLength(spans, spanCount);
+
+    byte staging[StagingSize];
+
+    auto offset = 0;
+    while (offset < total)
+    {
+        auto chunk = std::min(StagingSize, total - offset);
+
+        auto result = Receive(byte(cmd + offset), staging, chunk);
+        if (result != Status::Ok)
+        {
+            return result;
+        }
+
+        cursor.CopyIn(staging, chunk);
+        offset += chunk;
+    }
+
+    return Status::Ok;
+}
+
+Status I2CBus::Submit(I2CTransaction& transaction)
+{
+    for (auto idx = 0; idx < transaction.Count(); idx++)
+    {
+        auto& segment = transaction[idx];
+
+        if (segment.Type == I2CSegmentType::Write)
+        {
+            segment.Result = Send(segment.Cmd,
+                const_cast<byte*>(I2CTransaction::Payload(segment)),
+                I2CTransaction::PayloadLength(segment));
+        }
+        else
+        {
+            segment.Result = Receive(segment.Cmd, segment.Data, segment.DataLen);
+        }
+
+        if (segment.Result != Status::Ok)
+        {
+            return segment.Result;
+        }
+    }
+
+    return Status::Ok;
+}
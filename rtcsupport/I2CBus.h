@@ -4,10 +4,15 @@
 #include "LocalTypes.h"
 #include "IoError.h"
 #include "IoBuffer.h"
+#include "I2CSpan.h"
+
+class I2CTransaction;
 
 class I2CBus
 {
 public:
+    virtual ~I2CBus() {}
+
     virtual Status Send(byte value) = 0;
     virtual Status Send(byte cmd, byte value) = 0;
     virtual Status Send(byte cmd, byte* data, int dataLen) = 0;
@@ -17,6 +22,18 @@ public:
     virtual Status Receive(byte cmd, byte& value) = 0;
     virtual Status Receive(byte cmd, byte* data, int dataLen) = 0;
     virtual Status Receive(byte cmd, word& value) = 0;
+
+    //Vectored block transfers over consecutive registers starting at cmd.
+    //The default stages the spans through a small buffer and issues the
+    //fewest block transfers that hold them; buses that can transfer into
+    //the spans directly override these.
+    virtual Status Send(byte cmd, const I2CSpan* spans, int spanCount);
+    virtual Status Receive(byte cmd, const I2CSpan* spans, int spanCount);
+
+    //Executes every queued segment. The default runs the segments one
+    //at a time through Send/Receive and stops at the first failure;
+    //buses that can issue combined transfers override this.
+    virtual Status Submit(I2CTransaction& transaction);
 };
 
 #endif //I2CBUS_H
@@ -0,0 +1,309 @@
+#include "I2CBusScheduler.h"
+#include <errno.h>
+#include <linux/i2c-dev.h>
+
+//a lower class waits out at most this many grants to higher classes
+static const int DefaultStarvationLimit = 8;
+
+//one waiting transfer, lives on the waiting thread's stack
+struct I2CScheduledDevice::Ticket
+{
+    std::condition_variable Wake;
+    bool Granted;
+
+    Ticket() :
+        Granted(false)
+    {
+    }
+};
+
+I2CScheduledDevice::I2CScheduledDevice(I2CBusScheduler* scheduler, I2CPriority priority)
+    : _scheduler(scheduler),
+      _priority(priority),
+      _address(-1),
+      _force(false),
+      _open(false)
+{
+}
+
+int I2CScheduledDevice::Open(int adapter)
+{
+    if (_open)
+    {
+        return 0;
+    }
+
+    auto result = _scheduler->Open(adapter);
+    if (result == 0)
+    {
+        _open = true;
+    }
+
+    return result;
+}
+
+void I2CScheduledDevice::Close()
+{
+    if (_open)
+    {
+        _open = false;
+        _scheduler->Close();
+    }
+}
+
+int I2CScheduledDevice::Ioctl(unsigned long request, void* arg)
+{
+    if (!_open)
+    {
+        errno = EBADF;
+        return -1;
+    }
+
+    switch (request)
+    {
+    //only remembered, the adapter is switched when a transfer needs it,
+    //so an address claimed by a kernel driver fails on the first transfer
+    case I2C_SLAVE:
+    case I2C_SLAVE_FORCE:
+    {
+        auto address = reinterpret_cast<long>(arg);
+        if (address < 0 || address > 0x7f)
+        {
+            errno = EINVAL;
+            return -1;
+        }
+
+        _address = int(address);
+        _force = request == I2C_SLAVE_FORCE;
+        return 0;
+    }
+
+    case I2C_FUNCS:
+        return _scheduler->Functions(static_cast<unsigned long*>(arg));
+
+    default:
+        return _scheduler->Execute(this, request, arg);
+    }
+}
+
+I2CBusScheduler::I2CBusScheduler(int adapter, I2CDevice* device /*= nullptr*/)
+    : _adapter(adapter),
+      _device(device != nullptr ? device : &_file),
+      _openCount(0),
+      _functions(0),
+      _currentAddress(-1),
+      _busy(false),
+      _starvationLimit(DefaultStarvationLimit),
+      _passedOver(),
+      _stats()
+{
+}
+
+I2CScheduledDevice* I2CBusScheduler::AddClient(I2CPriority priority)
+{
+    std::lock_guard<std::mutex> lock(_lock);
+
+    _clients.emplace_back(new I2CScheduledDevice(this, priority));
+
+    return _clients.back().get();
+}
+
+void I2CBusScheduler::SetStarvationLimit(int grants)
+{
+    std::lock_guard<std::mutex> lock(_lock);
+
+    _starvationLimit = grants;
+}
+
+I2CSchedulerStats I2CBusScheduler::Stats()
+{
+    std::lock_guard<std::mutex> lock(_lock);
+
+    return _stats;
+}
+
+int I2CBusScheduler::Open(int adapter)
+{
+    std::lock_guard<std::mutex> lock(_lock);
+
+    if (adapter != _adapter)
+    {
+        errno = ENODEV;
+        return -1;
+    }
+
+    if (_openCount == 0)
+    {
+        auto result = _device->Open(_adapter);
+        if (result < 0)
+        {
+            return result;
+        }
+
+        unsigned long functions = 0;
+        _functions = _device->Ioctl(I2C_FUNCS, &functions) == 0
+            ? functions
+            : 0;
+
+        _currentAddress = -1;
+    }
+
+    _openCount++;
+
+    return 0;
+}
+
+void I2CBusScheduler::Close()
+{
+    std::lock_guard<std::mutex> lock(_lock);
+
+    if (--_openCount == 0)
+    {
+        _device->Close();
+    }
+}
+
+int I2CBusScheduler::Functions(unsigned long* functions)
+{
+    std::lock_guard<std::mutex> lock(_lock);
+
+    *functions = _functions;
+    return 0;
+}
+
+int I2CBusScheduler::Execute(I2CScheduledDevice* client, unsigned long request, void* arg)
+{
+    Acquire(client);
+
+    //I2C_RDWR messages carry their own addresses
+    auto result = request == I2C_RDWR
+        ? 0
+        : SelectAddress(client);
+
+    if (result == 0)
+    {
+        result = _device->Ioctl(request, arg);
+    }
+
+    auto error = errno;
+    Release();
+    errno = error;
+
+    return result;
+}
+
+//only called by the thread holding the grant
+int I2CBusScheduler::SelectAddress(I2CScheduledDevice* client)
+{
+    if (client->_address == _currentAddress)
+    {
+        return 0;
+    }
+
+    auto request = client->_force ? I2C_SLAVE_FORCE : I2C_SLAVE;
+
+    auto result = _device->Ioctl(request, reinterpret_cast<void*>(long(client->_address)));
+
+    _currentAddress = result == 0
+        ? client->_address
+        : -1;
+
+    std::lock_guard<std::mutex> lock(_lock);
+    _stats.AddressChanges++;
+
+    return result;
+}
+
+void I2CBusScheduler::Acquire(I2CScheduledDevice* client)
+{
+    std::unique_lock<std::mutex> lock(_lock);
+
+    _stats.Grants++;
+
+    if (!_busy)
+    {
+        _busy = true;
+        return;
+    }
+
+    I2CScheduledDevice::Ticket ticket;
+
+    if (client->_waiting.empty())
+    {
+        _ready[int(client->_priority)].push_back(client);
+    }
+    client->_waiting.push_back(&ticket);
+
+    ticket.Wake.wait(lock, [&ticket] { return ticket.Granted; });
+}
+
+void I2CBusScheduler::Release()
+{
+    std::lock_guard<std::mutex> lock(_lock);
+
+    auto client = Next();
+    if (client == nullptr)
+    {
+        _busy = false;
+        return;
+    }
+
+    auto ticket = client->_waiting.front();
+    client->_waiting.pop_front();
+
+    //back of the line for its next transfer
+    if (!client->_waiting.empty())
+    {
+        _ready[int(client->_priority)].push_back(client);
+    }
+
+    //the bus stays busy, it passes straight to the waiter. The ticket
+    //cannot go away before the waiter gets the lock back.
+    ticket->Granted = true;
+    ticket->Wake.notify_one();
+}
+
+I2CScheduledDevice* I2CBusScheduler::Next()
+{
+    auto highest = -1;
+    for (auto idx = 0; idx < PriorityCount && highest < 0; idx++)
+    {
+        if (!_ready[idx].empty())
+        {
+            highest = idx;
+        }
+    }
+
+    if (highest < 0)
+    {
+        return nullptr;
+    }
+
+    auto selected = highest;
+    for (auto idx = highest + 1; idx < PriorityCount; idx++)
+    {
+        if (!_ready[idx].empty() && _passedOver[idx] >= _starvationLimit)
+        {
+            selected = idx;
+            _stats.StarvationGrants++;
+            break;
+        }
+    }
+
+    for (auto idx = 0; idx < PriorityCount; idx++)
+    {
+        if (idx == selected)
+        {
+            _passedOver[idx] = 0;
+        }
+        else if (idx > selected && !_ready[idx].empty())
+        {
+            _passedOver[idx]++;
+        }
+    }
+
+    auto client = _ready[selected].front();
+    _ready[selected].pop_front();
+
+    return client;
+}
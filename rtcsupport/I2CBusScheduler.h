@@ -0,0 +1,129 @@
+#ifndef I2CBUSSCHEDULER_H
+#define I2CBUSSCHEDULER_H
+
+#include "I2CDevice.h"
+#include <stdint.h>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+enum class I2CPriority
+{
+    //time critical reads, served first
+    High,
+    Normal,
+    //register dumps and other long running traffic
+    Bulk
+};
+
+class I2CBusScheduler;
+
+//One client's view of a scheduled adapter. Hand it to an I2CSmbus in
+//place of /dev/i2c-N: I2C_SLAVE only records the client's address, and
+//every transfer waits for its turn on the shared adapter.
+class I2CScheduledDevice : public I2CDevice
+{
+    friend class I2CBusScheduler;
+
+    I2CBusScheduler* _scheduler;
+    I2CPriority _priority;
+
+    int _address;
+    bool _force;
+    bool _open;
+
+    //waiting transfers, only touched under the scheduler lock
+    struct Ticket;
+    std::deque<Ticket*> _waiting;
+
+public:
+    I2CScheduledDevice(I2CBusScheduler* scheduler, I2CPriority priority);
+
+    I2CPriority Priority() const
+    {
+        return _priority;
+    }
+
+    int Open(int adapter) override;
+    void Close() override;
+
+    int Ioctl(unsigned long request, void* arg) override;
+};
+
+struct I2CSchedulerStats
+{
+    uint64_t Grants;
+    uint64_t AddressChanges;
+
+    //grants to a lower class made only because it hit the starvation limit
+    uint64_t StarvationGrants;
+};
+
+//Multiplexes every device on one adapter over a single file. Transfers
+//from any thread are granted one at a time: the highest class with work
+//goes first, clients within a class take turns, and a lower class that
+//has been passed over StarvationLimit times in a row gets the next grant.
+//
+//The slave address is only set when the next SMBus transfer is for a
+//different device; I2C_RDWR carries its addresses in the messages and
+//never needs it. The granted thread issues its own ioctl, there is no
+//dispatcher thread.
+//
+//A grant covers one ioctl, so bulk clients should stay on SMBus sized
+//transfers (I2CSmbusMode::Smbus) to let critical reads in between chunks.
+class I2CBusScheduler
+{
+    friend class I2CScheduledDevice;
+
+    static const int PriorityCount = 3;
+
+    int _adapter;
+    I2CDevFile _file;
+    I2CDevice* _device;
+
+    std::vector<std::unique_ptr<I2CScheduledDevice>> _clients;
+
+    std::mutex _lock;
+    int _openCount;
+    unsigned long _functions;
+    int _currentAddress;
+    bool _busy;
+    int _starvationLimit;
+
+    //clients with waiting transfers, in turn order, per class
+    std::deque<I2CScheduledDevice*> _ready[PriorityCount];
+    int _passedOver[PriorityCount];
+
+    I2CSchedulerStats _stats;
+
+public:
+    //device replaces /dev/i2c-<adapter>, it must outlive the scheduler
+    I2CBusScheduler(int adapter, I2CDevice* device = nullptr);
+
+    I2CBusScheduler(const I2CBusScheduler&) = delete;
+
+    //a new client, owned by the scheduler. Add clients before the
+    //transfers start.
+    I2CScheduledDevice* AddClient(I2CPriority priority);
+
+    //grants a lower class may be passed over while it has work
+    void SetStarvationLimit(int grants);
+
+    I2CSchedulerStats Stats();
+
+private:
+    int Open(int adapter);
+    void Close();
+
+    int Functions(unsigned long* functions);
+
+    int Execute(I2CScheduledDevice* client, unsigned long request, void* arg);
+    void Acquire(I2CScheduledDevice* client);
+    void Release();
+    I2CScheduledDevice* Next();
+    int SelectAddress(I2CScheduledDevice* client);
+};
+
+#endif // I2CBUSSCHEDULER_H
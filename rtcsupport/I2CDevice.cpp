@@ -0,0 +1,39 @@
+#include "I2CDevice.h"
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+
+I2CDevFile::I2CDevFile()
+    : _handle(-1)
+{
+}
+
+I2CDevFile::~I2CDevFile()
+{
+    Close();
+}
+
+int I2CDevFile::Open(int adapter)
+{
+    char filename[20];
+
+    snprintf(filename, 19, "/dev/i2c-%d", adapter);
+    _handle = open(filename, O_RDWR | O_NONBLOCK);
+
+    return _handle < 0 ? -1 : 0;
+}
+
+void I2CDevFile::Close()
+{
+    if (_handle >= 0)
+    {
+        close(_handle);
+        _handle = -1;
+    }
+}
+
+int I2CDevFile::Ioctl(unsigned long request, void* arg)
+{
+    return ioctl(_handle, request, arg);
+}
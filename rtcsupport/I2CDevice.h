@@ -0,0 +1,34 @@
+#ifndef I2CDEVICE_H
+#define I2CDEVICE_H
+
+//File level access to an i2c-dev adapter. I2CSmbus issues every transfer
+//through this, so the kernel can be swapped for a stand-in or wrapped to
+//measure the syscalls. Calls follow the system call convention: -1 with
+//errno set on failure.
+class I2CDevice
+{
+public:
+    virtual ~I2CDevice() {}
+
+    virtual int Open(int adapter) = 0;
+    virtual void Close() = 0;
+
+    virtual int Ioctl(unsigned long request, void* arg) = 0;
+};
+
+// /dev/i2c-N, the real adapter or one created by the i2c-stub module
+class I2CDevFile : public I2CDevice
+{
+    int _handle;
+
+public:
+    I2CDevFile();
+    ~I2CDevFile();
+
+    int Open(int adapter) override;
+    void Close() override;
+
+    int Ioctl(unsigned long request, void* arg) override;
+};
+
+#endif // I2CDEVICE_H
@@ -1,6 +1,7 @@
 #include "I2CGpioBus.h"
 #include "LogSupport.h"
 #include <stdio.h>
+#include <mutex>
 #include "gpio/pigpio.h"
 #include "gpio/i2c.h"
 
@@ -13,20 +14,45 @@
     } \
 } \
 
-bool I2CGpioBus::InitializeGpioBus()
+static std::mutex _gpioLock;
+static int _gpioUsers = 0;
+
+bool I2CGpioBus::AcquireGpio()
 {
-    int result;
+    std::lock_guard<std::mutex> lock(_gpioLock);
+
+    if (_gpioUsers == 0)
+    {
+        int result;
 
-    gpioCfgInterfaces(PI_DISABLE_SOCK_IF | PI_DISABLE_FIFO_IF);
-    gpioCfgMemAlloc(PI_MEM_ALLOC_PAGEMAP);
+        gpioCfgInterfaces(PI_DISABLE_SOCK_IF | PI_DISABLE_FIFO_IF);
+        gpioCfgMemAlloc(PI_MEM_ALLOC_PAGEMAP);
 
-    result = gpioInitialise();
-    check(result);
+        result = gpioInitialise();
+        check(result);
+    }
+
+    _gpioUsers++;
 
     return true;
 }
 
+void I2CGpioBus::ReleaseGpio()
+{
+    std::lock_guard<std::mutex> lock(_gpioLock);
+
+    if (_gpioUsers > 0 && --_gpioUsers == 0)
+    {
+        gpioTerminate();
+    }
+}
+
+bool I2CGpioBus::InitializeGpioBus()
+{
+    return AcquireGpio();
+}
+
 void I2CGpioBus::ShutdownGpioBus()
 {
-    gpioTerminate();
+    ReleaseGpio();
 }
@@ -8,6 +8,11 @@ class I2CGpioBus : public I2CBus
 public:
     I2CGpioBus(const I2CGpioBus&) = delete;
 
+    //pigpio is process wide, these reference count gpioInitialise and
+    //gpioTerminate for every bus or edge source sharing it
+    static bool AcquireGpio();
+    static void ReleaseGpio();
+
 protected:
     I2CGpioBus();
     bool InitializeGpioBus();
@@ -1,9 +1,13 @@
 ﻿#include "LogSupport.h"
+#include "RtcLog.h"
 #include "I2CGpioHardwareBus.h"
 #include <stdio.h>
 #include "gpio/pigpio.h"
 #include "gpio/i2c.h"
 #include "IoError.h"
+#include "I2CTransaction.h"
+#include "I2CZipFrame.h"
+#include <algorithm>
 
 #define check(_v) \
 { \
@@ -19,34 +23,210 @@
     if (_v < 0) \
     { \
         auto e = errno; \
-        LOG(ERROR) << "err: " << e << " - " << strerror(e); \
+        rtcLogError("err: {}", rtc::logging::Errno(e)); \
         return _s; \
     } \
 } \
 
-I2CGpioHardwareBus::I2CGpioHardwareBus(int adapter, int address)
+#define checkStatusReturn(_s) \
+{ \
+    auto __result = _s; \
+    if (__result != Status::Ok) \
+    { \
+        return __result; \
+    } \
+} \
+
+//i2cZip frames for Combined mode. The device address comes from the
+//handle, and i2cZip gathers everything up to the end into one
+//i2cSegments call, so the register write and the read are joined by a
+//repeated start.
+namespace
+{
+    using namespace rtc::zip;
+
+    typedef Frame<PI_I2C_WRITE, 1> RegisterPart;
+    typedef Frame<PI_I2C_END> EndPart;
+
+    //write the register, read count bytes
+    typedef Shape<RegisterPart, Slot8, Frame<PI_I2C_READ>, Slot8, EndPart> ShortRegisterRead;
+    typedef Shape<RegisterPart, Slot8, Frame<PI_I2C_ESC, PI_I2C_READ>, Slot16, EndPart> LongRegisterRead;
+
+    //write length, the register. The payload and EndPart follow.
+    typedef Shape<Frame<PI_I2C_WRITE>, Slot8, Slot8> ShortRegisterWrite;
+    typedef Shape<Frame<PI_I2C_ESC, PI_I2C_WRITE>, Slot16, Slot8> LongRegisterWrite;
+}
+
+I2CGpioHardwareBus::I2CGpioHardwareBus(int adapter, int address, int maxTransfer /*= DefaultMaxTransfer*/)
     : _adapter(adapter),
       _address(address),
-	_i2cHandle(-1)
+	_i2cHandle(-1),
+      _mode(I2CGpioHardwareMode::Smbus),
+      _frameCapacity(LongRegisterWrite::Length + maxTransfer + EndPart::Length),
+      _restoreCombined(false)
 {
+    _frame.reset(new byte[_frameCapacity]);
 }
 
 bool I2CGpioHardwareBus::Initialize()
 {
     check(InitializeGpioBus());
 
-    _i2cHandle = i2cOpen(1, _address, 0);
+    _i2cHandle = i2cOpen(_adapter, _address, 0);
     check(_i2cHandle);
 
+    if (_mode == I2CGpioHardwareMode::Combined)
+    {
+        SwitchCombined();
+    }
+
     return true;
 }
 
 void I2CGpioHardwareBus::Close()
 {
+    RestoreCombined();
+
     i2cClose(_i2cHandle);
+    _i2cHandle = -1;
+
     ShutdownGpioBus();
 }
 
+void I2CGpioHardwareBus::SetMode(I2CGpioHardwareMode mode)
+{
+    _mode = mode;
+
+    if (_i2cHandle >= 0)
+    {
+        if (mode == I2CGpioHardwareMode::Combined)
+        {
+            SwitchCombined();
+        }
+        else
+        {
+            RestoreCombined();
+        }
+    }
+}
+
+//The parameter only exists with the legacy i2c_bcm2708 driver. It is
+//module wide, so it is put back the way it was found when the bus closes.
+void I2CGpioHardwareBus::SwitchCombined()
+{
+    if (_restoreCombined)
+    {
+        return;
+    }
+
+    auto file = fopen(PI_I2C_COMBINED, "r");
+    if (file == nullptr)
+    {
+        return;
+    }
+
+    auto current = fgetc(file);
+    fclose(file);
+
+    if (current == 'Y' || current == '1')
+    {
+        return;
+    }
+
+    i2cSwitchCombined(1);
+    _restoreCombined = true;
+}
+
+void I2CGpioHardwareBus::RestoreCombined()
+{
+    if (_restoreCombined)
+    {
+        i2cSwitchCombined(0);
+        _restoreCombined = false;
+    }
+}
+
+Status I2CGpioHardwareBus::Zip(const byte* frame, int frameLength, byte* data, int dataLen)
+{
+    //i2cZip wants room for one byte more than a read fills (it tests
+    //bytes + outPos < outLen) but only ever writes dataLen
+    auto result = i2cZip(_i2cHandle,
+        (char*) frame,
+        frameLength,
+        (char*) data,
+        dataLen > 0 ? dataLen + 1 : 0);
+    if (result < 0)
+    {
+        rtcLogError("i2cZip failed with ({}){}", result, getErrorMessage(result));
+
+        return dataLen > 0
+            ? Status::ReceiveFail
+            : Status::SendFail;
+    }
+
+    if (result < dataLen)
+    {
+        return Status::ReceivedLessThanExpected;
+    }
+
+    return Status::Ok;
+}
+
+Status I2CGpioHardwareBus::ZipRead(byte cmd, byte* data, int dataLen)
+{
+    byte frame[LongRegisterRead::Length];
+
+    if (dataLen > 255)
+    {
+        LongRegisterRead::Emit(frame);
+        frame[LongRegisterRead::Offset<1>()] = cmd;
+        Patch16(frame + LongRegisterRead::Offset<3>(), dataLen);
+
+        return Zip(frame, LongRegisterRead::Length, data, dataLen);
+    }
+
+    ShortRegisterRead::Emit(frame);
+    frame[ShortRegisterRead::Offset<1>()] = cmd;
+    frame[ShortRegisterRead::Offset<3>()] = byte(dataLen);
+
+    return Zip(frame, ShortRegisterRead::Length, data, dataLen);
+}
+
+Status I2CGpioHardwareBus::ZipWrite(byte cmd, const byte* data, int dataLen)
+{
+    //the register is part of the write
+    auto sendLength = dataLen + 1;
+
+    auto headLength = sendLength > 255
+        ? int(LongRegisterWrite::Length)
+        : int(ShortRegisterWrite::Length);
+
+    if (headLength + dataLen + EndPart::Length > _frameCapacity)
+    {
+        return Status::WriteOverflow;
+    }
+
+    auto frame = _frame.get();
+
+    if (sendLength > 255)
+    {
+        LongRegisterWrite::Emit(frame);
+        Patch16(frame + LongRegisterWrite::Offset<1>(), sendLength);
+        frame[LongRegisterWrite::Offset<2>()] = cmd;
+    }
+    else
+    {
+        ShortRegisterWrite::Emit(frame);
+        frame[ShortRegisterWrite::Offset<1>()] = byte(sendLength);
+        frame[ShortRegisterWrite::Offset<2>()] = cmd;
+    }
+
+    memcpy(frame + headLength, data, dataLen);
+    frame[headLength + dataLen] = PI_I2C_END;
+
+    return Zip(frame, headLength + dataLen + EndPart::Length, nullptr, 0);
+}
+
 
 Status I2CGpioHardwareBus::Send(byte value)
 {
@@ -57,6 +237,11 @@ Status I2CGpioHardwareBus::Send(byte value)
 
 Status I2CGpioHardwareBus::Send(byte cmd, byte value)
 {
+    if (_mode == I2CGpioHardwareMode::Combined)
+    {
+        return ZipWrite(cmd, &value, 1);
+    }
+
     checkStatus(i2cWriteByteData(_i2cHandle, cmd, value), Status::SendFail);
 
     return Status::Ok;
@@ -66,27 +251,24 @@ Status I2CGpioHardwareBus::Send(byte cmd, byte value)
 
 Status I2CGpioHardwareBus::Send(byte cmd, byte* data, int dataLen)
 {
-    int result;
-
-    if (dataLen <= I2C_BLOCK_SIZE)
+    if (_mode == I2CGpioHardwareMode::Combined)
     {
-        result = i2cWriteBlockData(_i2cHandle, uint32_t(cmd), (char*) data, dataLen);
-        checkStatus(result, Status::SendFail);
+        return ZipWrite(cmd, data, dataLen);
     }
-    else
+
+    //each chunk starts at the register after the previous chunk
+    auto offset = 0;
+    while (offset < dataLen)
     {
-        int suboffset = 0;
+        auto chunk = std::min(I2C_BLOCK_SIZE, dataLen - offset);
 
-        while (suboffset < dataLen)
-        {
-            result = i2cWriteBlockData(_i2cHandle,
-                cmd + suboffset,
-                (char*) (data + suboffset),
-                std::min(I2C_BLOCK_SIZE, dataLen - suboffset));
-            checkStatus(result, Status::SendFail);
+        auto result = i2cWriteI2CBlockData(_i2cHandle,
+            byte(cmd + offset),
+            (char*) (data + offset),
+            chunk);
+        checkStatus(result, Status::SendFail);
 
-            suboffset += I2C_BLOCK_SIZE;
-        }
+        offset += chunk;
     }
 
     return Status::Ok;
@@ -94,6 +276,13 @@ Status I2CGpioHardwareBus::Send(byte cmd, byte* data, int dataLen)
 
 Status I2CGpioHardwareBus::Send(byte cmd, word value)
 {
+    if (_mode == I2CGpioHardwareMode::Combined)
+    {
+        //SMBus word order, low byte first
+        byte data[] = { byte(value & 0xFF), byte(value >> 8) };
+        return ZipWrite(cmd, data, sizeof(data));
+    }
+
     checkStatus(i2cWriteWordData(_i2cHandle, cmd, value), Status::SendFail);
 
     return Status::Ok;
@@ -111,6 +300,11 @@ Status I2CGpioHardwareBus::Receive(byte& value)
 
 Status I2CGpioHardwareBus::Receive(byte cmd, byte& value)
 {
+    if (_mode == I2CGpioHardwareMode::Combined)
+    {
+        return ZipRead(cmd, &value, 1);
+    }
+
     auto result = i2cReadByteData(_i2cHandle, cmd);
     checkStatus(result, Status::ReceiveFail);
 
@@ -121,30 +315,27 @@ Status I2CGpioHardwareBus::Receive(byte cmd, byte& value)
 
 Status I2CGpioHardwareBus::Receive(byte cmd, byte* data, int dataLen)
 {
-    int result;
-
-    if (dataLen <= I2C_BLOCK_SIZE)
+    if (_mode == I2CGpioHardwareMode::Combined)
     {
-        result = i2cReadI2CBlockData(_i2cHandle,
-            cmd,
-            (char*) data,
-            dataLen);
-        checkStatus(result, Status::ReceiveFail);
+        return ZipRead(cmd, data, dataLen);
     }
-    else
+
+    //advance by what the adapter actually returned
+    auto offset = 0;
+    while (offset < dataLen)
     {
-        auto readCount = 0;
+        auto result = i2cReadI2CBlockData(_i2cHandle,
+            byte(cmd + offset),
+            (char*) (data + offset),
+            std::min(I2C_BLOCK_SIZE, dataLen - offset));
+        checkStatus(result, Status::ReceiveFail);
 
-        while (readCount < dataLen)
+        if (result == 0)
         {
-            result = i2cReadI2CBlockData(_i2cHandle,
-                cmd + readCount,
-                (char*) (data + readCount),
-                std::min(I2C_BLOCK_SIZE, dataLen - readCount));
-            checkStatus(result, Status::ReceiveFail);
-
-            readCount += I2C_BLOCK_SIZE;
+            return Status::ReceivedLessThanExpected;
         }
+
+        offset += result;
     }
 
     return Status::Ok;
@@ -152,6 +343,15 @@ Status I2CGpioHardwareBus::Receive(byte cmd, byte* data, int dataLen)
 
 Status I2CGpioHardwareBus::Receive(byte cmd, word& value)
 {
+    if (_mode == I2CGpioHardwareMode::Combined)
+    {
+        byte data[2];
+        checkStatusReturn(ZipRead(cmd, data, sizeof(data)));
+
+        value = word(data[0] | (data[1] << 8));
+        return Status::Ok;
+    }
+
     auto result = i2cReadWordData(_i2cHandle, cmd);
     checkStatus(result, Status::ReceiveFail);
 
@@ -160,3 +360,65 @@ Status I2CGpioHardwareBus::Receive(byte cmd, word& value)
     return Status::Ok;
 }
 
+Status I2CGpioHardwareBus::Submit(I2CTransaction& transaction)
+{
+    if (_mode != I2CGpioHardwareMode::Combined || transaction.Empty())
+    {
+        return I2CBus::Submit(transaction);
+    }
+
+    //a read segment needs a register pointer write plus the read itself
+    static_assert(I2CTransaction::MaxSegments * 2 <= PI_I2C_RDRW_IOCTL_MAX_MSGS, "A transaction must fit one i2cSegments call");
+
+    pi_i2c_msg_t messages[I2CTransaction::MaxSegments * 2];
+    auto messageCount = 0;
+
+    for (auto idx = 0; idx < transaction.Count(); idx++)
+    {
+        auto& segment = transaction[idx];
+
+        if (segment.Type == I2CSegmentType::Write)
+        {
+            auto& message = messages[messageCount++];
+            message.addr = _address;
+            message.flags = PI_I2C_M_WR;
+            message.len = segment.DataLen;
+            message.buf = segment.Data;
+        }
+        else
+        {
+            auto& pointer = messages[messageCount++];
+            pointer.addr = _address;
+            pointer.flags = PI_I2C_M_WR;
+            pointer.len = 1;
+            pointer.buf = &segment.Cmd;
+
+            auto& message = messages[messageCount++];
+            message.addr = _address;
+            message.flags = PI_I2C_M_RD;
+            message.len = segment.DataLen;
+            message.buf = segment.Data;
+        }
+    }
+
+    auto result = i2cSegments(_i2cHandle, messages, messageCount);
+    if (result < 0)
+    {
+        rtcLogError("i2cSegments failed with ({}){}", result, getErrorMessage(result));
+
+        //the adapter reports the combined transfer as a whole
+        for (auto idx = 0; idx < transaction.Count(); idx++)
+        {
+            auto& segment = transaction[idx];
+            segment.Result = segment.Type == I2CSegmentType::Write
+                ? Status::SendFail
+                : Status::ReceiveFail;
+        }
+
+        return transaction.Result();
+    }
+
+    transaction.SetResult(Status::Ok);
+
+    return Status::Ok;
+}
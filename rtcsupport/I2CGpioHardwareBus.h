@@ -3,6 +3,17 @@
 
 #include "I2CBuffer.h"
 #include "I2CGpioBus.h"
+#include <memory>
+
+enum class I2CGpioHardwareMode
+{
+    //one pigpio SMBus helper per call, blocks split into 32 byte chunks
+    Smbus,
+    //Register reads and writes as one i2cZip call each, with a repeated
+    //start between the register write and the read. Transactions go to
+    //i2cSegments as a single I2C_RDWR.
+    Combined
+};
 
 class I2CGpioHardwareBus : public I2CGpioBus
 {
@@ -11,15 +22,40 @@ class I2CGpioHardwareBus : public I2CGpioBus
 	
 	int _i2cHandle;
 	
+    I2CGpioHardwareMode _mode;
+
+    //zip command stream for Combined writes
+    std::unique_ptr<byte[]> _frame;
+    int _frameCapacity;
+
+    //the i2c_bcm2708 combined parameter was switched on by this bus
+    bool _restoreCombined;
+
 public:
-    I2CGpioHardwareBus(int _adapter, int address);
+    static const int DefaultMaxTransfer = 256;
+
+    //maxTransfer bounds Combined mode writes
+    I2CGpioHardwareBus(int adapter, int address, int maxTransfer = DefaultMaxTransfer);
 	
     bool Initialize();
 	void Close();
 	
+    //Combined needs an adapter that takes I2C_RDWR. On the legacy
+    //i2c_bcm2708 driver the module's combined parameter is switched on
+    //while the bus is open, i2c_bcm2835 always uses a repeated start.
+    void SetMode(I2CGpioHardwareMode mode);
+
+    I2CGpioHardwareMode Mode() const
+    {
+        return _mode;
+    }
+
 
     // I2CBus interface
 public:
+    using I2CBus::Send;
+    using I2CBus::Receive;
+
     Status Send(byte value) override;
     Status Send(byte cmd, byte value) override;
     Status Send(byte cmd, byte* data, int dataLen) override;
@@ -28,6 +64,16 @@ public:
     Status Receive(byte cmd, byte& value) override;
     Status Receive(byte cmd, byte* data, int dataLen) override;
     Status Receive(byte cmd, word& value) override;
+
+    Status Submit(I2CTransaction& transaction) override;
+
+private:
+    Status Zip(const byte* frame, int frameLength, byte* data, int dataLen);
+    Status ZipRead(byte cmd, byte* data, int dataLen);
+    Status ZipWrite(byte cmd, const byte* data, int dataLen);
+
+    void SwitchCombined();
+    void RestoreCombined();
 };
 
 #endif //I2CHARDWAREBUS_H
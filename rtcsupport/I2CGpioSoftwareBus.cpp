@@ -1,18 +1,27 @@
 ﻿#include "LogSupport.h"
+#include "RtcLog.h"
 #include "I2CGpioSoftwareBus.h"
 #include <stdio.h>
 #include "gpio/pigpio.h"
 #include "gpio/i2c.h"
 
 I2CGpioSoftwareBus::I2CGpioSoftwareBus(int address, int sdaPin, int sclPin, int baudRate,
-	int receiveBufferSize /*= 1024*/, int sendBufferSize /*= 1024*/) 
+	int maxTransfer /*= DefaultMaxTransfer*/, I2CBufferPool* pool /*= nullptr*/)
 	: _address(address),
 	_sdaPin(sdaPin),
 	_sclPin(sclPin),
 	_baudRate(baudRate),
-	_receiveBuffer(receiveBufferSize),
-    _sendBuffer(sendBufferSize)
+    _mode(I2CGpioSoftwareMode::BitBang),
+    _open(false)
 {
+    if (pool == nullptr)
+    {
+        _pool.reset(new I2CBufferPool(2, I2CBuffer::FrameLength(maxTransfer)));
+        pool = _pool.get();
+    }
+
+    _receiveBuffer = pool->Acquire();
+    _sendBuffer = pool->Acquire();
 }
 
 #define check(_v) \
@@ -29,7 +38,7 @@ I2CGpioSoftwareBus::I2CGpioSoftwareBus(int address, int sdaPin, int sclPin, int
     if (_v < 0) \
     { \
         auto e = errno; \
-        LOG(ERROR) << "err: " << e << " - " << strerror(e); \
+        rtcLogError("err: {}", rtc::logging::Errno(e)); \
         return _s; \
     } \
 } \
@@ -45,119 +54,134 @@ I2CGpioSoftwareBus::I2CGpioSoftwareBus(int address, int sdaPin, int sclPin, int
 
 bool I2CGpioSoftwareBus::Initialize()
 {
+    if (!_receiveBuffer || !_sendBuffer)
+    {
+        LOG(ERROR) << "no free frame buffers in the pool";
+        return false;
+    }
+
     if (!InitializeGpioBus())
     {
         return false;
     }
 	
     check(bbI2COpen(_sdaPin, _sclPin, _baudRate));
+    _open = true;
+
+    check(bbI2CSetWave(_sdaPin, _mode == I2CGpioSoftwareMode::Waveform));
 
     return true;
 }
 
 void I2CGpioSoftwareBus::Close()
 {
+    //the counts go with the bus, report them while they are still there
+    bbI2CStretch_t stretch;
+    if (_open && bbI2CGetStretch(_sdaPin, _address, &stretch) == 0 && stretch.stretches > 0)
+    {
+        rtcLogInfo("device {x} stretched {} of {} bits, {} us at most, {} timeouts, half bit now {} us",
+            _address, stretch.stretches, stretch.bits, stretch.maxMicros, stretch.timeouts, stretch.delay);
+    }
+
     bbI2CClose(_sdaPin);
+    _open = false;
+
     ShutdownGpioBus();
 }
 
-void I2CGpioSoftwareBus::Prepare()
+void I2CGpioSoftwareBus::SetMode(I2CGpioSoftwareMode mode)
 {
-    _sendBuffer.Clear();
-    _receiveBuffer.Clear();
+    _mode = mode;
 
-    _sendBuffer.Address(_address);
+    if (_open)
+    {
+        bbI2CSetWave(_sdaPin, mode == I2CGpioSoftwareMode::Waveform);
+    }
 }
 
-
-Status I2CGpioSoftwareBus::Transmit(int readCount /* = 0*/)
+//Checks that a frame of sendLength bytes and a read of readCount bytes
+//fit the buffers. The frames are then built without further checks.
+Status I2CGpioSoftwareBus::Prepare(int sendLength, int readCount)
 {
-    if (_sendBuffer.WriteLength() == 0)
+    _sendBuffer->Reset();
+    _receiveBuffer->Reset();
+
+    if (!_sendBuffer->CanWrite(sendLength) ||
+        !_receiveBuffer->CanWrite(readCount))
     {
-        return Status::SendFail;
+        return Status::WriteOverflow;
     }
 
-    _sendBuffer.End();
-    _receiveBuffer.Clear();
+    return Status::Ok;
+}
 
-    vlogMed << "SENDING: " << _sendBuffer.AsString();
+Status I2CGpioSoftwareBus::Transmit(int readCount /* = 0*/)
+{
+    rtcVlogMed("SENDING: {}", rtc::logging::Bytes(_sendBuffer->Data(), _sendBuffer->WriteLength()));
 
+    //bbI2CZip wants room for one byte more than a read fills (it tests
+    //bytes + outPos < outLen) but only ever writes readCount, which
+    //Prepare has checked against the buffer
     auto result = bbI2CZip(_sdaPin,
-        reinterpret_cast<char*>(_sendBuffer.Data()),
-        _sendBuffer.WriteLength(),
-        reinterpret_cast<char*>(_receiveBuffer.Data()),
-        readCount);
+        reinterpret_cast<char*>(_sendBuffer->Data()),
+        _sendBuffer->WriteLength(),
+        reinterpret_cast<char*>(_receiveBuffer->Data()),
+        readCount > 0 ? readCount + 1 : 0);
     if (result < 0)
     {
-        logError
-            << "bbI2CZip failed with (" << result << ")"
-            << getErrorMessage(result);
+        rtcLogError("bbI2CZip failed with ({}){}", result, getErrorMessage(result));
 
         return Status::SendFail;
     }
 
-    _receiveBuffer.SetWriteLength(result);
+    _receiveBuffer->SetWriteLength(result);
 
-    vlogMed << "RECEIVED: " << _receiveBuffer.AsString();
+    rtcVlogMed("RECEIVED: {}", rtc::logging::Bytes(_receiveBuffer->Data(), _receiveBuffer->WriteLength()));
 
     return Status::Ok;
 }
 
 Status I2CGpioSoftwareBus::Send(byte value)
 {
-    Prepare();
+    checkStatusReturn(Prepare(I2CBuffer::WriteFrameLength(1), 0));
 
-    _sendBuffer.Start();
-    _sendBuffer.Send(1);
-    _sendBuffer.Write(value);
-    _sendBuffer.StopAndEnd();
+    _sendBuffer->WriteFrame(_address, &value, 1);
 
     return Transmit();
 }
 
 Status I2CGpioSoftwareBus::Send(byte cmd, byte value)
 {
-    Prepare();
+    checkStatusReturn(Prepare(I2CBuffer::RegisterWriteFrameLength(1), 0));
 
-    _sendBuffer.Start();
-    _sendBuffer.Send(2);
-    _sendBuffer.Write(cmd);
-    _sendBuffer.Write(value);
-    _sendBuffer.StopAndEnd();
+    _sendBuffer->RegisterWriteFrame(_address, cmd, &value, 1);
 
     return Transmit();
 }
 
 Status I2CGpioSoftwareBus::Send(byte cmd, byte* data, int dataLen)
 {
-    Prepare();
+    checkStatusReturn(Prepare(I2CBuffer::RegisterWriteFrameLength(dataLen), 0));
 
-    _sendBuffer.Start();
-    _sendBuffer.Send(dataLen + 1);
-    _sendBuffer.Write(cmd);
-    _sendBuffer.Write(data, dataLen);
-    _sendBuffer.StopAndEnd();
+    _sendBuffer->RegisterWriteFrame(_address, cmd, data, dataLen);
 
     return Transmit();
 }
 
 Status I2CGpioSoftwareBus::Send(byte cmd, word value)
 {
-    Prepare();
+    checkStatusReturn(Prepare(I2CBuffer::RegisterWriteFrameLength(2), 0));
 
-    _sendBuffer.Start();
-    _sendBuffer.Send(3);
-    _sendBuffer.Write(cmd);
-    _sendBuffer.Write(byte(value >> 4));
-    _sendBuffer.Write(byte(value & 0x0F));
-    _sendBuffer.StopAndEnd();
+    //SMBus word order, low byte first
+    byte data[] = { byte(value & 0xFF), byte(value >> 8) };
+    _sendBuffer->RegisterWriteFrame(_address, cmd, data, sizeof(data));
 
     return Transmit();
 }
 
 #define checkReceiveLen(_l) \
 do { \
-    if (_receiveBuffer.ReadLength() < _l) \
+    if (!_receiveBuffer->CanRead(_l)) \
     { \
         return Status::ReceivedLessThanExpected; \
     } \
@@ -165,73 +189,59 @@ do { \
 
 Status I2CGpioSoftwareBus::Receive(byte& value)
 {
-    Prepare();
+    checkStatusReturn(Prepare(I2CBuffer::ReadFrameLength(1), 1));
 
-    _sendBuffer.Start();
-    _sendBuffer.Receive(1);
-    _sendBuffer.StopAndEnd();
+    _sendBuffer->ReadFrame(_address, 1);
 
-    Transmit(1);
+    checkStatusReturn(Transmit(1));
     checkReceiveLen(1);
 
-    value = _receiveBuffer.Read8();
+    value = _receiveBuffer->Take8();
 
     return Status::Ok;
 }
 
 Status I2CGpioSoftwareBus::Receive(byte cmd, byte& value)
 {
-    Prepare();
+    checkStatusReturn(Prepare(I2CBuffer::RegisterReadFrameLength(1), 1));
 
-    _sendBuffer.Start();
-    _sendBuffer.Send(1);
-    _sendBuffer.Write(cmd);
-    _sendBuffer.Restart();
-    _sendBuffer.Receive(1);
-    _sendBuffer.StopAndEnd();
+    _sendBuffer->RegisterReadFrame(_address, cmd, 1);
 
-    Transmit(1);
+    checkStatusReturn(Transmit(1));
     checkReceiveLen(1);
 
-    value = _receiveBuffer.Read8();
+    value = _receiveBuffer->Take8();
 
     return Status::Ok;
 }
 
 Status I2CGpioSoftwareBus::Receive(byte cmd, byte* data, int dataLen)
 {
-    Prepare();
+    checkStatusReturn(Prepare(I2CBuffer::RegisterReadFrameLength(dataLen), dataLen));
 
-    _sendBuffer.Start();
-    _sendBuffer.Send(1);
-    _sendBuffer.Write(cmd);
-    _sendBuffer.Restart();
-    _sendBuffer.Receive(dataLen);
-    _sendBuffer.StopAndEnd();
+    _sendBuffer->RegisterReadFrame(_address, cmd, dataLen);
 
-    Transmit(dataLen);
+    checkStatusReturn(Transmit(dataLen));
     checkReceiveLen(dataLen);
 
-    _receiveBuffer.Read(data, dataLen);
+    _receiveBuffer->Take(data, dataLen);
 
     return Status::Ok;
 }
 
 Status I2CGpioSoftwareBus::Receive(byte cmd, word& value)
 {
-    Prepare();
+    checkStatusReturn(Prepare(I2CBuffer::RegisterReadFrameLength(2), 2));
 
-    _sendBuffer.Start();
-    _sendBuffer.Send(1);
-    _sendBuffer.Write(cmd);
-    _sendBuffer.Restart();
-    _sendBuffer.Receive(2);
-    _sendBuffer.StopAndEnd();
+    _sendBuffer->RegisterReadFrame(_address, cmd, 2);
 
-    Transmit(2);
+    checkStatusReturn(Transmit(2));
     checkReceiveLen(2);
 
-    value = word(_receiveBuffer.Read8() << 4 | _receiveBuffer.Read8());
+    //SMBus word order, low byte first
+    auto low = _receiveBuffer->Take8();
+    auto high = _receiveBuffer->Take8();
+    value = word(low | high << 8);
 
     return Status::Ok;
 }
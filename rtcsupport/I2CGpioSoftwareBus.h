@@ -1,28 +1,63 @@
 ﻿#ifndef I2CSOFTWAREBUS_H
 #define I2CSOFTWAREBUS_H
 
-#include "I2CBuffer.h"
+#include "I2CBufferPool.h"
 #include "I2CGpioBus.h"
 
+enum class I2CGpioSoftwareMode
+{
+    //pigpio toggles the lines from the CPU, with clock stretching
+    BitBang,
+    //Transfers are compiled into DMA waves, so the timing does not depend
+    //on the CPU. No clock stretching, and at most 333kHz.
+    Waveform
+};
+
 class I2CGpioSoftwareBus : public I2CGpioBus
 {
 	int _address;
 	int _sdaPin;
 	int _sclPin;
 	int _baudRate;
+
+    I2CGpioSoftwareMode _mode;
+    bool _open;
 	
-	I2CBuffer _receiveBuffer;
-	I2CBuffer _sendBuffer;
+	//owned when no pool is passed in
+	std::unique_ptr<I2CBufferPool> _pool;
+
+	I2CBufferPool::Handle _receiveBuffer;
+	I2CBufferPool::Handle _sendBuffer;
 
 public:
+    static const int DefaultMaxTransfer = 256;
+
+    //The send and receive buffers are taken from pool, which must
+    //outlive the bus and have blocks of at least
+    //I2CBuffer::FrameLength(maxTransfer). Without a pool the bus makes
+    //its own.
     I2CGpioSoftwareBus(int address, int sdaPin, int sclPin, int baudRate,
-		int receiveBufferSize = 1024, int sendBufferSize = 1024);
+		int maxTransfer = DefaultMaxTransfer, I2CBufferPool* pool = nullptr);
 	
 	bool Initialize();
+
+	//logs the device's clock stretching, see bbI2CGetStretch
 	void Close();
 
+    //Waveform uses pigpio's wave functions, nothing else may use them
+    //while the bus is open
+    void SetMode(I2CGpioSoftwareMode mode);
+
+    I2CGpioSoftwareMode Mode() const
+    {
+        return _mode;
+    }
+
     // I2CBus interface
 public:
+    using I2CBus::Send;
+    using I2CBus::Receive;
+
     Status Send(byte value) override;
     Status Send(byte cmd, byte value) override;
     Status Send(byte cmd, byte* data, int dataLen) override;
@@ -34,7 +69,7 @@ public:
 
 private:
     Status Transmit(int readCount = 0);
-    void Prepare();
+    Status Prepare(int sendLength, int readCount);
 };
 
 #endif //I2CSOFTWAREBUS_H
@@ -0,0 +1,333 @@
+#include "I2CInstrumentedBus.h"
+#include "I2CTransaction.h"
+#include <stdio.h>
+#include <chrono>
+
+//exported histogram boundaries, 2^10ns (about 1us) to 2^34ns (about 17s)
+static const int FirstExportedExponent = 10;
+static const int LastExportedExponent = 34;
+
+static int64_t MonotonicNs()
+{
+    auto now = std::chrono::steady_clock::now().time_since_epoch();
+
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(now).count();
+}
+
+I2CInstrumentedBus::I2CInstrumentedBus(I2CBus* bus, const std::string& name)
+    : _bus(bus),
+      _name(name),
+      _retryLimit(0)
+{
+    Reset();
+}
+
+void I2CInstrumentedBus::Reset()
+{
+    for (auto& counters : _operations)
+    {
+        counters.Calls.store(0, std::memory_order_relaxed);
+        counters.Errors.store(0, std::memory_order_relaxed);
+        counters.Retries.store(0, std::memory_order_relaxed);
+        counters.Bytes.store(0, std::memory_order_relaxed);
+        counters.TotalNs.store(0, std::memory_order_relaxed);
+        counters.MaxNs.store(0, std::memory_order_relaxed);
+
+        for (auto& count : counters.Histogram)
+        {
+            count.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    for (auto& count : _results)
+    {
+        count.store(0, std::memory_order_relaxed);
+    }
+}
+
+void I2CInstrumentedBus::GetSnapshot(Snapshot& snapshot) const
+{
+    for (auto idx = 0; idx < int(Operation::OperationCount); idx++)
+    {
+        const auto& counters = _operations[idx];
+        auto& operation = snapshot.Operations[idx];
+
+        operation.Calls = counters.Calls.load(std::memory_order_relaxed);
+        operation.Errors = counters.Errors.load(std::memory_order_relaxed);
+        operation.Retries = counters.Retries.load(std::memory_order_relaxed);
+        operation.Bytes = counters.Bytes.load(std::memory_order_relaxed);
+        operation.TotalNs = counters.TotalNs.load(std::memory_order_relaxed);
+        operation.MaxNs = counters.MaxNs.load(std::memory_order_relaxed);
+
+        for (auto bucket = 0; bucket < HistogramBuckets; bucket++)
+        {
+            operation.Histogram[bucket] = counters.Histogram[bucket].load(std::memory_order_relaxed);
+        }
+    }
+
+    for (auto idx = 0; idx < StatusCount; idx++)
+    {
+        snapshot.Results[idx] = _results[idx].load(std::memory_order_relaxed);
+    }
+}
+
+template <typename Call>
+Status I2CInstrumentedBus::Measure(Operation operation, int bytes, Call call)
+{
+    auto start = MonotonicNs();
+
+    auto result = call();
+
+    auto retries = 0;
+    while (result != Status::Ok && retries < _retryLimit)
+    {
+        retries++;
+        result = call();
+    }
+
+    auto elapsedNs = MonotonicNs() - start;
+
+    auto& counters = _operations[int(operation)];
+
+    counters.Calls.fetch_add(1, std::memory_order_relaxed);
+    counters.TotalNs.fetch_add(elapsedNs, std::memory_order_relaxed);
+    counters.Histogram[I2CLatencyHistogram::Bucket(elapsedNs)].fetch_add(1, std::memory_order_relaxed);
+
+    auto maxNs = counters.MaxNs.load(std::memory_order_relaxed);
+    while (elapsedNs > maxNs &&
+           !counters.MaxNs.compare_exchange_weak(maxNs, elapsedNs, std::memory_order_relaxed))
+    {
+    }
+
+    if (result == Status::Ok)
+    {
+        counters.Bytes.fetch_add(bytes, std::memory_order_relaxed);
+    }
+    else
+    {
+        counters.Errors.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    if (retries > 0)
+    {
+        counters.Retries.fetch_add(retries, std::memory_order_relaxed);
+    }
+
+    if (int(result) < StatusCount)
+    {
+        _results[int(result)].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    return result;
+}
+
+Status I2CInstrumentedBus::Send(byte value)
+{
+    return Measure(Operation::SendByte, 1, [&]() { return _bus->Send(value); });
+}
+
+Status I2CInstrumentedBus::Send(byte cmd, byte value)
+{
+    return Measure(Operation::SendByteData, 1, [&]() { return _bus->Send(cmd, value); });
+}
+
+Status I2CInstrumentedBus::Send(byte cmd, byte* data, int dataLen)
+{
+    return Measure(Operation::SendBlock, dataLen, [&]() { return _bus->Send(cmd, data, dataLen); });
+}
+
+Status I2CInstrumentedBus::Send(byte cmd, word value)
+{
+    return Measure(Operation::SendWord, 2, [&]() { return _bus->Send(cmd, value); });
+}
+
+Status I2CInstrumentedBus::Receive(byte& value)
+{
+    return Measure(Operation::ReceiveByte, 1, [&]() { return _bus->Receive(value); });
+}
+
+Status I2CInstrumentedBus::Receive(byte cmd, byte& value)
+{
+    return Measure(Operation::ReceiveByteData, 1, [&]() { return _bus->Receive(cmd, value); });
+}
+
+Status I2CInstrumentedBus::Receive(byte cmd, byte* data, int dataLen)
+{
+    return Measure(Operation::ReceiveBlock, dataLen, [&]() { return _bus->Receive(cmd, data, dataLen); });
+}
+
+Status I2CInstrumentedBus::Receive(byte cmd, word& value)
+{
+    return Measure(Operation::ReceiveWord, 2, [&]() { return _bus->Receive(cmd, value); });
+}
+
+Status I2CInstrumentedBus::Send(byte cmd, const I2CSpan* spans, int spanCount)
+{
+    return Measure(Operation::SendSpans, I2CSpanCursor::TotalLength(spans, spanCount),
+        [&]() { return _bus->Send(cmd, spans, spanCount); });
+}
+
+Status I2CInstrumentedBus::Receive(byte cmd, const I2CSpan* spans, int spanCount)
+{
+    return Measure(Operation::ReceiveSpans, I2CSpanCursor::TotalLength(spans, spanCount),
+        [&]() { return _bus->Receive(cmd, spans, spanCount); });
+}
+
+Status I2CInstrumentedBus::Submit(I2CTransaction& transaction)
+{
+    auto bytes = 0;
+    for (auto idx = 0; idx < transaction.Count(); idx++)
+    {
+        bytes += I2CTransaction::PayloadLength(transaction[idx]);
+    }
+
+    return Measure(Operation::Submit, bytes, [&]() { return _bus->Submit(transaction); });
+}
+
+const char* I2CInstrumentedBus::OperationName(Operation operation)
+{
+    switch (operation)
+    {
+    case Operation::SendByte:
+        return "send_byte";
+    case Operation::SendByteData:
+        return "send_byte_data";
+    case Operation::SendBlock:
+        return "send_block";
+    case Operation::SendWord:
+        return "send_word";
+    case Operation::ReceiveByte:
+        return "receive_byte";
+    case Operation::ReceiveByteData:
+        return "receive_byte_data";
+    case Operation::ReceiveBlock:
+        return "receive_block";
+    case Operation::ReceiveWord:
+        return "receive_word";
+    case Operation::SendSpans:
+        return "send_spans";
+    case Operation::ReceiveSpans:
+        return "receive_spans";
+    case Operation::Submit:
+        return "submit";
+    default:
+        return "unknown";
+    }
+}
+
+const char* I2CInstrumentedBus::StatusName(Status status)
+{
+    switch (status)
+    {
+    case Status::Ok:
+        return "ok";
+    case Status::Fail:
+        return "fail";
+    case Status::SendFail:
+        return "send_fail";
+    case Status::ReceiveFail:
+        return "receive_fail";
+    case Status::ReceivedLessThanExpected:
+        return "received_less_than_expected";
+    case Status::ReadUnderflow:
+        return "read_underflow";
+    case Status::WriteOverflow:
+        return "write_overflow";
+    case Status::Busy:
+        return "busy";
+    default:
+        return "unknown";
+    }
+}
+
+void I2CInstrumentedBus::WritePrometheus(std::ostream& out) const
+{
+    Snapshot snapshot;
+    GetSnapshot(snapshot);
+
+    char line[256];
+    const char* name = _name.c_str();
+
+    struct Counter
+    {
+        const char* Metric;
+        const char* Help;
+        uint64_t OperationSnapshot::* Field;
+    };
+
+    static const Counter counters[] =
+    {
+        { "i2c_bus_calls_total", "I2CBus calls", &OperationSnapshot::Calls },
+        { "i2c_bus_errors_total", "I2CBus calls that failed after every retry", &OperationSnapshot::Errors },
+        { "i2c_bus_retries_total", "I2CBus calls repeated after a failure", &OperationSnapshot::Retries },
+        { "i2c_bus_bytes_total", "Payload bytes moved by successful I2CBus calls", &OperationSnapshot::Bytes }
+    };
+
+    for (const auto& counter : counters)
+    {
+        out << "# HELP " << counter.Metric << ' ' << counter.Help << '\n';
+        out << "# TYPE " << counter.Metric << " counter\n";
+
+        for (auto idx = 0; idx < int(Operation::OperationCount); idx++)
+        {
+            const auto& operation = snapshot.Operations[idx];
+            if (operation.Calls == 0)
+            {
+                continue;
+            }
+
+            snprintf(line, sizeof(line), "%s{bus=\"%s\",operation=\"%s\"} %llu\n",
+                     counter.Metric, name, OperationName(Operation(idx)),
+                     (unsigned long long)(operation.*counter.Field));
+            out << line;
+        }
+    }
+
+    out << "# HELP i2c_bus_results_total I2CBus call results by status\n";
+    out << "# TYPE i2c_bus_results_total counter\n";
+
+    for (auto idx = 0; idx < StatusCount; idx++)
+    {
+        snprintf(line, sizeof(line), "i2c_bus_results_total{bus=\"%s\",status=\"%s\"} %llu\n",
+                 name, StatusName(Status(idx)), (unsigned long long)snapshot.Results[idx]);
+        out << line;
+    }
+
+    out << "# HELP i2c_bus_latency_seconds I2CBus call latency including retries\n";
+    out << "# TYPE i2c_bus_latency_seconds histogram\n";
+
+    for (auto idx = 0; idx < int(Operation::OperationCount); idx++)
+    {
+        const auto& operation = snapshot.Operations[idx];
+        if (operation.Calls == 0)
+        {
+            continue;
+        }
+
+        auto operationName = OperationName(Operation(idx));
+
+        auto total = I2CLatencyHistogram::Total(operation.Histogram);
+
+        for (auto exponent = FirstExportedExponent; exponent <= LastExportedExponent; exponent++)
+        {
+            auto boundNs = int64_t(1) << exponent;
+
+            snprintf(line, sizeof(line), "i2c_bus_latency_seconds_bucket{bus=\"%s\",operation=\"%s\",le=\"%.9g\"} %llu\n",
+                     name, operationName, boundNs / 1e9,
+                     (unsigned long long)operation.CountAtMost(boundNs - 1));
+            out << line;
+        }
+
+        snprintf(line, sizeof(line), "i2c_bus_latency_seconds_bucket{bus=\"%s\",operation=\"%s\",le=\"+Inf\"} %llu\n",
+                 name, operationName, (unsigned long long)total);
+        out << line;
+
+        snprintf(line, sizeof(line), "i2c_bus_latency_seconds_sum{bus=\"%s\",operation=\"%s\"} %.9g\n",
+                 name, operationName, operation.TotalNs / 1e9);
+        out << line;
+
+        snprintf(line, sizeof(line), "i2c_bus_latency_seconds_count{bus=\"%s\",operation=\"%s\"} %llu\n",
+                 name, operationName, (unsigned long long)total);
+        out << line;
+    }
+}
@@ -0,0 +1,144 @@
+#ifndef I2CINSTRUMENTEDBUS_H
+#define I2CINSTRUMENTEDBUS_H
+
+#include "I2CBus.h"
+#include "I2CLatencyHistogram.h"
+#include <stdint.h>
+#include <atomic>
+#include <ostream>
+#include <string>
+
+//Counts and times every call on a wrapped bus. Latencies go into log
+//linear histograms (see I2CLatencyHistogram) and failures are counted
+//by Status. Recording is a handful of relaxed atomic adds per call, so
+//the bus can stay wrapped in production and be read from another
+//thread at any time.
+//
+//Failed calls can be retried up to a limit; the retries are counted and
+//the time reported covers every attempt.
+class I2CInstrumentedBus : public I2CBus
+{
+public:
+    enum class Operation
+    {
+        SendByte,
+        SendByteData,
+        SendBlock,
+        SendWord,
+        ReceiveByte,
+        ReceiveByteData,
+        ReceiveBlock,
+        ReceiveWord,
+        SendSpans,
+        ReceiveSpans,
+        Submit,
+
+        OperationCount
+    };
+
+    static const int HistogramBuckets = I2CLatencyHistogram::BucketCount;
+
+    //keep in step with IoError.h
+    static const int StatusCount = int(Status::Busy) + 1;
+
+    struct OperationSnapshot
+    {
+        uint64_t Calls;
+        uint64_t Errors;
+        uint64_t Retries;
+        uint64_t Bytes;
+        int64_t TotalNs;
+        int64_t MaxNs;
+        uint64_t Histogram[HistogramBuckets];
+
+        //upper bound of the bucket holding the given fraction of calls,
+        //never more than MaxNs
+        int64_t PercentileNs(double fraction) const
+        {
+            return I2CLatencyHistogram::PercentileNs(Histogram, fraction, MaxNs);
+        }
+
+        //calls that took at most ns, exact on bucket boundaries
+        uint64_t CountAtMost(int64_t ns) const
+        {
+            return I2CLatencyHistogram::CountAtMost(Histogram, ns);
+        }
+    };
+
+    struct Snapshot
+    {
+        OperationSnapshot Operations[int(Operation::OperationCount)];
+
+        //results of every call, Ok included
+        uint64_t Results[StatusCount];
+    };
+
+private:
+    struct alignas(64) OperationCounters
+    {
+        std::atomic<uint64_t> Calls;
+        std::atomic<uint64_t> Errors;
+        std::atomic<uint64_t> Retries;
+        std::atomic<uint64_t> Bytes;
+        std::atomic<int64_t> TotalNs;
+        std::atomic<int64_t> MaxNs;
+        std::atomic<uint64_t> Histogram[HistogramBuckets];
+    };
+
+    I2CBus* _bus;
+    std::string _name;
+    int _retryLimit;
+
+    OperationCounters _operations[int(Operation::OperationCount)];
+    std::atomic<uint64_t> _results[StatusCount];
+
+public:
+    //name labels the exported metrics, e.g. "i2c-1:0x68"
+    I2CInstrumentedBus(I2CBus* bus, const std::string& name);
+
+    I2CInstrumentedBus(const I2CInstrumentedBus&) = delete;
+
+    //retry a failed call up to this many times, 0 by default
+    void SetRetryLimit(int retries)
+    {
+        _retryLimit = retries;
+    }
+
+    const std::string& Name() const
+    {
+        return _name;
+    }
+
+    void GetSnapshot(Snapshot& snapshot) const;
+    void Reset();
+
+    //Prometheus text exposition: call, error, retry, byte and result
+    //counters plus a latency histogram with power of two boundaries
+    void WritePrometheus(std::ostream& out) const;
+
+    static const char* OperationName(Operation operation);
+    static const char* StatusName(Status status);
+
+    // I2CBus interface
+public:
+    Status Send(byte value) override;
+    Status Send(byte cmd, byte value) override;
+    Status Send(byte cmd, byte* data, int dataLen) override;
+    Status Send(byte cmd, word value) override;
+
+    Status Receive(byte& value) override;
+    Status Receive(byte cmd, byte& value) override;
+    Status Receive(byte cmd, byte* data, int dataLen) override;
+    Status Receive(byte cmd, word& value) override;
+
+    Status Send(byte cmd, const I2CSpan* spans, int spanCount) override;
+    Status Receive(byte cmd, const I2CSpan* spans, int spanCount) override;
+
+    Status Submit(I2CTransaction& transaction) override;
+
+private:
+    template <typename Call>
+    Status Measure(Operation operation, int bytes, Call call);
+};
+
+#endif // I2CINSTRUMENTEDBUS_H
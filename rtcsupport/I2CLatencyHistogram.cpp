@@ -0,0 +1,75 @@
+#include "I2CLatencyHistogram.h"
+#include <algorithm>
+
+int I2CLatencyHistogram::Bucket(int64_t ns)
+{
+    if (ns < SubBuckets)
+    {
+        return ns < 0 ? 0 : int(ns);
+    }
+
+    auto exponent = 63 - __builtin_clzll(uint64_t(ns));
+    if (exponent > MaxExponent)
+    {
+        return BucketCount - 1;
+    }
+
+    auto subBucket = int(ns >> (exponent - SubBucketBits)) & (SubBuckets - 1);
+
+    return (exponent - SubBucketBits + 1) * SubBuckets + subBucket;
+}
+
+int64_t I2CLatencyHistogram::BucketUpperNs(int bucket)
+{
+    if (bucket < SubBuckets)
+    {
+        return bucket;
+    }
+
+    auto exponent = bucket / SubBuckets + SubBucketBits - 1;
+    auto subBucket = bucket % SubBuckets;
+
+    return (int64_t(SubBuckets + subBucket + 1) << (exponent - SubBucketBits)) - 1;
+}
+
+uint64_t I2CLatencyHistogram::Total(const uint64_t* counts)
+{
+    uint64_t total = 0;
+    for (auto idx = 0; idx < BucketCount; idx++)
+    {
+        total += counts[idx];
+    }
+
+    return total;
+}
+
+int64_t I2CLatencyHistogram::PercentileNs(const uint64_t* counts, double fraction, int64_t maxNs)
+{
+    //the counts rather than a separate call counter, they can be a call
+    //apart while another thread records
+    auto target = uint64_t(Total(counts) * fraction);
+    uint64_t seen = 0;
+
+    for (auto idx = 0; idx < BucketCount; idx++)
+    {
+        seen += counts[idx];
+        if (seen > target)
+        {
+            return std::min(BucketUpperNs(idx), maxNs);
+        }
+    }
+
+    return maxNs;
+}
+
+uint64_t I2CLatencyHistogram::CountAtMost(const uint64_t* counts, int64_t ns)
+{
+    uint64_t count = 0;
+
+    for (auto idx = 0; idx < BucketCount && BucketUpperNs(idx) <= ns; idx++)
+    {
+        count += counts[idx];
+    }
+
+    return count;
+}
@@ -0,0 +1,32 @@
+#ifndef I2CLATENCYHISTOGRAM_H
+#define I2CLATENCYHISTOGRAM_H
+
+#include <stdint.h>
+
+//Log linear latency buckets shared by the bus and device profilers.
+//Values below 8ns get a bucket each, above that there are 8 buckets per
+//power of two (about 12% wide) up to 2^39ns, and anything longer lands in
+//the last bucket. Callers own the counts, plain or atomic, and pass a
+//plain copy of them to the queries.
+class I2CLatencyHistogram
+{
+public:
+    static const int SubBucketBits = 3;
+    static const int SubBuckets = 1 << SubBucketBits;
+    static const int MaxExponent = 39;
+    static const int BucketCount = (MaxExponent - SubBucketBits + 2) * SubBuckets;
+
+    static int Bucket(int64_t ns);
+    static int64_t BucketUpperNs(int bucket);
+
+    static uint64_t Total(const uint64_t* counts);
+
+    //upper bound of the bucket holding the given fraction of the counts,
+    //never more than maxNs, the slowest value recorded
+    static int64_t PercentileNs(const uint64_t* counts, double fraction, int64_t maxNs);
+
+    //values of at most ns, exact on bucket boundaries
+    static uint64_t CountAtMost(const uint64_t* counts, int64_t ns);
+};
+
+#endif // I2CLATENCYHISTOGRAM_H
@@ -0,0 +1,175 @@
+#include "I2CProfilingDevice.h"
+#include "LocalTypes.h"
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <linux/i2c-dev.h>
+
+static int64_t MonotonicNs()
+{
+    auto now = std::chrono::steady_clock::now().time_since_epoch();
+
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(now).count();
+}
+
+I2CProfilingDevice::I2CProfilingDevice(I2CDevice* device)
+    : _device(device)
+{
+    Reset();
+}
+
+void I2CProfilingDevice::Reset()
+{
+    memset(_stats, 0, sizeof(_stats));
+}
+
+int I2CProfilingDevice::Open(int adapter)
+{
+    return _device->Open(adapter);
+}
+
+void I2CProfilingDevice::Close()
+{
+    _device->Close();
+}
+
+const char* I2CProfilingDevice::OperationName(Operation operation)
+{
+    switch (operation)
+    {
+    case Operation::SendByte:
+        return "Send(value)";
+    case Operation::ReceiveByte:
+        return "Receive(value)";
+    case Operation::SendByteData:
+        return "Send(cmd, byte)";
+    case Operation::ReceiveByteData:
+        return "Receive(cmd, byte)";
+    case Operation::SendWordData:
+        return "Send(cmd, word)";
+    case Operation::ReceiveWordData:
+        return "Receive(cmd, word)";
+    case Operation::SendBlock:
+        return "Send(cmd, data)";
+    case Operation::ReceiveBlock:
+        return "Receive(cmd, data)";
+    case Operation::Transaction:
+        return "Submit / raw block";
+    default:
+        return "control";
+    }
+}
+
+I2CProfilingDevice::Operation I2CProfilingDevice::Classify(unsigned long request, const void* arg, int& bytes)
+{
+    bytes = 0;
+
+    if (request == I2C_RDWR)
+    {
+        auto transfer = static_cast<const i2c_rdwr_ioctl_data*>(arg);
+        for (auto idx = 0u; idx < transfer->nmsgs; idx++)
+        {
+            bytes += transfer->msgs[idx].len;
+        }
+
+        return Operation::Transaction;
+    }
+
+    if (request != I2C_SMBUS)
+    {
+        return Operation::Control;
+    }
+
+    auto transfer = static_cast<const i2c_smbus_ioctl_data*>(arg);
+    auto read = transfer->read_write == I2C_SMBUS_READ;
+
+    switch (transfer->size)
+    {
+    case I2C_SMBUS_BYTE:
+        bytes = 1;
+        return read ? Operation::ReceiveByte : Operation::SendByte;
+    case I2C_SMBUS_BYTE_DATA:
+        bytes = 2;
+        return read ? Operation::ReceiveByteData : Operation::SendByteData;
+    case I2C_SMBUS_WORD_DATA:
+        bytes = 3;
+        return read ? Operation::ReceiveWordData : Operation::SendWordData;
+    case I2C_SMBUS_I2C_BLOCK_BROKEN:
+    case I2C_SMBUS_I2C_BLOCK_DATA:
+        bytes = transfer->data->block[0] + 1;
+        return read ? Operation::ReceiveBlock : Operation::SendBlock;
+    default:
+        return Operation::Control;
+    }
+}
+
+int I2CProfilingDevice::Ioctl(unsigned long request, void* arg)
+{
+    int bytes;
+    auto operation = Classify(request, arg, bytes);
+
+    auto start = MonotonicNs();
+    auto result = _device->Ioctl(request, arg);
+    auto elapsed = MonotonicNs() - start;
+
+    auto& stats = _stats[int(operation)];
+
+    if (stats.Calls == 0 || elapsed < stats.MinNs)
+    {
+        stats.MinNs = elapsed;
+    }
+    if (elapsed > stats.MaxNs)
+    {
+        stats.MaxNs = elapsed;
+    }
+
+    stats.Calls++;
+    stats.TotalNs += elapsed;
+    stats.Histogram[I2CLatencyHistogram::Bucket(elapsed)]++;
+
+    if (result < 0)
+    {
+        stats.Errors++;
+    }
+    else
+    {
+        stats.Bytes += bytes;
+    }
+
+    return result;
+}
+
+void I2CProfilingDevice::Report(std::ostream& out) const
+{
+    char line[160];
+
+    snprintf(line, sizeof(line), "%-20s %9s %7s %9s %9s %9s %9s %9s %10s %10s\n",
+             "operation", "calls", "errors",
+             "min us", "mean us", "p50 us", "p99 us", "max us",
+             "calls/s", "KB/s");
+    out << line;
+
+    for (auto idx = 0; idx < int(Operation::OperationCount); idx++)
+    {
+        const auto& stats = _stats[idx];
+        if (stats.Calls == 0)
+        {
+            continue;
+        }
+
+        auto seconds = stats.TotalNs / 1e9;
+
+        snprintf(line, sizeof(line), "%-20s %9llu %7llu %9.2f %9.2f %9.2f %9.2f %9.2f %10.0f %10.1f\n",
+                 OperationName(Operation(idx)),
+                 (unsigned long long)stats.Calls,
+                 (unsigned long long)stats.Errors,
+                 stats.MinNs / 1e3,
+                 stats.TotalNs / 1e3 / stats.Calls,
+                 stats.PercentileNs(0.5) / 1e3,
+                 stats.PercentileNs(0.99) / 1e3,
+                 stats.MaxNs / 1e3,
+                 seconds > 0 ? stats.Calls / seconds : 0.0,
+                 seconds > 0 ? stats.Bytes / seconds / 1024 : 0.0);
+        out << line;
+    }
+}
@@ -0,0 +1,84 @@
+#ifndef I2CPROFILINGDEVICE_H
+#define I2CPROFILINGDEVICE_H
+
+#include "I2CDevice.h"
+#include "I2CLatencyHistogram.h"
+#include <stdint.h>
+#include <ostream>
+
+//Wraps an I2CDevice and times every ioctl. Calls are classified by the
+//transfer they carry, which maps onto the I2CSmbus methods, so the
+//report shows the syscall cost of each method. I2C_RDWR carries both
+//Submit and raw block transfers. Run it against
+//i2c-stub or I2CSimulatedDevice to see the overhead without bus time,
+//against a real adapter to see both.
+class I2CProfilingDevice : public I2CDevice
+{
+public:
+    enum class Operation
+    {
+        SendByte,
+        ReceiveByte,
+        SendByteData,
+        ReceiveByteData,
+        SendWordData,
+        ReceiveWordData,
+        SendBlock,
+        ReceiveBlock,
+        Transaction,
+        Control,
+
+        OperationCount
+    };
+
+    static const int HistogramBuckets = I2CLatencyHistogram::BucketCount;
+
+    struct OperationStats
+    {
+        uint64_t Calls;
+        uint64_t Errors;
+        uint64_t Bytes;
+        int64_t TotalNs;
+        int64_t MinNs;
+        int64_t MaxNs;
+        uint64_t Histogram[HistogramBuckets];
+
+        //upper bound of the bucket holding the given fraction of calls,
+        //never more than MaxNs
+        int64_t PercentileNs(double fraction) const
+        {
+            return I2CLatencyHistogram::PercentileNs(Histogram, fraction, MaxNs);
+        }
+    };
+
+private:
+    I2CDevice* _device;
+
+    OperationStats _stats[int(Operation::OperationCount)];
+
+public:
+    I2CProfilingDevice(I2CDevice* device);
+
+    int Open(int adapter) override;
+    void Close() override;
+
+    int Ioctl(unsigned long request, void* arg) override;
+
+    const OperationStats& Stats(Operation operation) const
+    {
+        return _stats[int(operation)];
+    }
+
+    void Reset();
+
+    //one line per operation that was used: calls, errors, latency
+    //min/mean/p50/p99/max and the throughput the ioctl time allows
+    void Report(std::ostream& out) const;
+
+    static const char* OperationName(Operation operation);
+
+private:
+    static Operation Classify(unsigned long request, const void* arg, int& bytes);
+};
+
+#endif // I2CPROFILINGDEVICE_H
@@ -0,0 +1,73 @@
+#ifndef I2CRING_H
+#define I2CRING_H
+
+#include <stddef.h>
+#include <atomic>
+#include <utility>
+
+//Bounded lock-free queue for exactly one producer and one consumer
+//thread. Capacity must be a power of two. Entries are moved in and out,
+//the slots are default constructed once up front.
+template <typename T, size_t Capacity>
+class I2CRing
+{
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+    static const size_t Mask = Capacity - 1;
+
+    //producer and consumer indices on their own cache lines
+    alignas(64) std::atomic<size_t> _head;
+    alignas(64) std::atomic<size_t> _tail;
+    alignas(64) T _slots[Capacity];
+
+public:
+    I2CRing() :
+        _head(0),
+        _tail(0)
+    {
+    }
+
+    I2CRing(const I2CRing&) = delete;
+
+    //producer side, false when full
+    bool Push(T&& value)
+    {
+        auto tail = _tail.load(std::memory_order_relaxed);
+        if (tail - _head.load(std::memory_order_acquire) == Capacity)
+        {
+            return false;
+        }
+
+        _slots[tail & Mask] = std::move(value);
+        _tail.store(tail + 1, std::memory_order_release);
+
+        return true;
+    }
+
+    //consumer side, false when empty
+    bool Pop(T& value)
+    {
+        auto head = _head.load(std::memory_order_relaxed);
+        if (head == _tail.load(std::memory_order_acquire))
+        {
+            return false;
+        }
+
+        value = std::move(_slots[head & Mask]);
+        _head.store(head + 1, std::memory_order_release);
+
+        return true;
+    }
+
+    bool Empty() const
+    {
+        return _head.load(std::memory_order_acquire) == _tail.load(std::memory_order_acquire);
+    }
+
+    size_t Size() const
+    {
+        return _tail.load(std::memory_order_acquire) - _head.load(std::memory_order_acquire);
+    }
+};
+
+#endif // I2CRING_H
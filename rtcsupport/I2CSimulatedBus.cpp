@@ -0,0 +1,283 @@
+#include "I2CSimulatedBus.h"
+#include "I2CTransaction.h"
+#include <chrono>
+#include <thread>
+
+//waits at least this long sleep instead of spinning
+static const int64_t SleepThresholdNs = 50000;
+
+I2CSimulatedBus::I2CSimulatedBus(DS3231Simulator* device, const I2CSimulatedBusOptions& options /*= I2CSimulatedBusOptions()*/)
+    : _device(device),
+      _options(options),
+      _random(options.Seed),
+      _failureDistribution(0.0, 1.0),
+      _failNext(0),
+      _failNextStatus(Status::Fail)
+{
+    ResetStats();
+}
+
+void I2CSimulatedBus::SetOptions(const I2CSimulatedBusOptions& options)
+{
+    std::lock_guard<std::mutex> lock(_lock);
+
+    _options = options;
+    _random.seed(options.Seed);
+}
+
+void I2CSimulatedBus::FailNext(int count, Status status /*= Status::Fail*/)
+{
+    std::lock_guard<std::mutex> lock(_lock);
+
+    _failNext = count;
+    _failNextStatus = status;
+}
+
+I2CSimulatedBusStats I2CSimulatedBus::Stats()
+{
+    std::lock_guard<std::mutex> lock(_lock);
+
+    return _stats;
+}
+
+void I2CSimulatedBus::ResetStats()
+{
+    std::lock_guard<std::mutex> lock(_lock);
+
+    _stats.Transfers = 0;
+    _stats.Bytes = 0;
+    _stats.Failures = 0;
+}
+
+void I2CSimulatedBus::Wait(int64_t ns)
+{
+    if (ns <= 0)
+    {
+        return;
+    }
+
+    //a manual device only moves when told, so the transfer costs no
+    //wall clock time at all
+    if (_device->Source() == DS3231Simulator::TimeSource::Manual)
+    {
+        _device->Advance(ns);
+        return;
+    }
+
+    auto until = std::chrono::steady_clock::now() + std::chrono::nanoseconds(ns);
+
+    //an interrupt driven adapter sleeps until the transfer completes,
+    //only waits too short to reschedule for are spun
+    if (ns >= SleepThresholdNs)
+    {
+        std::this_thread::sleep_until(until);
+        return;
+    }
+
+    while (std::chrono::steady_clock::now() < until)
+    {
+    }
+}
+
+Status I2CSimulatedBus::BeginTransfer(int segments, int bytes, Status failure)
+{
+    int64_t latencyNs;
+    auto result = Status::Ok;
+
+    {
+        std::lock_guard<std::mutex> lock(_lock);
+
+        _stats.Transfers++;
+
+        if (_failNext > 0)
+        {
+            _failNext--;
+            result = _failNextStatus;
+        }
+        else if ((_options.FailEvery > 0 && _stats.Transfers % _options.FailEvery == 0) ||
+                 (_options.FailureRate > 0 && _failureDistribution(_random) < _options.FailureRate))
+        {
+            result = failure;
+        }
+
+        if (result != Status::Ok)
+        {
+            _stats.Failures++;
+        }
+        else
+        {
+            _stats.Bytes += bytes;
+        }
+
+        latencyNs = _options.TransferLatencyNs +
+            (segments - 1) * _options.SegmentLatencyNs +
+            bytes * _options.ByteLatencyNs;
+    }
+
+    Wait(latencyNs);
+
+    return result;
+}
+
+Status I2CSimulatedBus::Send(byte value)
+{
+    auto result = BeginTransfer(1, 1, Status::SendFail);
+    if (result == Status::Ok)
+    {
+        _device->SetPointer(value);
+    }
+
+    return result;
+}
+
+Status I2CSimulatedBus::Send(byte cmd, byte value)
+{
+    return Send(cmd, &value, 1);
+}
+
+Status I2CSimulatedBus::Send(byte cmd, byte* data, int dataLen)
+{
+    auto result = BeginTransfer(1, dataLen + 1, Status::SendFail);
+    if (result == Status::Ok)
+    {
+        _device->SetPointer(cmd);
+        _device->Write(data, dataLen);
+    }
+
+    return result;
+}
+
+//SMBus word order, low byte first
+Status I2CSimulatedBus::Send(byte cmd, word value)
+{
+    byte data[2] = { byte(value & 0xFF), byte(value >> 8) };
+
+    return Send(cmd, data, 2);
+}
+
+Status I2CSimulatedBus::Receive(byte& value)
+{
+    auto result = BeginTransfer(1, 1, Status::ReceiveFail);
+    if (result == Status::Ok)
+    {
+        _device->Read(&value, 1);
+    }
+
+    return result;
+}
+
+Status I2CSimulatedBus::Receive(byte cmd, byte& value)
+{
+    return Receive(cmd, &value, 1);
+}
+
+Status I2CSimulatedBus::Receive(byte cmd, byte* data, int dataLen)
+{
+    //pointer write, repeated start, read
+    auto result = BeginTransfer(2, dataLen + 1, Status::ReceiveFail);
+    if (result == Status::Ok)
+    {
+        _device->SetPointer(cmd);
+        _device->Read(data, dataLen);
+    }
+
+    return result;
+}
+
+Status I2CSimulatedBus::Receive(byte cmd, word& value)
+{
+    byte data[2];
+
+    auto result = Receive(cmd, data, 2);
+    if (result == Status::Ok)
+    {
+        value = word(data[0] | (data[1] << 8));
+    }
+
+    return result;
+}
+
+//the register pointer auto increments across the spans, so a vectored
+//transfer is one transfer of the combined length
+Status I2CSimulatedBus::Send(byte cmd, const I2CSpan* spans, int spanCount)
+{
+    auto result = BeginTransfer(1, I2CSpanCursor::TotalLength(spans, spanCount) + 1, Status::SendFail);
+    if (result == Status::Ok)
+    {
+        _device->SetPointer(cmd);
+        for (auto idx = 0; idx < spanCount; idx++)
+        {
+            _device->Write(spans[idx].Data, spans[idx].DataLen);
+        }
+    }
+
+    return result;
+}
+
+Status I2CSimulatedBus::Receive(byte cmd, const I2CSpan* spans, int spanCount)
+{
+    auto result = BeginTransfer(2, I2CSpanCursor::TotalLength(spans, spanCount) + 1, Status::ReceiveFail);
+    if (result == Status::Ok)
+    {
+        _device->SetPointer(cmd);
+        for (auto idx = 0; idx < spanCount; idx++)
+        {
+            _device->Read(spans[idx].Data, spans[idx].DataLen);
+        }
+    }
+
+    return result;
+}
+
+Status I2CSimulatedBus::Submit(I2CTransaction& transaction)
+{
+    if (transaction.Empty())
+    {
+        return Status::Ok;
+    }
+
+    //a read segment is a pointer write plus the read
+    auto segments = 0;
+    auto bytes = 0;
+    for (auto idx = 0; idx < transaction.Count(); idx++)
+    {
+        const auto& segment = transaction[idx];
+
+        segments += segment.Type == I2CSegmentType::Read ? 2 : 1;
+        bytes += segment.Type == I2CSegmentType::Read ? segment.DataLen + 1 : segment.DataLen;
+    }
+
+    auto result = BeginTransfer(segments, bytes, Status::Fail);
+    if (result != Status::Ok)
+    {
+        for (auto idx = 0; idx < transaction.Count(); idx++)
+        {
+            auto& segment = transaction[idx];
+            segment.Result = segment.Type == I2CSegmentType::Read
+                ? Status::ReceiveFail
+                : Status::SendFail;
+        }
+
+        return transaction.Result();
+    }
+
+    for (auto idx = 0; idx < transaction.Count(); idx++)
+    {
+        auto& segment = transaction[idx];
+
+        _device->SetPointer(segment.Cmd);
+
+        if (segment.Type == I2CSegmentType::Write)
+        {
+            _device->Write(I2CTransaction::Payload(segment), I2CTransaction::PayloadLength(segment));
+        }
+        else
+        {
+            _device->Read(segment.Data, segment.DataLen);
+        }
+
+        segment.Result = Status::Ok;
+    }
+
+    return Status::Ok;
+}
@@ -0,0 +1,121 @@
+#ifndef I2CSIMULATEDBUS_H
+#define I2CSIMULATEDBUS_H
+
+#include "I2CBus.h"
+#include "DS3231Simulator.h"
+#include <stdint.h>
+#include <random>
+#include <mutex>
+
+struct I2CSimulatedBusOptions
+{
+    //fixed cost of every transfer (start, address, stop), of every
+    //repeated start inside a combined transfer and of every byte
+    int64_t TransferLatencyNs;
+    int64_t SegmentLatencyNs;
+    int64_t ByteLatencyNs;
+
+    //fault injection: fail every Nth transfer, and/or each transfer with
+    //the given probability drawn from a generator seeded with Seed
+    int FailEvery;
+    double FailureRate;
+    unsigned Seed;
+
+    I2CSimulatedBusOptions() :
+        TransferLatencyNs(0),
+        SegmentLatencyNs(0),
+        ByteLatencyNs(0),
+        FailEvery(0),
+        FailureRate(0),
+        Seed(1)
+    {
+    }
+
+    //timing of a 100kHz bus, 9 clocks per byte
+    static I2CSimulatedBusOptions Standard()
+    {
+        I2CSimulatedBusOptions options;
+        options.TransferLatencyNs = 110000;
+        options.SegmentLatencyNs = 100000;
+        options.ByteLatencyNs = 90000;
+        return options;
+    }
+
+    //timing of a 400kHz bus
+    static I2CSimulatedBusOptions Fast()
+    {
+        I2CSimulatedBusOptions options;
+        options.TransferLatencyNs = 27500;
+        options.SegmentLatencyNs = 25000;
+        options.ByteLatencyNs = 22500;
+        return options;
+    }
+};
+
+struct I2CSimulatedBusStats
+{
+    uint64_t Transfers;
+    uint64_t Bytes;
+    uint64_t Failures;
+};
+
+//I2CBus backed by a DS3231Simulator. Every call is one transfer, Submit
+//issues the whole transaction as one combined transfer.
+//
+//Latency is charged against the simulator's clock: with a manual time
+//source the device time moves on by the transfer time and nothing
+//waits, with a real time source the call waits for that long, sleeping
+//through whole transfers the way an interrupt driven adapter does.
+class I2CSimulatedBus : public I2CBus
+{
+    DS3231Simulator* _device;
+    I2CSimulatedBusOptions _options;
+
+    std::mutex _lock;
+    std::minstd_rand _random;
+    std::uniform_real_distribution<double> _failureDistribution;
+    int _failNext;
+    Status _failNextStatus;
+
+    I2CSimulatedBusStats _stats;
+
+public:
+    I2CSimulatedBus(DS3231Simulator* device, const I2CSimulatedBusOptions& options = I2CSimulatedBusOptions());
+
+    DS3231Simulator* Device() const
+    {
+        return _device;
+    }
+
+    void SetOptions(const I2CSimulatedBusOptions& options);
+
+    //fail the next count transfers with the given status
+    void FailNext(int count, Status status = Status::Fail);
+
+    I2CSimulatedBusStats Stats();
+    void ResetStats();
+
+    // I2CBus interface
+public:
+    Status Send(byte value) override;
+    Status Send(byte cmd, byte value) override;
+    Status Send(byte cmd, byte* data, int dataLen) override;
+    Status Send(byte cmd, word value) override;
+
+    Status Receive(byte& value) override;
+    Status Receive(byte cmd, byte& value) override;
+    Status Receive(byte cmd, byte* data, int dataLen) override;
+    Status Receive(byte cmd, word& value) override;
+
+    Status Send(byte cmd, const I2CSpan* spans, int spanCount) override;
+    Status Receive(byte cmd, const I2CSpan* spans, int spanCount) override;
+
+    Status Submit(I2CTransaction& transaction) override;
+
+private:
+    //account for one transfer, returns the injected failure if any
+    Status BeginTransfer(int segments, int bytes, Status failure);
+    void Wait(int64_t ns);
+};
+
+#endif // I2CSIMULATEDBUS_H
@@ -0,0 +1,198 @@
+#include "I2CSimulatedDevice.h"
+#include <errno.h>
+#include <linux/i2c-dev.h>
+
+I2CSimulatedDevice::I2CSimulatedDevice(DS3231Simulator* device, int deviceAddress /*= 0x68*/)
+    : _address(-1),
+      _open(false)
+{
+    Attach(device, deviceAddress);
+}
+
+void I2CSimulatedDevice::Attach(DS3231Simulator* device, int deviceAddress)
+{
+    Target target;
+    target.Address = deviceAddress;
+    target.Device = device;
+
+    _targets.push_back(target);
+}
+
+DS3231Simulator* I2CSimulatedDevice::Find(int address) const
+{
+    for (const auto& target : _targets)
+    {
+        if (target.Address == address)
+        {
+            return target.Device;
+        }
+    }
+
+    return nullptr;
+}
+
+int I2CSimulatedDevice::Open(int)
+{
+    _open = true;
+    return 0;
+}
+
+void I2CSimulatedDevice::Close()
+{
+    _open = false;
+}
+
+int I2CSimulatedDevice::Ioctl(unsigned long request, void* arg)
+{
+    if (!_open)
+    {
+        errno = EBADF;
+        return -1;
+    }
+
+    switch (request)
+    {
+    case I2C_SLAVE:
+    case I2C_SLAVE_FORCE:
+        _address = int(reinterpret_cast<long>(arg));
+        return 0;
+
+    case I2C_FUNCS:
+        *static_cast<unsigned long*>(arg) =
+            I2C_FUNC_I2C |
+            I2C_FUNC_SMBUS_BYTE |
+            I2C_FUNC_SMBUS_BYTE_DATA |
+            I2C_FUNC_SMBUS_WORD_DATA |
+            I2C_FUNC_SMBUS_I2C_BLOCK;
+        return 0;
+
+    case I2C_SMBUS:
+        return Smbus(arg);
+
+    case I2C_RDWR:
+        return ReadWrite(arg);
+
+    default:
+        errno = ENOTTY;
+        return -1;
+    }
+}
+
+int I2CSimulatedDevice::Smbus(void* arg)
+{
+    auto request = static_cast<i2c_smbus_ioctl_data*>(arg);
+
+    auto device = Find(_address);
+    if (device == nullptr)
+    {
+        errno = ENXIO;
+        return -1;
+    }
+
+    auto read = request->read_write == I2C_SMBUS_READ;
+    auto data = request->data;
+
+    switch (request->size)
+    {
+    case I2C_SMBUS_BYTE:
+        if (read)
+        {
+            device->Read(&data->byte, 1);
+        }
+        else
+        {
+            //the command byte is the register pointer
+            device->SetPointer(request->command);
+        }
+        return 0;
+
+    case I2C_SMBUS_BYTE_DATA:
+        device->SetPointer(request->command);
+        if (read)
+        {
+            device->Read(&data->byte, 1);
+        }
+        else
+        {
+            device->Write(&data->byte, 1);
+        }
+        return 0;
+
+    case I2C_SMBUS_WORD_DATA:
+    {
+        byte bytes[2] = { byte(data->word & 0xFF), byte(data->word >> 8) };
+
+        device->SetPointer(request->command);
+        if (read)
+        {
+            device->Read(bytes, 2);
+            data->word = bytes[0] | (bytes[1] << 8);
+        }
+        else
+        {
+            device->Write(bytes, 2);
+        }
+        return 0;
+    }
+
+    case I2C_SMBUS_I2C_BLOCK_BROKEN:
+    case I2C_SMBUS_I2C_BLOCK_DATA:
+    {
+        auto length = request->size == I2C_SMBUS_I2C_BLOCK_BROKEN && read
+            ? I2C_SMBUS_BLOCK_MAX
+            : int(data->block[0]);
+        if (length < 1 || length > I2C_SMBUS_BLOCK_MAX)
+        {
+            errno = EINVAL;
+            return -1;
+        }
+
+        device->SetPointer(request->command);
+        if (read)
+        {
+            device->Read(data->block + 1, length);
+            data->block[0] = byte(length);
+        }
+        else
+        {
+            device->Write(data->block + 1, length);
+        }
+        return 0;
+    }
+
+    default:
+        errno = EOPNOTSUPP;
+        return -1;
+    }
+}
+
+int I2CSimulatedDevice::ReadWrite(void* arg)
+{
+    auto request = static_cast<i2c_rdwr_ioctl_data*>(arg);
+
+    for (auto idx = 0u; idx < request->nmsgs; idx++)
+    {
+        const auto& message = request->msgs[idx];
+
+        auto device = Find(message.addr);
+        if (device == nullptr)
+        {
+            errno = ENXIO;
+            return -1;
+        }
+
+        if (message.flags & I2C_M_RD)
+        {
+            device->Read(message.buf, message.len);
+        }
+        else if (message.len > 0)
+        {
+            //the first byte written sets the register pointer
+            device->SetPointer(message.buf[0]);
+            device->Write(message.buf + 1, message.len - 1);
+        }
+    }
+
+    //the kernel returns the number of messages transferred
+    return int(request->nmsgs);
+}
@@ -0,0 +1,48 @@
+#ifndef I2CSIMULATEDDEVICE_H
+#define I2CSIMULATEDDEVICE_H
+
+#include "I2CDevice.h"
+#include "DS3231Simulator.h"
+#include <vector>
+
+//User space stand-in for /dev/i2c-N with a DS3231Simulator answering at
+//one address. It implements the i2c-dev ioctls I2CSmbus uses (I2C_SLAVE,
+//I2C_FUNCS, I2C_SMBUS and I2C_RDWR), so the SMBus path runs unchanged
+//without a kernel driver. Other addresses do not acknowledge.
+//
+//Like an open of /dev/i2c-N it has its own slave address, so devices
+//sharing an adapter are modelled by one instance per bus, each with
+//every simulator on the adapter attached.
+class I2CSimulatedDevice : public I2CDevice
+{
+    struct Target
+    {
+        int Address;
+        DS3231Simulator* Device;
+    };
+
+    std::vector<Target> _targets;
+
+    int _address;
+    bool _open;
+
+public:
+    I2CSimulatedDevice(DS3231Simulator* device, int deviceAddress = 0x68);
+
+    //another device answering on the same adapter
+    void Attach(DS3231Simulator* device, int deviceAddress);
+
+    int Open(int adapter) override;
+    void Close() override;
+
+    int Ioctl(unsigned long request, void* arg) override;
+
+private:
+    //nullptr when nothing answers at the address
+    DS3231Simulator* Find(int address) const;
+
+    int Smbus(void* arg);
+    int ReadWrite(void* arg);
+};
+
+#endif // I2CSIMULATEDDEVICE_H
@@ -1,18 +1,111 @@
 ﻿#include "LogSupport.h"
+#include "RtcLog.h"
 #include "I2CSmbus.h"
+#include "I2CTransaction.h"
 #include <stdio.h>
-#include <sys/stat.h>
-#include <fcntl.h>
 #include <unistd.h>
 #include <sys/ioctl.h>
 #include <linux/i2c-dev.h>
 #include <algorithm>
+#include <vector>
+#include <string.h>
 
-I2CSmbus::I2CSmbus(int adapter, int address)
+//i2c-dev refuses longer I2C_RDWR messages
+static const int MaxRawMessage = 8192;
+
+I2CSmbus::I2CSmbus(int adapter, int address, I2CDevice* device /*= nullptr*/)
 	: _adapter(adapter),
 	_address(address),
-	_i2cHandle(-1)
+	_device(device != nullptr ? device : &_file),
+	_functions(0),
+	_mode(I2CSmbusMode::Auto)
+{
+}
+
+//SMBus transfers built the way the i2c-tools helpers build them, but
+//issued through the device so they can be redirected or measured
+
+static int SmbusAccess(I2CDevice* device, char readWrite, byte command, int size, i2c_smbus_data* data)
+{
+	i2c_smbus_ioctl_data request;
+	request.read_write = readWrite;
+	request.command = command;
+	request.size = size;
+	request.data = data;
+
+	return device->Ioctl(I2C_SMBUS, &request);
+}
+
+static int SmbusWriteByte(I2CDevice* device, byte value)
+{
+	return SmbusAccess(device, I2C_SMBUS_WRITE, value, I2C_SMBUS_BYTE, nullptr);
+}
+
+static int SmbusReadByte(I2CDevice* device)
+{
+	i2c_smbus_data data;
+	auto result = SmbusAccess(device, I2C_SMBUS_READ, 0, I2C_SMBUS_BYTE, &data);
+
+	return result < 0 ? result : data.byte;
+}
+
+static int SmbusWriteByteData(I2CDevice* device, byte cmd, byte value)
+{
+	i2c_smbus_data data;
+	data.byte = value;
+
+	return SmbusAccess(device, I2C_SMBUS_WRITE, cmd, I2C_SMBUS_BYTE_DATA, &data);
+}
+
+static int SmbusReadByteData(I2CDevice* device, byte cmd)
+{
+	i2c_smbus_data data;
+	auto result = SmbusAccess(device, I2C_SMBUS_READ, cmd, I2C_SMBUS_BYTE_DATA, &data);
+
+	return result < 0 ? result : data.byte;
+}
+
+static int SmbusWriteWordData(I2CDevice* device, byte cmd, word value)
+{
+	i2c_smbus_data data;
+	data.word = value;
+
+	return SmbusAccess(device, I2C_SMBUS_WRITE, cmd, I2C_SMBUS_WORD_DATA, &data);
+}
+
+static int SmbusReadWordData(I2CDevice* device, byte cmd)
+{
+	i2c_smbus_data data;
+	auto result = SmbusAccess(device, I2C_SMBUS_READ, cmd, I2C_SMBUS_WORD_DATA, &data);
+
+	return result < 0 ? result : data.word;
+}
+
+static int SmbusWriteBlockData(I2CDevice* device, byte cmd, int length, const byte* values)
+{
+	i2c_smbus_data data;
+	length = std::min(length, I2C_SMBUS_BLOCK_MAX);
+
+	data.block[0] = byte(length);
+	memcpy(data.block + 1, values, length);
+
+	return SmbusAccess(device, I2C_SMBUS_WRITE, cmd, I2C_SMBUS_I2C_BLOCK_DATA, &data);
+}
+
+static int SmbusReadBlockData(I2CDevice* device, byte cmd, int length, byte* values)
 {
+	i2c_smbus_data data;
+	length = std::min(length, I2C_SMBUS_BLOCK_MAX);
+
+	data.block[0] = byte(length);
+	auto result = SmbusAccess(device, I2C_SMBUS_READ, cmd, I2C_SMBUS_I2C_BLOCK_DATA, &data);
+	if (result < 0)
+	{
+		return result;
+	}
+
+	memcpy(values, data.block + 1, data.block[0]);
+	return data.block[0];
 }
 
 #define check(_v) \
@@ -30,64 +123,138 @@ I2CSmbus::I2CSmbus(int adapter, int address)
 	if (_v < 0) \
 	{ \
 		auto e = errno; \
-		LOG(ERROR) << "err: " << e << " - " << strerror(e); \
+		rtcLogError("err: {}", rtc::logging::Errno(e)); \
 		return _s; \
 	} \
 } \
 
 bool I2CSmbus::Initialize()
 {
-	char filename[20];
-
-	snprintf(filename, 19, "/dev/i2c-%d", _adapter);
-	_i2cHandle = open(filename, O_RDWR | O_NONBLOCK);
-	check(_i2cHandle);
+	auto result = _device->Open(_adapter);
+	check(result);
 	
-    ioctl(_i2cHandle, I2C_SLAVE, _address);
-	check(_i2cHandle);
+    result = _device->Ioctl(I2C_SLAVE, reinterpret_cast<void*>(long(_address)));
+	check(result);
+
+	//SMBus only adapters such as i2c-stub cannot take I2C_RDWR
+	unsigned long functions = 0;
+	if (_device->Ioctl(I2C_FUNCS, &functions) == 0)
+	{
+		_functions = functions;
+	}
 
 	return true;
 }
 
 void I2CSmbus::Close()
 {
-	close(_i2cHandle);
+	_device->Close();
 }
 
 Status I2CSmbus::Send(byte cmd, byte value)
 {
-    auto result = i2c_smbus_write_byte_data(_i2cHandle, cmd, value);
+    auto result = SmbusWriteByteData(_device, cmd, value);
 	checkStatus(result, Status::SendFail);
 	
 	return Status::Ok;
 }
 
+bool I2CSmbus::UseRawTransfer(int dataLen) const
+{
+    if ((_functions & I2C_FUNC_I2C) == 0)
+    {
+        return false;
+    }
+
+    switch (_mode)
+    {
+    case I2CSmbusMode::RawI2C:
+        return true;
+    case I2CSmbusMode::Auto:
+        return dataLen > I2C_SMBUS_BLOCK_MAX;
+    default:
+        return false;
+    }
+}
+
+Status I2CSmbus::RawTransfer(byte cmd, byte* data, int dataLen, bool read)
+{
+    auto failure = read
+        ? Status::ReceiveFail
+        : Status::SendFail;
+
+    //writes are staged so the register pointer leads the payload
+    std::vector<byte> frame;
+
+    auto offset = 0;
+    while (offset < dataLen)
+    {
+        auto length = std::min(dataLen - offset, read ? MaxRawMessage : MaxRawMessage - 1);
+        auto reg = byte(cmd + offset);
+
+        i2c_msg messages[2];
+        auto messageCount = 0;
+
+        if (read)
+        {
+            auto& pointer = messages[messageCount++];
+            pointer.addr = _address;
+            pointer.flags = 0;
+            pointer.len = 1;
+            pointer.buf = &reg;
+
+            auto& message = messages[messageCount++];
+            message.addr = _address;
+            message.flags = I2C_M_RD;
+            message.len = length;
+            message.buf = data + offset;
+        }
+        else
+        {
+            frame.resize(length + 1);
+            frame[0] = reg;
+            memcpy(frame.data() + 1, data + offset, length);
+
+            auto& message = messages[messageCount++];
+            message.addr = _address;
+            message.flags = 0;
+            message.len = length + 1;
+            message.buf = frame.data();
+        }
+
+        i2c_rdwr_ioctl_data request;
+        request.msgs = messages;
+        request.nmsgs = messageCount;
+
+        auto result = _device->Ioctl(I2C_RDWR, &request);
+        checkStatus(result, failure);
+
+        offset += length;
+    }
+
+    return Status::Ok;
+}
+
 Status I2CSmbus::Send(byte cmd, byte* data, int dataLen)
 {
-	int result;
-	
-	if (dataLen <= I2C_SMBUS_BLOCK_MAX)
+	if (UseRawTransfer(dataLen))
 	{
-		result = i2c_smbus_write_i2c_block_data(_i2cHandle,
-            cmd,
-			dataLen,
-			data);
-		checkStatus(result, Status::SendFail);
+		return RawTransfer(cmd, data, dataLen, false);
 	}
-	else
+
+	//each chunk starts at the register after the previous chunk
+	auto offset = 0;
+	while (offset < dataLen)
 	{
-		int suboffset = 0;
-		
-		while (suboffset < dataLen)
-		{
-			result = i2c_smbus_write_i2c_block_data(_i2cHandle,
-                cmd + suboffset,
-				std::min(I2C_SMBUS_BLOCK_MAX, dataLen - suboffset),
-				data + suboffset);
-			checkStatus(result, Status::SendFail);
+		auto chunk = std::min(I2C_SMBUS_BLOCK_MAX, dataLen - offset);
 
-			suboffset += I2C_SMBUS_BLOCK_MAX;
-		}
+		auto result = SmbusWriteBlockData(_device,
+            byte(cmd + offset),
+			chunk,
+			data + offset);
+		checkStatus(result, Status::SendFail);
+
+		offset += chunk;
 	}
 	
 	return Status::Ok;
@@ -95,7 +262,7 @@ Status I2CSmbus::Send(byte cmd, byte* data, int dataLen)
 
 Status I2CSmbus::Receive(byte cmd, byte& value)
 {
-    auto result = i2c_smbus_read_byte_data(_i2cHandle, cmd);
+    auto result = SmbusReadByteData(_device, cmd);
 	checkStatus(result, Status::ReceiveFail);
 	
 	value = byte(result);
@@ -105,38 +272,139 @@ Status I2CSmbus::Receive(byte cmd, byte& value)
 
 Status I2CSmbus::Receive(byte cmd, byte* data, int dataLen)
 {
-	int result;	
+	if (UseRawTransfer(dataLen))
+	{
+		return RawTransfer(cmd, data, dataLen, true);
+	}
 
-	if (dataLen <= I2C_SMBUS_BLOCK_MAX)
+	//advance by what the adapter actually returned
+	auto offset = 0;
+	while (offset < dataLen)
 	{
-		result = i2c_smbus_read_i2c_block_data(_i2cHandle,
-            cmd,
-			dataLen,
-			data);
+		auto result = SmbusReadBlockData(_device,
+            byte(cmd + offset),
+			std::min(I2C_SMBUS_BLOCK_MAX, dataLen - offset),
+			data + offset);
 		checkStatus(result, Status::ReceiveFail);
+
+		if (result == 0)
+		{
+			return Status::ReceivedLessThanExpected;
+		}
+
+		offset += result;
 	}
-	else
+	
+	return Status::Ok;
+}
+
+//Raw mode reads every span as its own message after one register pointer
+//write. Each repeated start continues at the device's auto incremented
+//register pointer, so the data lands in the spans without a copy.
+Status I2CSmbus::Receive(byte cmd, const I2CSpan* spans, int spanCount)
+{
+	auto total = I2CSpanCursor::TotalLength(spans, spanCount);
+
+	if (!UseRawTransfer(total) ||
+		spanCount + 1 > I2C_RDWR_IOCTL_MAX_MSGS)
 	{
-		auto readCount = 0;
+		return I2CBus::Receive(cmd, spans, spanCount);
+	}
 
-		while (readCount < dataLen)
-		{		
-			result = i2c_smbus_read_i2c_block_data(_i2cHandle,
-                cmd + readCount,
-				std::min(I2C_SMBUS_BLOCK_MAX, dataLen - readCount),
-				data + readCount);
-			checkStatus(result, Status::ReceiveFail);
+	i2c_msg messages[I2C_RDWR_IOCTL_MAX_MSGS];
+	auto messageCount = 0;
 
-			readCount += I2C_SMBUS_BLOCK_MAX;
+	auto& pointer = messages[messageCount++];
+	pointer.addr = _address;
+	pointer.flags = 0;
+	pointer.len = 1;
+	pointer.buf = &cmd;
+
+	for (auto idx = 0; idx < spanCount; idx++)
+	{
+		if (spans[idx].DataLen <= 0)
+		{
+			continue;
 		}
+
+		if (spans[idx].DataLen > MaxRawMessage)
+		{
+			return I2CBus::Receive(cmd, spans, spanCount);
+		}
+
+		auto& message = messages[messageCount++];
+		message.addr = _address;
+		message.flags = I2C_M_RD;
+		message.len = spans[idx].DataLen;
+		message.buf = spans[idx].Data;
 	}
-	
+
+	i2c_rdwr_ioctl_data request;
+	request.msgs = messages;
+	request.nmsgs = messageCount;
+
+	auto result = _device->Ioctl(I2C_RDWR, &request);
+	checkStatus(result, Status::ReceiveFail);
+
+	return Status::Ok;
+}
+
+//A write has to be one message, so the spans are gathered behind the
+//register pointer unless the adapter can join messages without a start
+Status I2CSmbus::Send(byte cmd, const I2CSpan* spans, int spanCount)
+{
+	auto total = I2CSpanCursor::TotalLength(spans, spanCount);
+
+	if (!UseRawTransfer(total))
+	{
+		return I2CBus::Send(cmd, spans, spanCount);
+	}
+
+	if ((_functions & I2C_FUNC_NOSTART) == 0 ||
+		spanCount + 1 > I2C_RDWR_IOCTL_MAX_MSGS)
+	{
+		std::vector<byte> data(total);
+		I2CSpanCursor(spans, spanCount).CopyOut(data.data(), total);
+
+		return RawTransfer(cmd, data.data(), total, false);
+	}
+
+	i2c_msg messages[I2C_RDWR_IOCTL_MAX_MSGS];
+	auto messageCount = 0;
+
+	auto& pointer = messages[messageCount++];
+	pointer.addr = _address;
+	pointer.flags = 0;
+	pointer.len = 1;
+	pointer.buf = &cmd;
+
+	for (auto idx = 0; idx < spanCount; idx++)
+	{
+		if (spans[idx].DataLen <= 0)
+		{
+			continue;
+		}
+
+		auto& message = messages[messageCount++];
+		message.addr = _address;
+		message.flags = I2C_M_NOSTART;
+		message.len = spans[idx].DataLen;
+		message.buf = spans[idx].Data;
+	}
+
+	i2c_rdwr_ioctl_data request;
+	request.msgs = messages;
+	request.nmsgs = messageCount;
+
+	auto result = _device->Ioctl(I2C_RDWR, &request);
+	checkStatus(result, Status::SendFail);
+
 	return Status::Ok;
 }
 
 Status I2CSmbus::Send(byte value)
 {
-    auto result = i2c_smbus_write_byte(_i2cHandle, value);
+    auto result = SmbusWriteByte(_device, value);
     checkStatus(result, Status::SendFail);
 
     return Status::Ok;
@@ -144,7 +412,7 @@ Status I2CSmbus::Send(byte value)
 
 Status I2CSmbus::Send(byte cmd, word value)
 {
-    auto result = i2c_smbus_write_word_data(_i2cHandle, cmd, value);
+    auto result = SmbusWriteWordData(_device, cmd, value);
     checkStatus(result, Status::SendFail);
 
     return Status::Ok;
@@ -152,7 +420,7 @@ Status I2CSmbus::Send(byte cmd, word value)
 
 Status I2CSmbus::Receive(byte& value)
 {
-    auto result = i2c_smbus_read_byte(_i2cHandle);
+    auto result = SmbusReadByte(_device);
     checkStatus(result, Status::SendFail);
 
     value = byte(result & 0x000000FF);
@@ -162,7 +430,7 @@ Status I2CSmbus::Receive(byte& value)
 
 Status I2CSmbus::Receive(byte cmd, word& value)
 {
-    auto result = i2c_smbus_read_word_data(_i2cHandle, cmd);
+    auto result = SmbusReadWordData(_device, cmd);
 
     checkStatus(result, Status::SendFail);
 
@@ -170,3 +438,121 @@ Status I2CSmbus::Receive(byte cmd, word& value)
 
     return Status::Ok;
 }
+
+bool I2CSmbus::CanCombine() const
+{
+    return (_functions & I2C_FUNC_I2C) != 0;
+}
+
+Status I2CSmbus::ReceiveFrom(const int* addresses, int count, byte cmd, byte* data, int dataLen)
+{
+    if (!CanCombine() || dataLen <= 0 || dataLen > MaxRawMessage)
+    {
+        return Status::ReceiveFail;
+    }
+
+    //a register pointer write plus the read for every device
+    const int DevicesPerTransfer = I2C_RDWR_IOCTL_MAX_MSGS / 2;
+
+    for (auto first = 0; first < count; first += DevicesPerTransfer)
+    {
+        i2c_msg messages[I2C_RDWR_IOCTL_MAX_MSGS];
+        auto messageCount = 0;
+
+        auto last = std::min(count, first + DevicesPerTransfer);
+        for (auto idx = first; idx < last; idx++)
+        {
+            auto& pointer = messages[messageCount++];
+            pointer.addr = addresses[idx];
+            pointer.flags = 0;
+            pointer.len = 1;
+            pointer.buf = &cmd;
+
+            auto& message = messages[messageCount++];
+            message.addr = addresses[idx];
+            message.flags = I2C_M_RD;
+            message.len = dataLen;
+            message.buf = data + idx * dataLen;
+        }
+
+        i2c_rdwr_ioctl_data request;
+        request.msgs = messages;
+        request.nmsgs = messageCount;
+
+        auto result = _device->Ioctl(I2C_RDWR, &request);
+        checkStatus(result, Status::ReceiveFail);
+    }
+
+    return Status::Ok;
+}
+
+Status I2CSmbus::Submit(I2CTransaction& transaction)
+{
+    if (transaction.Empty())
+    {
+        return Status::Ok;
+    }
+
+    if ((_functions & I2C_FUNC_I2C) == 0)
+    {
+        return I2CBus::Submit(transaction);
+    }
+
+    //a read segment needs a register pointer write plus the read itself
+    i2c_msg messages[I2CTransaction::MaxSegments * 2];
+    auto messageCount = 0;
+
+    for (auto idx = 0; idx < transaction.Count(); idx++)
+    {
+        auto& segment = transaction[idx];
+
+        if (segment.Type == I2CSegmentType::Write)
+        {
+            auto& message = messages[messageCount++];
+            message.addr = _address;
+            message.flags = 0;
+            message.len = segment.DataLen;
+            message.buf = segment.Data;
+        }
+        else
+        {
+            auto& pointer = messages[messageCount++];
+            pointer.addr = _address;
+            pointer.flags = 0;
+            pointer.len = 1;
+            pointer.buf = &segment.Cmd;
+
+            auto& message = messages[messageCount++];
+            message.addr = _address;
+            message.flags = I2C_M_RD;
+            message.len = segment.DataLen;
+            message.buf = segment.Data;
+        }
+    }
+
+    i2c_rdwr_ioctl_data request;
+    request.msgs = messages;
+    request.nmsgs = messageCount;
+
+    auto result = _device->Ioctl(I2C_RDWR, &request);
+    if (result < 0)
+    {
+        auto e = errno;
+        rtcLogError("err: {}", rtc::logging::Errno(e));
+
+        //the adapter reports the combined transfer as a whole
+        for (auto idx = 0; idx < transaction.Count(); idx++)
+        {
+            auto& segment = transaction[idx];
+            segment.Result = segment.Type == I2CSegmentType::Write
+                ? Status::SendFail
+                : Status::ReceiveFail;
+        }
+
+        return transaction.Result();
+    }
+
+    transaction.SetResult(Status::Ok);
+
+    return Status::Ok;
+}
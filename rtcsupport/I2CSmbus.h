@@ -3,19 +3,55 @@
 
 #include "I2CBus.h"
 #include "I2CBuffer.h"
+#include "I2CDevice.h"
+
+enum class I2CSmbusMode
+{
+    //SMBus block transfers, split into 32 byte chunks
+    Smbus,
+    //every block as one I2C_RDWR transfer, whatever its length
+    RawI2C,
+    //raw transfers only for blocks SMBus would have to split
+    Auto
+};
 
 class I2CSmbus : public I2CBus
 {
 	int _adapter;
 	int _address;
 	
-	int _i2cHandle;
+	I2CDevFile _file;
+	I2CDevice* _device;
+	unsigned long _functions;
+	I2CSmbusMode _mode;
 
 public:
-    I2CSmbus(int adapter, int address);
+    //device replaces /dev/i2c-<adapter>, e.g. with a stand-in or a
+    //profiling wrapper. It must outlive the bus.
+    I2CSmbus(int adapter, int address, I2CDevice* device = nullptr);
 	
 	bool Initialize();
 	void Close();
+
+    //Raw transfers need an adapter with plain I2C support, SMBus only
+    //adapters keep using block transfers in every mode
+    void SetMode(I2CSmbusMode mode)
+    {
+        _mode = mode;
+    }
+
+    I2CSmbusMode Mode() const
+    {
+        return _mode;
+    }
+
+    //Every I2C_RDWR message carries its own address, so one ioctl can
+    //read the same registers from several devices on this adapter
+    bool CanCombine() const;
+
+    //dataLen bytes from cmd on each address, packed one device after the
+    //other into data. Any failure fails the whole read.
+    Status ReceiveFrom(const int* addresses, int count, byte cmd, byte* data, int dataLen);
 	
     // I2CBus interface
 public:
@@ -28,6 +64,20 @@ public:
     Status Receive(byte cmd, byte* data, int dataLen) override;
     Status Receive(byte& value) override;
     Status Receive(byte cmd, word& value) override;
+
+    Status Send(byte cmd, const I2CSpan* spans, int spanCount) override;
+    Status Receive(byte cmd, const I2CSpan* spans, int spanCount) override;
+
+    //Issues the whole transaction as a single I2C_RDWR ioctl so the
+    //segments are joined by repeated starts with one stop at the end.
+    //Adapters without plain I2C support run the segments one by one.
+    Status Submit(I2CTransaction& transaction) override;
+
+private:
+    bool UseRawTransfer(int dataLen) const;
+
+    //register pointer write and the data as one combined transfer
+    Status RawTransfer(byte cmd, byte* data, int dataLen, bool read);
 };
 
 #endif //I2CSMBUS_H
@@ -0,0 +1,91 @@
+#ifndef I2CSPAN_H
+#define I2CSPAN_H
+
+#include "LocalTypes.h"
+#include <cstring>
+
+//One piece of a vectored transfer. The spans of a transfer map onto
+//consecutive device registers, the first span starting at the command
+//register, so a block can be read straight into separate fields.
+struct I2CSpan
+{
+    byte* Data;
+    int DataLen;
+};
+
+//Walks a span list, copying between the spans and a contiguous buffer
+class I2CSpanCursor
+{
+    const I2CSpan* _spans;
+    int _spanCount;
+    int _span;
+    int _offset;
+
+public:
+    I2CSpanCursor(const I2CSpan* spans, int spanCount) :
+        _spans(spans),
+        _spanCount(spanCount),
+        _span(0),
+        _offset(0)
+    {
+    }
+
+    static int TotalLength(const I2CSpan* spans, int spanCount)
+    {
+        auto total = 0;
+        for (auto idx = 0; idx < spanCount; idx++)
+        {
+            total += spans[idx].DataLen;
+        }
+
+        return total;
+    }
+
+    //scatter: fill the spans from data
+    void CopyIn(const byte* data, int dataLen)
+    {
+        Copy(const_cast<byte*>(data), dataLen, true);
+    }
+
+    //gather: fill data from the spans
+    void CopyOut(byte* data, int dataLen)
+    {
+        Copy(data, dataLen, false);
+    }
+
+private:
+    void Copy(byte* data, int dataLen, bool scatter)
+    {
+        while (dataLen > 0 && _span < _spanCount)
+        {
+            const auto& span = _spans[_span];
+
+            auto count = span.DataLen - _offset;
+            if (count > dataLen)
+            {
+                count = dataLen;
+            }
+
+            if (scatter)
+            {
+                std::memcpy(span.Data + _offset, data, count);
+            }
+            else
+            {
+                std::memcpy(data, span.Data + _offset, count);
+            }
+
+            data += count;
+            dataLen -= count;
+            _offset += count;
+
+            if (_offset == span.DataLen)
+            {
+                _span++;
+                _offset = 0;
+            }
+        }
+    }
+};
+
+#endif // I2CSPAN_H
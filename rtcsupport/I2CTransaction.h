@@ -0,0 +1,171 @@
+#ifndef I2CTRANSACTION_H
+#define I2CTRANSACTION_H
+
+#include "LocalTypes.h"
+#include "IoError.h"
+#include <cstring>
+
+enum class I2CSegmentType
+{
+    //write the register pointer followed by the segment data
+    Write,
+    //write the register pointer, repeated start, then read the segment data
+    Read
+};
+
+struct I2CSegment
+{
+    I2CSegmentType Type;
+
+    byte Cmd;
+
+    //for writes this points at the staged frame (cmd followed by the payload),
+    //for reads it points at the caller's destination buffer
+    byte* Data;
+    int DataLen;
+
+    Status Result;
+};
+
+//Queues a sequence of register reads and writes so a bus can submit
+//them as one combined transfer. Write payloads are copied into the
+//transaction so the caller's buffers only need to live until the
+//segment is queued. Read destinations must stay valid until Submit returns.
+class I2CTransaction
+{
+public:
+    static const int MaxSegments = 16;
+    static const int MaxWriteBytes = 128;
+
+private:
+    I2CSegment _segments[MaxSegments];
+    int _segmentCount;
+
+    byte _writeData[MaxWriteBytes];
+    int _writeLength;
+
+public:
+    I2CTransaction() :
+        _segmentCount(0),
+        _writeLength(0)
+    {
+    }
+
+    I2CTransaction(const I2CTransaction&) = delete;
+
+    void Clear()
+    {
+        _segmentCount = 0;
+        _writeLength = 0;
+    }
+
+    int Count() const
+    {
+        return _segmentCount;
+    }
+
+    bool Empty() const
+    {
+        return _segmentCount == 0;
+    }
+
+    I2CSegment& operator[](int idx)
+    {
+        return _segments[idx];
+    }
+
+    const I2CSegment& operator[](int idx) const
+    {
+        return _segments[idx];
+    }
+
+    bool Write(byte cmd, byte value)
+    {
+        return Write(cmd, &value, 1);
+    }
+
+    bool Write(byte cmd, const byte* data, int dataLen)
+    {
+        //the staged frame holds the command byte plus the payload
+        if (_segmentCount == MaxSegments ||
+            dataLen < 0 ||
+            _writeLength + dataLen + 1 > MaxWriteBytes)
+        {
+            return false;
+        }
+
+        auto frame = _writeData + _writeLength;
+        frame[0] = cmd;
+        if (dataLen > 0)
+        {
+            std::memcpy(static_cast<void*>(frame + 1), static_cast<const void*>(data), dataLen);
+        }
+
+        _writeLength += dataLen + 1;
+
+        auto& segment = _segments[_segmentCount++];
+        segment.Type = I2CSegmentType::Write;
+        segment.Cmd = cmd;
+        segment.Data = frame;
+        segment.DataLen = dataLen + 1;
+        segment.Result = Status::Fail;
+
+        return true;
+    }
+
+    bool Read(byte cmd, byte* data, int dataLen)
+    {
+        if (_segmentCount == MaxSegments || dataLen <= 0)
+        {
+            return false;
+        }
+
+        auto& segment = _segments[_segmentCount++];
+        segment.Type = I2CSegmentType::Read;
+        segment.Cmd = cmd;
+        segment.Data = data;
+        segment.DataLen = dataLen;
+        segment.Result = Status::Fail;
+
+        return true;
+    }
+
+    //payload of a write segment, without the staged command byte
+    static const byte* Payload(const I2CSegment& segment)
+    {
+        return segment.Type == I2CSegmentType::Write
+            ? segment.Data + 1
+            : segment.Data;
+    }
+
+    static int PayloadLength(const I2CSegment& segment)
+    {
+        return segment.Type == I2CSegmentType::Write
+            ? segment.DataLen - 1
+            : segment.DataLen;
+    }
+
+    void SetResult(Status status)
+    {
+        for (auto idx = 0; idx < _segmentCount; idx++)
+        {
+            _segments[idx].Result = status;
+        }
+    }
+
+    //the first failing segment status, or Ok if every segment completed
+    Status Result() const
+    {
+        for (auto idx = 0; idx < _segmentCount; idx++)
+        {
+            if (_segments[idx].Result != Status::Ok)
+            {
+                return _segments[idx].Result;
+            }
+        }
+
+        return Status::Ok;
+    }
+};
+
+#endif // I2CTRANSACTION_H
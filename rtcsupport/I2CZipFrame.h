@@ -0,0 +1,96 @@
+#ifndef I2CZIPFRAME_H
+#define I2CZIPFRAME_H
+
+#include "LocalTypes.h"
+#include <string.h>
+
+//Compile-time building blocks for pigpio zip command streams. A frame
+//shape is a list of constant parts and slots; the parts are joined into
+//one byte array at compile time and the slots are left zero for the
+//address, register, lengths and so on to be patched in after a single
+//memcpy.
+namespace rtc
+{
+    namespace zip
+    {
+        template <byte... Bytes>
+        struct Frame
+        {
+            static constexpr int Length = sizeof...(Bytes);
+            static constexpr byte Data[sizeof...(Bytes)] = { Bytes... };
+        };
+
+        template <byte... Bytes>
+        constexpr int Frame<Bytes...>::Length;
+
+        template <byte... Bytes>
+        constexpr byte Frame<Bytes...>::Data[sizeof...(Bytes)];
+
+        //a patched byte, and a patched little endian 16 bit length
+        typedef Frame<0> Slot8;
+        typedef Frame<0, 0> Slot16;
+
+        template <typename... Parts>
+        struct Join;
+
+        template <typename Part>
+        struct Join<Part>
+        {
+            typedef Part Type;
+        };
+
+        template <byte... First, byte... Second, typename... Rest>
+        struct Join<Frame<First...>, Frame<Second...>, Rest...>
+        {
+            typedef typename Join<Frame<First..., Second...>, Rest...>::Type Type;
+        };
+
+        //where part Index starts in the joined frame
+        template <int Index, typename... Parts>
+        struct OffsetOf;
+
+        template <typename First, typename... Rest>
+        struct OffsetOf<0, First, Rest...>
+        {
+            static const int Value = 0;
+        };
+
+        template <int Index, typename First, typename... Rest>
+        struct OffsetOf<Index, First, Rest...>
+        {
+            static const int Value = First::Length + OffsetOf<Index - 1, Rest...>::Value;
+        };
+
+        template <typename... Parts>
+        struct Shape
+        {
+            typedef typename Join<Parts...>::Type Template;
+
+            static constexpr int Length = Template::Length;
+
+            template <int Index>
+            static constexpr int Offset()
+            {
+                return OffsetOf<Index, Parts...>::Value;
+            }
+
+            //copies the template to dest, which must hold Length bytes
+            static byte* Emit(byte* dest)
+            {
+                memcpy(dest, Template::Data, Length);
+                return dest;
+            }
+        };
+
+        template <typename... Parts>
+        constexpr int Shape<Parts...>::Length;
+
+        inline void Patch16(byte* slot, int value)
+        {
+            slot[0] = byte(value & 0xFF);
+            slot[1] = byte((value >> 8) & 0xFF);
+        }
+    } //namespace zip
+} //namespace rtc
+
+#endif // I2CZIPFRAME_H
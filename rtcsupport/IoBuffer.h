@@ -16,10 +16,12 @@ class IoBuffer
 	byte* _writePtr;
 	
 	int _capacity;
+	bool _owned;
 
 public:
 	IoBuffer(int capacity) :
-		_capacity(capacity)
+		_capacity(capacity),
+		_owned(true)
 	{
 		_buffer = new byte[capacity];
 		_bufferEnd = _buffer + capacity;
@@ -27,9 +29,64 @@ public:
 		_writePtr = _buffer;
 	}
 	
+	//a view over storage owned by someone else, e.g. an I2CBufferPool
+	IoBuffer(byte* data, int capacity) :
+		_buffer(data),
+		_bufferEnd(data + capacity),
+		_readPtr(data),
+		_writePtr(data),
+		_capacity(capacity),
+		_owned(false)
+	{
+	}
+	
+	IoBuffer(const IoBuffer&) = delete;
+	IoBuffer& operator=(const IoBuffer&) = delete;
+	
+	IoBuffer(IoBuffer&& other) :
+		_buffer(other._buffer),
+		_bufferEnd(other._bufferEnd),
+		_readPtr(other._readPtr),
+		_writePtr(other._writePtr),
+		_capacity(other._capacity),
+		_owned(other._owned)
+	{
+		other.Detach();
+	}
+	
+	IoBuffer& operator=(IoBuffer&& other)
+	{
+		if (this != &other)
+		{
+			if (_owned)
+			{
+				delete[] _buffer;
+			}
+			
+			_buffer = other._buffer;
+			_bufferEnd = other._bufferEnd;
+			_readPtr = other._readPtr;
+			_writePtr = other._writePtr;
+			_capacity = other._capacity;
+			_owned = other._owned;
+			
+			other.Detach();
+		}
+		
+		return *this;
+	}
+	
 	~IoBuffer()
 	{
-		delete _buffer;
+		if (_owned)
+		{
+			delete[] _buffer;
+		}
+	}
+	
+	int Capacity() const
+	{
+		return _capacity;
 	}
 	
 	byte* Data() const
@@ -43,6 +100,8 @@ public:
 		_writePtr = _buffer;
 	}
 	
+	//Reset and zero the whole capacity. Reset is enough to reuse the
+	//buffer, the contents past the write position are never read.
 	void Clear()
 	{
 		Reset();
@@ -84,56 +143,141 @@ public:
 		return _writePtr >= _bufferEnd;
 	}
 	
-	byte Read8()
+	bool CanRead(int length) const
 	{
-		if (!Eor())
-		{
-			auto value = *_readPtr;
-			_readPtr += 1;
-			return value;
-		}
-
-		throw IoError(Status::ReadUnderflow);
+		return length <= ReadRemaining();
 	}
 	
-	void Read(byte* dest, int destLength)
+	bool CanWrite(int length) const
+	{
+		return length <= WriteRemaining();
+	}
+	
+	//Unchecked access. Check the whole frame once with CanRead or
+	//CanWrite, then move the bytes without a test per byte.
+	byte Take8()
+	{
+		auto value = *_readPtr;
+		_readPtr += 1;
+		return value;
+	}
+	
+	void Take(byte* dest, int destLength)
 	{
-		auto bytesRead = ReadLength();
-		if (bytesRead < destLength)
+		std::memcpy(static_cast<void*>(dest), static_cast<void*>(_readPtr), destLength);
+		_readPtr += destLength;
+	}
+	
+	void Put(byte value)
+	{
+		*_writePtr = value;
+		_writePtr += 1;
+	}
+	
+	void Put(const byte* data, int dataLength)
+	{
+		std::memcpy(static_cast<void*>(_writePtr), static_cast<const void*>(data), dataLength);
+		_writePtr += dataLength;
+	}
+	
+	//Checked access that reports ReadUnderflow or WriteOverflow instead
+	//of throwing. Nothing is moved when the check fails.
+	Status TryRead8(byte& value)
+	{
+		if (Eor())
 		{
-			throw IoError(Status::ReadUnderflow);
+			return Status::ReadUnderflow;
 		}
 		
-		if (bytesRead > 0)
+		value = Take8();
+		return Status::Ok;
+	}
+	
+	Status TryRead(byte* dest, int destLength)
+	{
+		if (!CanRead(destLength))
 		{
-			std::memcpy(static_cast<void*>(dest), static_cast<void*>(_readPtr), bytesRead);
+			return Status::ReadUnderflow;
 		}
+		
+		Take(dest, destLength);
+		return Status::Ok;
 	}
 	
-	void Write(byte value)
+	Status TryWrite(byte value)
 	{
 		if (Eow())
 		{
-			throw IoError(Status::WriteOverflow);
+			return Status::WriteOverflow;
 		}
 		
-		*_writePtr = value;
-		_writePtr += 1;
+		Put(value);
+		return Status::Ok;
 	}
 	
-	void Write(byte* data, int dataLength)
+	Status TryWrite(const byte* data, int dataLength)
 	{
-		if (dataLength > WriteLength())
+		if (!CanWrite(dataLength))
 		{
-			throw IoError(Status::WriteOverflow);
+			return Status::WriteOverflow;
 		}
 		
-		std::memcpy(static_cast<void*>(_writePtr), static_cast<void*>(data), dataLength);
+		Put(data, dataLength);
+		return Status::Ok;
+	}
+	
+	//throw IoError on underflow or overflow
+	byte Read8()
+	{
+		byte value;
+		auto result = TryRead8(value);
+		if (result != Status::Ok)
+		{
+			throw IoError(result);
+		}
 		
-		_writePtr += dataLength;
+		return value;
+	}
+	
+	void Read(byte* dest, int destLength)
+	{
+		auto result = TryRead(dest, destLength);
+		if (result != Status::Ok)
+		{
+			throw IoError(result);
+		}
+	}
+	
+	void Write(byte value)
+	{
+		auto result = TryWrite(value);
+		if (result != Status::Ok)
+		{
+			throw IoError(result);
+		}
+	}
+	
+	void Write(const byte* data, int dataLength)
+	{
+		auto result = TryWrite(data, dataLength);
+		if (result != Status::Ok)
+		{
+			throw IoError(result);
+		}
 	}
 	
 	std::string AsString() const;
+	
+private:
+	void Detach()
+	{
+		_buffer = nullptr;
+		_bufferEnd = nullptr;
+		_readPtr = nullptr;
+		_writePtr = nullptr;
+		_capacity = 0;
+		_owned = false;
+	}
 };
 
 #endif //IOBUFFER_H
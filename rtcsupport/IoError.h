@@ -11,7 +11,9 @@ enum class Status
     ReceiveFail,
     ReceivedLessThanExpected,
     ReadUnderflow,
-    WriteOverflow
+    WriteOverflow,
+    //the request could not be queued
+    Busy
 };
 
 class IoError : std::exception
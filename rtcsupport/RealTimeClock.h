@@ -15,10 +15,23 @@ namespace rtc
 		Running,
 		TimeInvalid
 	};
+
+	//Rate of the square wave output. Disabled turns the pin into the
+	//alarm interrupt output instead.
+	enum class SquareWaveRate
+	{
+		Disabled,
+		Rate1Hz,
+		Rate1024Hz,
+		Rate4096Hz,
+		Rate8192Hz
+	};
 	
 	class RealTimeClock
 	{
     public:
+        virtual ~RealTimeClock() {}
+
         virtual bool Initialize() = 0;
         virtual void Shutdown() = 0;
 		
@@ -40,6 +53,10 @@ namespace rtc
         virtual AlarmInterruptStatus GetAlarmInterruptStatus() const = 0;
 		
         virtual AlarmTriggerState GetAlarmTriggerState() const = 0;
+
+		// Square wave output
+
+        virtual void SetSquareWave(SquareWaveRate rate) = 0;
 	};
 } //namespace rtc
 
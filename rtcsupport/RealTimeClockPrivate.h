@@ -4,6 +4,8 @@
 #include "LocalTypes.h"
 #include "I2CBus.h"
 #include "RtcAlarm.h"
+#include "BcdCodec.h"
+#include <stdint.h>
 
 // ReSharper disable CppPossiblyUninitializedMember
 
@@ -13,15 +15,12 @@ namespace rtc
 	{	
 		static inline byte FromBcd(byte val)
 		{
-            // Convert decimal to binary coded decimal
-            byte result = (val & 0x0F) + (val >> 4) * 10;
-			return result;
+			return bcd::FromBcd(val);
 		}
 
 		static inline byte ToBcd(byte val)
 		{
-            // Convert binary coded decimal to decimal
-			return ((val / 10) << 4) + val % 10;
+			return bcd::ToBcd(val);
 		}
 	
 		static inline Months ToMonth(byte value)
@@ -172,6 +171,105 @@ namespace rtc
                 return 7;
             }
 		}		
+
+		// Days since 1970-01-01 for a proleptic Gregorian date.
+		// See http://howardhinnant.github.io/date_algorithms.html
+		static inline int64_t DaysFromCivil(int year, int month, int day)
+		{
+			year -= month <= 2;
+			int64_t era = (year >= 0 ? year : year - 399) / 400;
+			int yoe = int(year - era * 400);
+			int doy = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+			int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+			return era * 146097 + doe - 719468;
+		}
+
+		static inline void CivilFromDays(int64_t days, int& year, int& month, int& day)
+		{
+			days += 719468;
+			int64_t era = (days >= 0 ? days : days - 146096) / 146097;
+			int doe = int(days - era * 146097);
+			int yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+			int doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+			int mp = (5 * doy + 2) / 153;
+			day = doy - (153 * mp + 2) / 5 + 1;
+			month = mp < 10 ? mp + 3 : mp - 9;
+			year = int(yoe + era * 400) + (month <= 2);
+		}
+
+		// 24 hour value of a wall or military clock hour
+		static inline int ToMilitaryHour(const RtcTime& time)
+		{
+			if (time.Mode != ClockMode::WallClock)
+			{
+				return time.Hour;
+			}
+
+			auto hour = time.Hour % 12;
+			return time.Period == Meridiem::Pm
+				? hour + 12
+				: hour;
+		}
+
+		// Set a 0-23 hour in the requested clock mode
+		static inline void SetHour(RtcTime& time, int hour, ClockMode mode)
+		{
+			time.Mode = mode;
+			if (mode == ClockMode::WallClock)
+			{
+				time.Period = hour >= 12 ? Meridiem::Pm : Meridiem::Am;
+				time.Hour = hour % 12 == 0 ? 12 : hour % 12;
+			}
+			else
+			{
+				time.Period = Meridiem::None;
+				time.Hour = hour;
+			}
+		}
+
+		// Seconds since the epoch for a date/time read from the clock.
+		// The weekday is not used.
+		static inline int64_t ToEpochSeconds(const RtcDateTime& value)
+		{
+			auto days = DaysFromCivil(value.Year, FromMonth(value.Month), value.Day);
+
+			return days * 86400 +
+				ToMilitaryHour(value.Time) * 3600 +
+				value.Time.Minute * 60 +
+				value.Time.Second;
+		}
+
+		// Inverse of ToEpochSeconds. The weekday is derived from the date,
+		// the hour is expressed in the requested clock mode.
+		static inline void FromEpochSeconds(int64_t seconds, ClockMode mode, RtcDateTime& value)
+		{
+			auto days = seconds / 86400;
+			auto secondOfDay = int(seconds - days * 86400);
+			if (secondOfDay < 0)
+			{
+				days -= 1;
+				secondOfDay += 86400;
+			}
+
+			int year, month, day;
+			CivilFromDays(days, year, month, day);
+
+			value.Year = year;
+			value.Month = ToMonth(byte(month));
+			value.Day = day;
+
+			// 1970-01-01 was a Thursday
+			auto weekDay = int((days + 4) % 7);
+			if (weekDay < 0)
+			{
+				weekDay += 7;
+			}
+			value.WeekDay = rtc::DayOfWeek(weekDay + int(rtc::DayOfWeek::Sun));
+
+			SetHour(value.Time, secondOfDay / 3600, mode);
+			value.Time.Minute = (secondOfDay / 60) % 60;
+			value.Time.Second = secondOfDay % 60;
+		}
 	} //pvt
 } //namespace rtc
 
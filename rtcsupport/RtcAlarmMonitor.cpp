@@ -0,0 +1,113 @@
+#include "RtcAlarmMonitor.h"
+#include <chrono>
+
+using namespace rtc;
+
+RtcAlarmMonitor::RtcAlarmMonitor(RealTimeClock* clock, RtcEdgeSource* source)
+    : _clock(clock),
+      _source(source),
+      _pending(false),
+      _started(false)
+{
+}
+
+RtcAlarmMonitor::~RtcAlarmMonitor()
+{
+    Stop();
+}
+
+void RtcAlarmMonitor::AddHandler(const AlarmHandler& handler)
+{
+    _handlers.push_back(handler);
+}
+
+bool RtcAlarmMonitor::Start()
+{
+    if (_started)
+    {
+        return true;
+    }
+
+    _clock->SetSquareWave(SquareWaveRate::Disabled);
+
+    if (!_source->Start([this](int64_t) { OnEdge(); }))
+    {
+        return false;
+    }
+
+    //INT stays low while a flag is set, so an alarm that fired before we
+    //started produces no edge. Check the status once up front.
+    {
+        std::lock_guard<std::mutex> lock(_lock);
+        _pending = true;
+    }
+
+    _started = true;
+
+    return true;
+}
+
+void RtcAlarmMonitor::Stop()
+{
+    if (!_started)
+    {
+        return;
+    }
+
+    _source->Stop();
+    _started = false;
+}
+
+void RtcAlarmMonitor::OnEdge()
+{
+    {
+        std::lock_guard<std::mutex> lock(_lock);
+        _pending = true;
+    }
+
+    _signal.notify_one();
+}
+
+int RtcAlarmMonitor::Dispatch(int timeoutMs /*= 0*/)
+{
+    {
+        std::unique_lock<std::mutex> lock(_lock);
+
+        if (!_pending && timeoutMs > 0)
+        {
+            _signal.wait_for(lock, std::chrono::milliseconds(timeoutMs), [this] { return _pending; });
+        }
+
+        if (!_pending)
+        {
+            return 0;
+        }
+
+        _pending = false;
+    }
+
+    //reads Status and clears whichever flags were set
+    auto state = _clock->GetAlarmTriggerState();
+
+    auto delivered = 0;
+
+    if (state.FirstTriggered)
+    {
+        for (auto& handler : _handlers)
+        {
+            handler(AlarmId::First);
+        }
+        delivered++;
+    }
+
+    if (state.SecondTriggered)
+    {
+        for (auto& handler : _handlers)
+        {
+            handler(AlarmId::Second);
+        }
+        delivered++;
+    }
+
+    return delivered;
+}
@@ -0,0 +1,62 @@
+#ifndef RTCALARMMONITOR_H
+#define RTCALARMMONITOR_H
+
+#include "RealTimeClock.h"
+#include "RtcEdgeSource.h"
+#include <functional>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+
+namespace rtc
+{
+    //Delivers alarms from the INT/SQW pin instead of polling the status
+    //register. The pin is put into interrupt mode, and the status register
+    //is only read after the pin has gone low. Alarms still need their
+    //interrupt enabled through SetAlarmInterruptState.
+    //
+    //The edge source thread only flags the event. Status is read, the
+    //alarm flags cleared and the handlers run on the thread calling
+    //Dispatch, so the bus is never used from the edge thread.
+    //
+    //INT and the square wave share a pin, so this cannot be combined with
+    //an edge source on the 1Hz output.
+    class RtcAlarmMonitor
+    {
+    public:
+        typedef std::function<void(AlarmId id)> AlarmHandler;
+
+    private:
+        RealTimeClock* _clock;
+        RtcEdgeSource* _source;
+
+        std::vector<AlarmHandler> _handlers;
+
+        std::mutex _lock;
+        std::condition_variable _signal;
+        bool _pending;
+        bool _started;
+
+    public:
+        RtcAlarmMonitor(RealTimeClock* clock, RtcEdgeSource* source);
+        ~RtcAlarmMonitor();
+
+        RtcAlarmMonitor(const RtcAlarmMonitor&) = delete;
+
+        void AddHandler(const AlarmHandler& handler);
+
+        bool Start();
+        void Stop();
+
+        //Wait up to timeoutMs for the pin to signal, then read and clear
+        //the alarm flags and call the handlers. A timeout of zero only
+        //handles an event that is already pending.
+        //Returns the number of alarms delivered.
+        int Dispatch(int timeoutMs = 0);
+
+    private:
+        void OnEdge();
+    };
+} //namespace rtc
+
+#endif // RTCALARMMONITOR_H
@@ -1,11 +1,11 @@
 #include "RtcDebugger.h"
 #include "RealTimeClockPrivate.h"
+#include "BcdCodec.h"
 #include <iostream>
 #include <iomanip>
 #include <stdlib.h>
 #include <stdio.h>
 
-using namespace std;
 using namespace rtc;
 
 static const char* RegisterName(DS3231RegisterId id);
@@ -22,12 +22,7 @@ static bool TestBit(byte data, byte mask)
 
 static byte FromBcd(byte data, byte msbMask, byte lsbMask)
 {
-    auto msb = Mask(data, msbMask);
-    auto lsb = Mask(data, lsbMask);
-
-    auto result = lsb + (msb >> 4) * 10;
-
-    return result;
+    return bcd::FromBcd(Mask(data, msbMask | lsbMask));
 }
 
 void PrintByte(byte b)
@@ -0,0 +1,53 @@
+#ifndef RTCEDGESOURCE_H
+#define RTCEDGESOURCE_H
+
+#include <stdint.h>
+#include <functional>
+
+namespace rtc
+{
+    //Reports edges on an RTC output pin (SQW or INT), time stamped in
+    //CLOCK_MONOTONIC nanoseconds. The handler may be called from
+    //another thread.
+    class RtcEdgeSource
+    {
+    public:
+        typedef std::function<void(int64_t monotonicNs)> EdgeHandler;
+
+        virtual ~RtcEdgeSource()
+        {
+        }
+
+        virtual bool Start(const EdgeHandler& handler) = 0;
+        virtual void Stop() = 0;
+    };
+
+    //Edge source driven by hand, for exercising edge consumers without
+    //a device attached
+    class SimulatedEdgeSource : public RtcEdgeSource
+    {
+        EdgeHandler _handler;
+
+    public:
+        bool Start(const EdgeHandler& handler) override
+        {
+            _handler = handler;
+            return true;
+        }
+
+        void Stop() override
+        {
+            _handler = nullptr;
+        }
+
+        void Fire(int64_t monotonicNs)
+        {
+            if (_handler)
+            {
+                _handler(monotonicNs);
+            }
+        }
+    };
+} //namespace rtc
+
+#endif // RTCEDGESOURCE_H
@@ -0,0 +1,145 @@
+#include "RtcEventLoop.h"
+
+#if defined(RTC_COROUTINES)
+
+#include <algorithm>
+
+using namespace rtc;
+
+void RtcTransfer::await_suspend(std::coroutine_handle<> waiter)
+{
+    _loop->Submit(this, waiter);
+}
+
+RtcEventLoop::RtcEventLoop()
+    : _signalled(false),
+      _sleeping(false)
+{
+}
+
+RtcEventLoop::~RtcEventLoop()
+{
+    //tasks still waiting on a transfer cannot be destroyed safely, Run
+    //first. Finished ones are released here.
+    Sweep();
+}
+
+void RtcEventLoop::Attach(I2CAsyncBus& adapter)
+{
+    adapter.SetCompletionNotify([this]() { Signal(); });
+
+    _adapters.push_back(&adapter);
+}
+
+void RtcEventLoop::Submit(RtcTransfer* transfer, std::coroutine_handle<> waiter)
+{
+    //keep submission order once anything is waiting for room
+    if (!_blocked.empty() || !TrySubmit(transfer, waiter))
+    {
+        _blocked.push_back(Blocked{ transfer, waiter });
+    }
+}
+
+bool RtcEventLoop::TrySubmit(RtcTransfer* transfer, std::coroutine_handle<> waiter)
+{
+    return transfer->_adapter->SubmitAsync(*transfer->_device, *transfer->_transaction,
+        [transfer, waiter](Status result)
+        {
+            transfer->_result = result;
+            waiter.resume();
+        });
+}
+
+int RtcEventLoop::RetryBlocked()
+{
+    auto count = 0;
+
+    while (!_blocked.empty())
+    {
+        auto& blocked = _blocked.front();
+        if (!TrySubmit(blocked.Transfer, blocked.Waiter))
+        {
+            break;
+        }
+
+        _blocked.pop_front();
+        count++;
+    }
+
+    return count;
+}
+
+void RtcEventLoop::Sweep()
+{
+    auto finished = std::remove_if(_tasks.begin(), _tasks.end(), [](std::coroutine_handle<> task)
+    {
+        if (!task.done())
+        {
+            return false;
+        }
+
+        task.destroy();
+        return true;
+    });
+
+    _tasks.erase(finished, _tasks.end());
+}
+
+int RtcEventLoop::RunOnce(bool wait)
+{
+    //cleared before polling so a completion that lands after the poll
+    //keeps Wait from sleeping
+    _signalled.store(false);
+
+    auto count = 0;
+    for (auto adapter : _adapters)
+    {
+        count += adapter->Poll();
+    }
+
+    count += RetryBlocked();
+
+    Sweep();
+
+    if (count == 0 && wait && !_tasks.empty())
+    {
+        Wait();
+    }
+
+    return count;
+}
+
+void RtcEventLoop::Run()
+{
+    while (!_tasks.empty())
+    {
+        RunOnce(true);
+    }
+}
+
+void RtcEventLoop::Signal()
+{
+    _signalled.store(true);
+
+    if (_sleeping.load())
+    {
+        std::lock_guard<std::mutex> lock(_lock);
+        _wake.notify_one();
+    }
+}
+
+void RtcEventLoop::Wait()
+{
+    std::unique_lock<std::mutex> lock(_lock);
+
+    _sleeping.store(true);
+
+    if (!_signalled.load())
+    {
+        _wake.wait(lock);
+    }
+
+    _sleeping.store(false);
+}
+
+#endif // RTC_COROUTINES
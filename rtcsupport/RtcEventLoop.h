@@ -0,0 +1,135 @@
+#ifndef RTCEVENTLOOP_H
+#define RTCEVENTLOOP_H
+
+#include "RtcTask.h"
+
+#if defined(RTC_COROUTINES)
+
+#include "I2CAsyncBus.h"
+#include "I2CTransaction.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+namespace rtc
+{
+    class RtcEventLoop;
+
+    //co_await-able transfer, resumes the coroutine with the result
+    class RtcTransfer
+    {
+        friend class RtcEventLoop;
+
+        RtcEventLoop* _loop;
+        I2CAsyncBus* _adapter;
+        I2CBus* _device;
+        I2CTransaction* _transaction;
+        Status _result;
+
+    public:
+        RtcTransfer(RtcEventLoop* loop, I2CAsyncBus* adapter, I2CBus* device, I2CTransaction* transaction) :
+            _loop(loop),
+            _adapter(adapter),
+            _device(device),
+            _transaction(transaction),
+            _result(Status::Fail)
+        {
+        }
+
+        bool await_ready() const noexcept
+        {
+            return false;
+        }
+
+        void await_suspend(std::coroutine_handle<> waiter);
+
+        Status await_resume() const noexcept
+        {
+            return _result;
+        }
+    };
+
+    //Drives any number of coroutines from one thread. A coroutine awaiting
+    //a transfer is suspended while it is queued on its adapter's I/O
+    //thread and resumed here when it completes, so one thread keeps every
+    //adapter busy without a thread per device.
+    //
+    //Adapters are only used from the loop thread once attached, which is
+    //what keeps their rings single producer.
+    class RtcEventLoop
+    {
+        friend class RtcTransfer;
+
+        //transfers waiting for room in a full submission ring
+        struct Blocked
+        {
+            RtcTransfer* Transfer;
+            std::coroutine_handle<> Waiter;
+        };
+
+        std::vector<I2CAsyncBus*> _adapters;
+        std::vector<std::coroutine_handle<>> _tasks;
+        std::deque<Blocked> _blocked;
+
+        std::mutex _lock;
+        std::condition_variable _wake;
+        std::atomic<bool> _signalled;
+        std::atomic<bool> _sleeping;
+
+    public:
+        RtcEventLoop();
+        ~RtcEventLoop();
+
+        RtcEventLoop(const RtcEventLoop&) = delete;
+
+        //poll the adapter for completions, before the adapter is started
+        void Attach(I2CAsyncBus& adapter);
+
+        //start a top level task, it runs until its first transfer
+        template <typename T>
+        void Spawn(RtcTask<T> task)
+        {
+            auto handle = task.Release();
+            _tasks.push_back(handle);
+            handle.resume();
+        }
+
+        //spawned tasks that have not finished
+        int TaskCount() const
+        {
+            return int(_tasks.size());
+        }
+
+        //run until every spawned task has finished
+        void Run();
+
+        //resume the coroutines whose transfers completed, optionally
+        //sleeping until there is one. Returns how many were resumed.
+        int RunOnce(bool wait);
+
+        RtcTransfer Transfer(I2CAsyncBus& adapter, I2CTransaction& transaction)
+        {
+            return RtcTransfer(this, &adapter, adapter.Bus(), &transaction);
+        }
+
+        //another device sharing the adapter's I/O thread
+        RtcTransfer Transfer(I2CAsyncBus& adapter, I2CBus& device, I2CTransaction& transaction)
+        {
+            return RtcTransfer(this, &adapter, &device, &transaction);
+        }
+
+    private:
+        void Submit(RtcTransfer* transfer, std::coroutine_handle<> waiter);
+        bool TrySubmit(RtcTransfer* transfer, std::coroutine_handle<> waiter);
+        int RetryBlocked();
+        void Sweep();
+        void Signal();
+        void Wait();
+    };
+} //namespace rtc
+
+#endif // RTC_COROUTINES
+
+#endif // RTCEVENTLOOP_H
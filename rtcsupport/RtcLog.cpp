@@ -0,0 +1,463 @@
+#include "RtcLog.h"
+#include "I2CRing.h"
+#include <glog/logging.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+namespace rtc
+{
+    namespace logging
+    {
+        std::atomic<int> pvt::Threshold(int(Severity::Info));
+
+        namespace
+        {
+            //per thread, 64KB of records
+            static const size_t RingCapacity = 512;
+
+            //how long the logging thread sleeps between drains
+            static const std::chrono::milliseconds DrainPeriod(5);
+
+            struct ThreadRing
+            {
+                I2CRing<Record, RingCapacity> Records;
+                std::atomic<uint64_t> Dropped;
+                std::atomic<bool> Closed;
+
+                ThreadRing() :
+                    Dropped(0),
+                    Closed(false)
+                {
+                }
+            };
+
+            void GlogSink(const Site& site, int64_t, const std::string& text)
+            {
+                auto severity = site.Level == Severity::Error
+                    ? google::GLOG_ERROR
+                    : site.Level == Severity::Warning
+                        ? google::GLOG_WARNING
+                        : google::GLOG_INFO;
+
+                google::LogMessage(site.File, site.Line, severity).stream() << text;
+            }
+
+            const Site DroppedSite = { Severity::Warning, __FILE__, __LINE__, "dropped {} log records, the rings were full" };
+
+            class Logger
+            {
+                //ring list, sink and thread state
+                std::mutex _lock;
+                std::vector<std::shared_ptr<ThreadRing>> _rings;
+                Sink _sink;
+                std::thread _thread;
+                std::condition_variable _wake;
+                bool _running;
+                bool _stop;
+                bool _shutdown;
+
+                //one thread drains at a time, the rings have one consumer
+                std::mutex _drainLock;
+                std::vector<Record> _batch;
+
+                std::atomic<uint64_t> _dropped;
+
+            public:
+                Logger() :
+                    _sink(GlogSink),
+                    _running(false),
+                    _stop(false),
+                    _shutdown(false),
+                    _dropped(0)
+                {
+                }
+
+                ~Logger()
+                {
+                    Shutdown();
+                }
+
+                std::shared_ptr<ThreadRing> Register()
+                {
+                    //plain new ignores the ring's cache line alignment before C++17
+                    void* memory = nullptr;
+                    if (posix_memalign(&memory, alignof(ThreadRing), sizeof(ThreadRing)) != 0)
+                    {
+                        throw std::bad_alloc();
+                    }
+
+                    std::shared_ptr<ThreadRing> ring(new (memory) ThreadRing(),
+                        [](ThreadRing* ring)
+                        {
+                            ring->~ThreadRing();
+                            free(ring);
+                        });
+
+                    std::lock_guard<std::mutex> lock(_lock);
+                    _rings.push_back(ring);
+
+                    if (!_running && !_shutdown)
+                    {
+                        _running = true;
+                        _stop = false;
+                        _thread = std::thread(&Logger::Run, this);
+                    }
+
+                    return ring;
+                }
+
+                void SetSink(Sink sink)
+                {
+                    std::lock_guard<std::mutex> drain(_drainLock);
+                    std::lock_guard<std::mutex> lock(_lock);
+
+                    _sink = sink ? sink : Sink(GlogSink);
+                }
+
+                void Shutdown()
+                {
+                    {
+                        std::lock_guard<std::mutex> lock(_lock);
+                        _shutdown = true;
+
+                        if (!_running)
+                        {
+                            return;
+                        }
+
+                        _stop = true;
+                    }
+
+                    _wake.notify_one();
+                    _thread.join();
+
+                    {
+                        std::lock_guard<std::mutex> lock(_lock);
+                        _running = false;
+                    }
+
+                    Drain();
+                }
+
+                uint64_t Dropped() const
+                {
+                    return _dropped.load(std::memory_order_relaxed);
+                }
+
+                void Drain()
+                {
+                    std::lock_guard<std::mutex> drain(_drainLock);
+
+                    std::vector<std::shared_ptr<ThreadRing>> rings;
+                    Sink sink;
+                    {
+                        std::lock_guard<std::mutex> lock(_lock);
+                        rings = _rings;
+                        sink = _sink;
+                    }
+
+                    uint64_t dropped = 0;
+                    auto finished = false;
+
+                    for (auto& ring : rings)
+                    {
+                        //a closed ring gets no more records once it is seen closed
+                        auto closed = ring->Closed.load(std::memory_order_acquire);
+
+                        Record record;
+                        while (ring->Records.Pop(record))
+                        {
+                            _batch.push_back(record);
+                        }
+
+                        dropped += ring->Dropped.exchange(0, std::memory_order_relaxed);
+                        finished = finished || closed;
+                    }
+
+                    if (finished)
+                    {
+                        std::lock_guard<std::mutex> lock(_lock);
+
+                        _rings.erase(std::remove_if(_rings.begin(), _rings.end(),
+                            [](const std::shared_ptr<ThreadRing>& ring)
+                            {
+                                return ring->Closed.load(std::memory_order_acquire) && ring->Records.Empty();
+                            }),
+                            _rings.end());
+                    }
+
+                    //interleave the threads in the order things happened
+                    std::stable_sort(_batch.begin(), _batch.end(),
+                        [](const Record& left, const Record& right)
+                        {
+                            return left.TimestampNs < right.TimestampNs;
+                        });
+
+                    for (auto& record : _batch)
+                    {
+                        sink(*record.Where, record.TimestampNs, Format(record));
+                    }
+
+                    _batch.clear();
+
+                    if (dropped > 0)
+                    {
+                        _dropped.fetch_add(dropped, std::memory_order_relaxed);
+
+                        Record record;
+                        record.Where = &DroppedSite;
+                        record.TimestampNs = 0;
+                        record.ArgCount = 0;
+                        record.BlobUsed = 0;
+                        pvt::Put(record, dropped);
+
+                        sink(DroppedSite, 0, Format(record));
+                    }
+                }
+
+            private:
+                void Run()
+                {
+                    std::unique_lock<std::mutex> lock(_lock);
+
+                    while (!_stop)
+                    {
+                        _wake.wait_for(lock, DrainPeriod);
+
+                        lock.unlock();
+                        Drain();
+                        lock.lock();
+                    }
+                }
+            };
+
+            Logger& Instance()
+            {
+                static Logger logger;
+                return logger;
+            }
+
+            //marks the thread's ring closed when the thread exits, the
+            //logging thread frees it once it is drained
+            struct ThreadHandle
+            {
+                std::shared_ptr<ThreadRing> Ring;
+
+                ~ThreadHandle()
+                {
+                    if (Ring)
+                    {
+                        Ring->Closed.store(true, std::memory_order_release);
+                    }
+                }
+            };
+
+            thread_local ThreadHandle threadHandle;
+
+            void AppendHex(std::string& text, uint64_t value)
+            {
+                char digits[24];
+                snprintf(digits, sizeof(digits), "%llx", (unsigned long long) value);
+                text += digits;
+            }
+
+            void AppendBytes(std::string& text, const byte* data, int length, int fullLength)
+            {
+                static const char* hexChars = "0123456789ABCDEF";
+
+                text += '[';
+                for (auto idx = 0; idx < length; idx++)
+                {
+                    if (idx > 0)
+                    {
+                        text += ' ';
+                    }
+
+                    text += hexChars[data[idx] >> 4];
+                    text += hexChars[data[idx] & 0x0F];
+                }
+
+                if (length < fullLength)
+                {
+                    text += " ..";
+                }
+
+                text += ']';
+            }
+
+            void AppendArg(std::string& text, const Record& record, int arg, bool hex)
+            {
+                auto value = record.Args[arg];
+                char number[32];
+
+                switch (record.Types[arg])
+                {
+                case ArgType::Signed:
+                    if (hex)
+                    {
+                        AppendHex(text, value);
+                    }
+                    else
+                    {
+                        snprintf(number, sizeof(number), "%lld", (long long) int64_t(value));
+                        text += number;
+                    }
+                    break;
+
+                case ArgType::Unsigned:
+                    if (hex)
+                    {
+                        AppendHex(text, value);
+                    }
+                    else
+                    {
+                        snprintf(number, sizeof(number), "%llu", (unsigned long long) value);
+                        text += number;
+                    }
+                    break;
+
+                case ArgType::Double:
+                {
+                    double converted;
+                    memcpy(&converted, &value, sizeof(converted));
+                    snprintf(number, sizeof(number), "%g", converted);
+                    text += number;
+                    break;
+                }
+
+                case ArgType::String:
+                {
+                    auto string = reinterpret_cast<const char*>(uintptr_t(value));
+                    text += string != nullptr ? string : "(null)";
+                    break;
+                }
+
+                case ArgType::Bytes:
+                {
+                    auto offset = int(value >> 32);
+                    auto fullLength = int(uint32_t(value));
+
+                    //later buffers start where the stored part of this one ends
+                    auto end = int(record.BlobUsed);
+                    for (auto next = arg + 1; next < record.ArgCount; next++)
+                    {
+                        if (record.Types[next] == ArgType::Bytes)
+                        {
+                            end = int(record.Args[next] >> 32);
+                            break;
+                        }
+                    }
+
+                    AppendBytes(text, record.Blob + offset, end - offset, fullLength);
+                    break;
+                }
+
+                case ArgType::Errno:
+                {
+                    auto error = int(int64_t(value));
+                    snprintf(number, sizeof(number), "%d", error);
+                    text += number;
+                    text += " - ";
+                    text += std::system_category().message(error);
+                    break;
+                }
+                }
+            }
+        } //namespace
+
+        void pvt::Push(Record& record)
+        {
+            auto ring = threadHandle.Ring.get();
+            if (ring == nullptr)
+            {
+                threadHandle.Ring = Instance().Register();
+                ring = threadHandle.Ring.get();
+            }
+
+            auto error = record.Where->Level == Severity::Error;
+
+            if (!ring->Records.Push(std::move(record)))
+            {
+                if (!error)
+                {
+                    ring->Dropped.fetch_add(1, std::memory_order_relaxed);
+                    return;
+                }
+
+                //errors are never dropped, empty the ring on this thread
+                Instance().Drain();
+                ring->Records.Push(std::move(record));
+            }
+
+            //errors are written before the caller goes on, in case it crashes
+            if (error)
+            {
+                Instance().Drain();
+            }
+        }
+
+        void SetVerbosity(int verbosity)
+        {
+            pvt::Threshold.store(int(Severity::Info) + std::max(verbosity, 0), std::memory_order_relaxed);
+        }
+
+        void SetSink(Sink sink)
+        {
+            Instance().SetSink(sink);
+        }
+
+        void Flush()
+        {
+            Instance().Drain();
+        }
+
+        void Shutdown()
+        {
+            Instance().Shutdown();
+        }
+
+        uint64_t Dropped()
+        {
+            return Instance().Dropped();
+        }
+
+        std::string Format(const Record& record)
+        {
+            std::string text;
+            text.reserve(128);
+
+            auto arg = 0;
+            for (auto format = record.Where->Format; *format != '\0'; format++)
+            {
+                if (*format == '{' && arg < record.ArgCount)
+                {
+                    if (format[1] == '}')
+                    {
+                        AppendArg(text, record, arg++, false);
+                        format++;
+                        continue;
+                    }
+
+                    if (format[1] == 'x' && format[2] == '}')
+                    {
+                        AppendArg(text, record, arg++, true);
+                        format += 2;
+                        continue;
+                    }
+                }
+
+                text += *format;
+            }
+
+            return text;
+        }
+    } //namespace logging
+} //namespace rtc
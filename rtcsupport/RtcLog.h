@@ -0,0 +1,259 @@
+#ifndef RTCLOG_H
+#define RTCLOG_H
+
+#include "LocalTypes.h"
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <string>
+#include <type_traits>
+
+//Logging for the bus and clock I/O paths. A log site costs a relaxed
+//load when its level is off. When on, the arguments are stored unformatted
+//in a fixed size record, and the record goes to the calling thread's own
+//lock-free ring. A background thread drains the rings, formats the text
+//and hands it to glog (or the sink set with SetSink). When a ring is
+//full, records are dropped and counted; the caller never waits. Errors
+//are the exception: they are never dropped, and they are formatted on the
+//calling thread, after everything logged before them, before it returns.
+//
+//Format strings live in a static Site per log site, and records only
+//carry its address. "{}" is replaced by the next argument, "{x}" prints
+//an integer in hex. Arguments can be integers, enums, doubles, Bytes,
+//Errno, or strings that outlive the record, such as literals or
+//getErrorMessage results. String pointers are stored, not copied.
+//
+//    rtcVlogMed("SENDING: {}", rtc::logging::Bytes(data, length));
+namespace rtc
+{
+    namespace logging
+    {
+        enum class Severity : int
+        {
+            Error,
+            Warning,
+            Info,
+            Verbose1,
+            Verbose2,
+            Verbose3
+        };
+
+        struct Site
+        {
+            Severity Level;
+            const char* File;
+            int Line;
+            const char* Format;
+        };
+
+        //a byte buffer, copied into the record and printed as [AA BB ..]
+        struct Bytes
+        {
+            const byte* Data;
+            int Length;
+
+            Bytes(const byte* data, int length) :
+                Data(data),
+                Length(length)
+            {
+            }
+        };
+
+        //an errno value, printed as "<value> - <message>"
+        struct Errno
+        {
+            int Value;
+
+            explicit Errno(int value) :
+                Value(value)
+            {
+            }
+        };
+
+        enum class ArgType : byte
+        {
+            Signed,
+            Unsigned,
+            Double,
+            String,
+            Bytes,
+            Errno
+        };
+
+        struct Record
+        {
+            static const int MaxArgs = 6;
+
+            //shared by the Bytes arguments, longer buffers are cut short
+            static const int BlobLength = 56;
+
+            const Site* Where;
+            int64_t TimestampNs;
+            uint64_t Args[MaxArgs];
+            ArgType Types[MaxArgs];
+            byte ArgCount;
+            byte BlobUsed;
+            byte Blob[BlobLength];
+        };
+
+        typedef std::function<void(const Site& site, int64_t timestampNs, const std::string& text)> Sink;
+
+        //Verbose1..3 are enabled by 1..3, the way glog's --v works.
+        //Error, Warning and Info are always on.
+        void SetVerbosity(int verbosity);
+
+        //replaces the glog sink, called on the logging thread and on any
+        //thread logging an error, never by two threads at once
+        void SetSink(Sink sink);
+
+        //formats everything logged so far, on the calling thread
+        void Flush();
+
+        //flushes and stops the logging thread for good, anything logged
+        //afterwards is only formatted by Flush
+        void Shutdown();
+
+        //records lost to full rings since the start
+        uint64_t Dropped();
+
+        std::string Format(const Record& record);
+
+        namespace pvt
+        {
+            extern std::atomic<int> Threshold;
+
+            void Push(Record& record);
+
+            inline void Add(Record& record, ArgType type, uint64_t value)
+            {
+                record.Types[record.ArgCount] = type;
+                record.Args[record.ArgCount] = value;
+                record.ArgCount++;
+            }
+
+            template <typename T>
+            inline typename std::enable_if<std::is_integral<T>::value && std::is_signed<T>::value>::type
+            Put(Record& record, T value)
+            {
+                Add(record, ArgType::Signed, uint64_t(int64_t(value)));
+            }
+
+            template <typename T>
+            inline typename std::enable_if<std::is_integral<T>::value && !std::is_signed<T>::value>::type
+            Put(Record& record, T value)
+            {
+                Add(record, ArgType::Unsigned, uint64_t(value));
+            }
+
+            template <typename T>
+            inline typename std::enable_if<std::is_enum<T>::value>::type
+            Put(Record& record, T value)
+            {
+                Add(record, ArgType::Signed, uint64_t(int64_t(value)));
+            }
+
+            template <typename T>
+            inline typename std::enable_if<std::is_floating_point<T>::value>::type
+            Put(Record& record, T value)
+            {
+                double converted = value;
+                uint64_t bits;
+                memcpy(&bits, &converted, sizeof(bits));
+
+                Add(record, ArgType::Double, bits);
+            }
+
+            inline void Put(Record& record, const char* value)
+            {
+                Add(record, ArgType::String, uint64_t(reinterpret_cast<uintptr_t>(value)));
+            }
+
+            //stored as offset << 32 | full length, so cut buffers show it
+            inline void Put(Record& record, Bytes value)
+            {
+                auto length = value.Length;
+                if (length > Record::BlobLength - record.BlobUsed)
+                {
+                    length = Record::BlobLength - record.BlobUsed;
+                }
+
+                if (length > 0)
+                {
+                    memcpy(record.Blob + record.BlobUsed, value.Data, length);
+                }
+
+                Add(record, ArgType::Bytes, (uint64_t(record.BlobUsed) << 32) | uint32_t(value.Length));
+                record.BlobUsed += length;
+            }
+
+            inline void Put(Record& record, Errno value)
+            {
+                Add(record, ArgType::Errno, uint64_t(int64_t(value.Value)));
+            }
+
+            inline void Fill(Record&)
+            {
+            }
+
+            template <typename T, typename... Rest>
+            inline void Fill(Record& record, const T& value, const Rest&... rest)
+            {
+                Put(record, value);
+                Fill(record, rest...);
+            }
+        } //namespace pvt
+
+        inline bool Enabled(Severity level)
+        {
+            return int(level) <= pvt::Threshold.load(std::memory_order_relaxed);
+        }
+
+        template <typename... Args>
+        void Write(const Site* site, const Args&... args)
+        {
+            static_assert(sizeof...(Args) <= Record::MaxArgs, "Too many log arguments");
+
+            Record record;
+            record.Where = site;
+            record.TimestampNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+            record.ArgCount = 0;
+            record.BlobUsed = 0;
+
+            pvt::Fill(record, args...);
+            pvt::Push(record);
+        }
+    } //namespace logging
+} //namespace rtc
+
+#define rtcLogAt(_level, _format, ...) \
+    do \
+    { \
+        if (rtc::logging::Enabled(_level)) \
+        { \
+            static const rtc::logging::Site rtcLogSite = { _level, __FILE__, __LINE__, _format }; \
+            rtc::logging::Write(&rtcLogSite, ##__VA_ARGS__); \
+        } \
+    } while (0)
+
+#define rtcLogError(...) \
+    rtcLogAt(rtc::logging::Severity::Error, __VA_ARGS__)
+
+#define rtcLogWarning(...) \
+    rtcLogAt(rtc::logging::Severity::Warning, __VA_ARGS__)
+
+#define rtcLogInfo(...) \
+    rtcLogAt(rtc::logging::Severity::Info, __VA_ARGS__)
+
+#define rtcVlogHigh(...) \
+    rtcLogAt(rtc::logging::Severity::Verbose1, __VA_ARGS__)
+
+#define rtcVlogMed(...) \
+    rtcLogAt(rtc::logging::Severity::Verbose2, __VA_ARGS__)
+
+#define rtcVlogLow(...) \
+    rtcLogAt(rtc::logging::Severity::Verbose3, __VA_ARGS__)
+
+#endif // RTCLOG_H
@@ -0,0 +1,316 @@
+#include "RtcManager.h"
+#include "I2CSmbus.h"
+#include "DS3231RealTimeClock.h"
+#include "DS3231TimeCodec.h"
+#include "LogSupport.h"
+#include <chrono>
+#include <map>
+
+using namespace rtc;
+
+//Seconds through Year
+static const int TimeRegisters = 7;
+
+RtcManager::RtcManager()
+    : _generation(0),
+      _busyWorkers(0),
+      _stopping(true),
+      _started(false)
+{
+}
+
+RtcManager::~RtcManager()
+{
+    Stop();
+}
+
+int64_t RtcManager::MonotonicNs()
+{
+    auto now = std::chrono::steady_clock::now().time_since_epoch();
+
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(now).count();
+}
+
+int RtcManager::AddDevice(int adapter, int address, I2CDevice* device /*= nullptr*/)
+{
+    std::unique_ptr<I2CSmbus> bus(new I2CSmbus(adapter, address, device));
+    if (!bus->Initialize())
+    {
+        logError << "could not open i2c-" << adapter << " address " << address;
+        return -1;
+    }
+
+    std::unique_ptr<RealTimeClock> clock(new DS3231RealTimeClock(bus.get()));
+
+    auto smbus = bus.get();
+
+    auto idx = AddDevice(adapter, std::move(bus), std::move(clock));
+    if (idx >= 0)
+    {
+        _devices[idx].Address = address;
+        _devices[idx].Smbus = smbus;
+    }
+
+    return idx;
+}
+
+int RtcManager::AddDevice(int adapter, std::unique_ptr<I2CBus> bus, std::unique_ptr<RealTimeClock> clock)
+{
+    if (_started)
+    {
+        return -1;
+    }
+
+    Device device;
+    device.Adapter = adapter;
+    device.Address = -1;
+    device.Smbus = nullptr;
+    device.Bus = std::move(bus);
+    device.Clock = std::move(clock);
+
+    _devices.push_back(std::move(device));
+
+    return int(_devices.size()) - 1;
+}
+
+bool RtcManager::Start()
+{
+    if (_started)
+    {
+        return true;
+    }
+
+    auto initialized = true;
+    for (auto& device : _devices)
+    {
+        initialized = device.Clock->Initialize() && initialized;
+    }
+
+    if (!initialized)
+    {
+        return false;
+    }
+
+    _readings.resize(_devices.size());
+
+    std::map<int, Worker*> adapters;
+    for (auto idx = 0; idx < int(_devices.size()); idx++)
+    {
+        auto& worker = adapters[_devices[idx].Adapter];
+        if (worker == nullptr)
+        {
+            _workers.emplace_back(new Worker());
+            worker = _workers.back().get();
+            worker->Adapter = _devices[idx].Adapter;
+        }
+
+        worker->Devices.push_back(idx);
+    }
+
+    //any of the batched buses can carry the transfer for all of them
+    for (auto& worker : _workers)
+    {
+        std::vector<int> batched;
+        std::vector<int> single;
+        for (auto idx : worker->Devices)
+        {
+            auto combine = _devices[idx].Smbus != nullptr && _devices[idx].Smbus->CanCombine();
+            (combine ? batched : single).push_back(idx);
+        }
+
+        if (batched.size() < 2)
+        {
+            continue;
+        }
+
+        worker->Devices = single;
+        worker->Batched = batched;
+        for (auto idx : batched)
+        {
+            worker->Addresses.push_back(_devices[idx].Address);
+        }
+
+        worker->Data.resize(batched.size() * TimeRegisters);
+    }
+
+    unsigned generation;
+    {
+        std::lock_guard<std::mutex> lock(_lock);
+
+        _stopping = false;
+        generation = _generation;
+    }
+
+    _started = true;
+
+    //taken before the threads exist, so a Snapshot that starts before
+    //a worker first waits is still served, and no earlier one is
+    for (auto& worker : _workers)
+    {
+        worker->Thread = std::thread(&RtcManager::Run, this, worker.get(), generation);
+    }
+
+    logInfo << "rtc manager started, " << _devices.size() << " devices on " << _workers.size() << " adapters";
+
+    return true;
+}
+
+void RtcManager::Stop()
+{
+    if (!_started)
+    {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(_lock);
+        _stopping = true;
+    }
+
+    _request.notify_all();
+
+    for (auto& worker : _workers)
+    {
+        worker->Thread.join();
+    }
+
+    _workers.clear();
+    _started = false;
+
+    for (auto& device : _devices)
+    {
+        device.Clock->Shutdown();
+    }
+}
+
+bool RtcManager::Snapshot(RtcSnapshot& snapshot)
+{
+    std::lock_guard<std::mutex> snapshotLock(_snapshotLock);
+
+    snapshot.StartNs = MonotonicNs();
+
+    {
+        std::unique_lock<std::mutex> lock(_lock);
+
+        //not started, or the workers are on their way out
+        if (_stopping)
+        {
+            return false;
+        }
+
+        _busyWorkers = int(_workers.size());
+        _generation++;
+        _request.notify_all();
+
+        _complete.wait(lock, [this] { return _busyWorkers == 0; });
+    }
+
+    snapshot.EndNs = MonotonicNs();
+    snapshot.Readings = _readings;
+
+    auto result = true;
+    for (const auto& reading : _readings)
+    {
+        result = result && reading.Result == Status::Ok;
+    }
+
+    return result;
+}
+
+void RtcManager::Run(Worker* worker, unsigned generation)
+{
+    auto seen = generation;
+
+    for (;;)
+    {
+        {
+            std::unique_lock<std::mutex> lock(_lock);
+
+            _request.wait(lock, [this, seen] { return _stopping || _generation != seen; });
+
+            //a snapshot requested before Stop is still served, otherwise
+            //its caller would wait for this worker forever
+            if (_generation == seen)
+            {
+                return;
+            }
+
+            seen = _generation;
+        }
+
+        //each worker only writes the readings of its own devices. When
+        //the combined read fails each device is tried on its own, so one
+        //missing clock does not take the others down with it.
+        if (!worker->Batched.empty() && !ReadBatch(worker))
+        {
+            for (auto device : worker->Batched)
+            {
+                ReadDevice(device);
+            }
+        }
+
+        for (auto device : worker->Devices)
+        {
+            ReadDevice(device);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(_lock);
+            _busyWorkers--;
+        }
+
+        _complete.notify_one();
+    }
+}
+
+void RtcManager::ReadDevice(int device)
+{
+    auto& reading = _readings[device];
+
+    reading.Device = device;
+    reading.Adapter = _devices[device].Adapter;
+    reading.Value.Month = Months::None;
+
+    auto before = MonotonicNs();
+    _devices[device].Clock->GetDateTime(reading.Value);
+    auto after = MonotonicNs();
+
+    reading.ReadNs = before + (after - before) / 2;
+    reading.LatencyNs = after - before;
+
+    //the clock leaves the value untouched when the read fails
+    reading.Result = reading.Value.Month == Months::None
+        ? Status::ReceiveFail
+        : Status::Ok;
+}
+
+bool RtcManager::ReadBatch(Worker* worker)
+{
+    auto count = int(worker->Batched.size());
+    auto bus = _devices[worker->Batched[0]].Smbus;
+
+    auto before = MonotonicNs();
+    auto result = bus->ReceiveFrom(worker->Addresses.data(), count, byte(DS3231RegisterId::Seconds), worker->Data.data(), TimeRegisters);
+    auto after = MonotonicNs();
+
+    if (result != Status::Ok)
+    {
+        return false;
+    }
+
+    for (auto idx = 0; idx < count; idx++)
+    {
+        auto device = worker->Batched[idx];
+        auto& reading = _readings[device];
+
+        reading.Device = device;
+        reading.Adapter = worker->Adapter;
+        reading.Result = Status::Ok;
+        reading.ReadNs = before + (after - before) / 2;
+        reading.LatencyNs = after - before;
+
+        DS3231TimeCodec::Decode(worker->Data.data() + idx * TimeRegisters, reading.Value);
+    }
+
+    return true;
+}
@@ -0,0 +1,142 @@
+#ifndef RTCMANAGER_H
+#define RTCMANAGER_H
+
+#include "LocalTypes.h"
+#include "IoError.h"
+#include "I2CBus.h"
+#include "I2CSmbus.h"
+#include "RealTimeClock.h"
+#include <stdint.h>
+#include <memory>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+namespace rtc
+{
+    struct RtcReading
+    {
+        //index returned by AddDevice
+        int Device;
+        int Adapter;
+
+        Status Result;
+        RtcDateTime Value;
+
+        //monotonic time half way through the read, and how long it took
+        int64_t ReadNs;
+        int64_t LatencyNs;
+    };
+
+    struct RtcSnapshot
+    {
+        //monotonic time the request went out and the last read completed
+        int64_t StartNs;
+        int64_t EndNs;
+
+        //one reading per device, indexed by device
+        std::vector<RtcReading> Readings;
+    };
+
+    //Owns a set of clocks spread over several I2C adapters and reads them
+    //all at once. Each adapter is its own serialisation domain, so every
+    //adapter gets a worker thread that reads its devices back to back
+    //while the other adapters do the same in parallel.
+    //
+    //DS3231s added by address on an adapter with plain I2C support are
+    //read together, one combined transfer per worker, and each of them
+    //reports the latency of that transfer.
+    //
+    //Devices are added before Start. While running the clocks are only
+    //touched by the workers.
+    class RtcManager
+    {
+        struct Device
+        {
+            int Adapter;
+            //-1 unless added by address, Smbus is then Bus
+            int Address;
+            I2CSmbus* Smbus;
+            std::unique_ptr<I2CBus> Bus;
+            std::unique_ptr<RealTimeClock> Clock;
+        };
+
+        struct Worker
+        {
+            int Adapter;
+            //read one by one
+            std::vector<int> Devices;
+
+            //read in one transfer, with their addresses and the raw
+            //time registers of each
+            std::vector<int> Batched;
+            std::vector<int> Addresses;
+            std::vector<byte> Data;
+
+            std::thread Thread;
+        };
+
+        std::vector<Device> _devices;
+        std::vector<std::unique_ptr<Worker>> _workers;
+
+        //serialises Snapshot callers
+        std::mutex _snapshotLock;
+
+        std::mutex _lock;
+        std::condition_variable _request;
+        std::condition_variable _complete;
+        unsigned _generation;
+        int _busyWorkers;
+        bool _stopping;
+        bool _started;
+
+        std::vector<RtcReading> _readings;
+
+    public:
+        RtcManager();
+        ~RtcManager();
+
+        RtcManager(const RtcManager&) = delete;
+
+        //DS3231 on /dev/i2c-<adapter>, or on the stand-in device, which
+        //must outlive the manager. Returns the device index, or -1 if the
+        //adapter cannot be opened.
+        int AddDevice(int adapter, int address, I2CDevice* device = nullptr);
+
+        //any clock, the bus is kept alive for the clock's lifetime
+        int AddDevice(int adapter, std::unique_ptr<I2CBus> bus, std::unique_ptr<RealTimeClock> clock);
+
+        int DeviceCount() const
+        {
+            return int(_devices.size());
+        }
+
+        //direct access for setup, only while stopped
+        RealTimeClock* Clock(int device)
+        {
+            return _devices[device].Clock.get();
+        }
+
+        //initialise every clock and start one worker per adapter.
+        //Returns false if any clock fails to initialise.
+        bool Start();
+        void Stop();
+
+        //read every clock, adapters in parallel. False if stopped, a
+        //snapshot already requested when Stop is called still completes.
+        bool Snapshot(RtcSnapshot& snapshot);
+
+        static int64_t MonotonicNs();
+
+    private:
+        //generation is the last request the worker is not to serve
+        void Run(Worker* worker, unsigned generation);
+        void ReadDevice(int device);
+
+        //false if the combined transfer failed, nothing is recorded then
+        bool ReadBatch(Worker* worker);
+    };
+} //namespace rtc
+
+#endif // RTCMANAGER_H
@@ -0,0 +1,189 @@
+#ifndef RTCTASK_H
+#define RTCTASK_H
+
+//Coroutine support is only compiled when the compiler provides it
+//(C++20), the rest of the library stays C++11.
+#if defined(__cpp_impl_coroutine)
+
+#define RTC_COROUTINES 1
+
+#include <coroutine>
+#include <exception>
+#include <utility>
+
+namespace rtc
+{
+    template <typename T>
+    class RtcTask;
+
+    namespace pvt
+    {
+        //hands control back to whoever awaited the task
+        struct TaskFinalAwaiter
+        {
+            bool await_ready() const noexcept
+            {
+                return false;
+            }
+
+            template <typename Promise>
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept
+            {
+                auto continuation = handle.promise().Continuation;
+
+                return continuation
+                    ? continuation
+                    : std::noop_coroutine();
+            }
+
+            void await_resume() const noexcept
+            {
+            }
+        };
+
+        struct TaskPromiseBase
+        {
+            std::coroutine_handle<> Continuation;
+
+            std::suspend_always initial_suspend() const noexcept
+            {
+                return {};
+            }
+
+            TaskFinalAwaiter final_suspend() const noexcept
+            {
+                return {};
+            }
+
+            //failures are returned as Status, nothing is expected to throw
+            void unhandled_exception() const noexcept
+            {
+                std::terminate();
+            }
+        };
+
+        template <typename T>
+        struct TaskPromise : TaskPromiseBase
+        {
+            T Value;
+
+            RtcTask<T> get_return_object() noexcept;
+
+            void return_value(T value)
+            {
+                Value = std::move(value);
+            }
+
+            T Result()
+            {
+                return std::move(Value);
+            }
+        };
+
+        template <>
+        struct TaskPromise<void> : TaskPromiseBase
+        {
+            RtcTask<void> get_return_object() noexcept;
+
+            void return_void() const noexcept
+            {
+            }
+
+            void Result() const noexcept
+            {
+            }
+        };
+    } //namespace pvt
+
+    //Lazily started coroutine returning T. Awaiting the task starts it and
+    //resumes the awaiting coroutine when it finishes, top level tasks are
+    //started by RtcEventLoop::Spawn.
+    template <typename T = void>
+    class RtcTask
+    {
+    public:
+        typedef pvt::TaskPromise<T> promise_type;
+        typedef std::coroutine_handle<promise_type> Handle;
+
+    private:
+        Handle _handle;
+
+    public:
+        explicit RtcTask(Handle handle) :
+            _handle(handle)
+        {
+        }
+
+        RtcTask(RtcTask&& other) noexcept :
+            _handle(std::exchange(other._handle, {}))
+        {
+        }
+
+        RtcTask(const RtcTask&) = delete;
+
+        ~RtcTask()
+        {
+            if (_handle)
+            {
+                _handle.destroy();
+            }
+        }
+
+        RtcTask& operator=(RtcTask&& other) noexcept
+        {
+            if (this != &other)
+            {
+                if (_handle)
+                {
+                    _handle.destroy();
+                }
+
+                _handle = std::exchange(other._handle, {});
+            }
+
+            return *this;
+        }
+
+        bool Done() const
+        {
+            return !_handle || _handle.done();
+        }
+
+        //give up ownership of the coroutine
+        Handle Release()
+        {
+            return std::exchange(_handle, {});
+        }
+
+        bool await_ready() const noexcept
+        {
+            return false;
+        }
+
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<> caller) noexcept
+        {
+            _handle.promise().Continuation = caller;
+            return _handle;
+        }
+
+        T await_resume()
+        {
+            return _handle.promise().Result();
+        }
+    };
+
+    template <typename T>
+    RtcTask<T> pvt::TaskPromise<T>::get_return_object() noexcept
+    {
+        return RtcTask<T>(RtcTask<T>::Handle::from_promise(*this));
+    }
+
+    inline RtcTask<void> pvt::TaskPromise<void>::get_return_object() noexcept
+    {
+        return RtcTask<void>(RtcTask<void>::Handle::from_promise(*this));
+    }
+} //namespace rtc
+
+#endif // __cpp_impl_coroutine
+
+#endif // RTCTASK_H
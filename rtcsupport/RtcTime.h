@@ -1,9 +1,7 @@
 ﻿#if !defined(RTCTIME_H)
 #define RTCTIME_H
 
-#include <sstream>
 #include <string>
-#include <iomanip>
 
 namespace rtc
 {
@@ -20,6 +18,89 @@ namespace rtc
 		MilitaryClock
 	};
 
+	// Appends text to a caller supplied buffer without allocating. Once the
+	// buffer is full every further write is dropped and Finish returns 0.
+	class RtcFormatWriter
+	{
+		char* _buffer;
+		int _size;
+		int _length;
+		bool _overflow;
+
+	public:
+		RtcFormatWriter(char* buffer, int size) :
+			_buffer(buffer),
+			_size(size),
+			_length(0),
+			_overflow(size <= 0)
+		{
+		}
+
+		void Char(char value)
+		{
+			if (_length + 1 >= _size)
+			{
+				_overflow = true;
+				return;
+			}
+
+			_buffer[_length++] = value;
+		}
+
+		void Text(const char* value)
+		{
+			while (*value != '\0')
+			{
+				Char(*value++);
+			}
+		}
+
+		// zero padded to width digits
+		void Number(int value, int width = 1)
+		{
+			char digits[12];
+			auto count = 0;
+
+			unsigned magnitude = value < 0 ? 0u - unsigned(value) : unsigned(value);
+			do
+			{
+				digits[count++] = char('0' + magnitude % 10);
+				magnitude /= 10;
+			} while (magnitude != 0);
+
+			if (value < 0)
+			{
+				Char('-');
+			}
+
+			for (auto pad = count; pad < width; pad++)
+			{
+				Char('0');
+			}
+
+			while (count > 0)
+			{
+				Char(digits[--count]);
+			}
+		}
+
+		// terminates the text and returns its length, 0 if it did not fit
+		int Finish()
+		{
+			if (_overflow)
+			{
+				if (_size > 0)
+				{
+					_buffer[0] = '\0';
+				}
+				return 0;
+			}
+
+			_buffer[_length] = '\0';
+			return _length;
+		}
+	};
+
 	struct RtcTime
 	{
 		ClockMode Mode;
@@ -48,38 +129,89 @@ namespace rtc
 			Second(src.Second)
 		{
 		}
+
+		RtcTime& operator=(const RtcTime& src)
+		{
+			Mode = src.Mode;
+			Period = src.Period;
+			Hour = src.Hour;
+			Minute = src.Minute;
+			Second = src.Second;
+			return *this;
+		}
 		
-		std::string AsString() const
+		// large enough for any value, including out of range fields
+		static const int FormatSize = 48;
+
+		// "h:mm:ss AM" or "hh:mm:ss" depending on the mode. Returns the
+		// length written, or 0 if the buffer is too small.
+		int Format(char* buffer, int size) const
+		{
+			RtcFormatWriter txt(buffer, size);
+			Format(txt);
+			return txt.Finish();
+		}
+
+		// "hh:mm:ss" on a 24 hour clock whatever the mode
+		int FormatIso8601(char* buffer, int size) const
+		{
+			RtcFormatWriter txt(buffer, size);
+			FormatIso8601(txt);
+			return txt.Finish();
+		}
+
+		void Format(RtcFormatWriter& txt) const
 		{
-			std::stringstream txt;
-			
 			if (Mode == ClockMode::WallClock)
 			{
-				txt << Hour << ":" << std::setw(2) << std::setfill('0')
-					<< Minute << ":" 
-					<< std::setw(2) << std::setfill('0') << Second;
-				
+				txt.Number(Hour);
+				txt.Char(':');
+				txt.Number(Minute, 2);
+				txt.Char(':');
+				txt.Number(Second, 2);
+
 				switch (Period)
 				{
 				default: 
-					txt << " ?";
+					txt.Text(" ?");
 					break;
 				case Meridiem::Am: 
-					txt << " AM";
+					txt.Text(" AM");
 					break;
 				case Meridiem::Pm: 
-					txt << " PM";
+					txt.Text(" PM");
 					break;
 				}
 			}
 			else
 			{
-				txt << std::setw(2) << std::setfill('0') << Hour << ":" 
-					<< std::setw(2) << std::setfill('0') << Minute << ":" 
-					<< std::setw(2) << std::setfill('0') << Second;
+				txt.Number(Hour, 2);
+				txt.Char(':');
+				txt.Number(Minute, 2);
+				txt.Char(':');
+				txt.Number(Second, 2);
 			}
-			
-			return txt.str();
+		}
+
+		void FormatIso8601(RtcFormatWriter& txt) const
+		{
+			auto hour = Hour;
+			if (Mode == ClockMode::WallClock)
+			{
+				hour = Hour % 12 + (Period == Meridiem::Pm ? 12 : 0);
+			}
+
+			txt.Number(hour, 2);
+			txt.Char(':');
+			txt.Number(Minute, 2);
+			txt.Char(':');
+			txt.Number(Second, 2);
+		}
+
+		std::string AsString() const
+		{
+			char buffer[FormatSize];
+			return std::string(buffer, Format(buffer, sizeof(buffer)));
 		}
 	};
 
@@ -151,91 +283,80 @@ namespace rtc
 			Year(other.Year)
 		{
 		}
+
+		RtcDateTime& operator=(const RtcDateTime& other)
+		{
+			Time = other.Time;
+			Day = other.Day;
+			WeekDay = other.WeekDay;
+			Month = other.Month;
+			Year = other.Year;
+			return *this;
+		}
 		
-		std::string AsString(bool withWeekDay = false) const
+		static const int FormatSize = 96;
+
+		// "d (Day) Mon yyyy" followed by the time in its own mode. Returns
+		// the length written, or 0 if the buffer is too small.
+		int Format(char* buffer, int size, bool withWeekDay = false) const
 		{
-			std::stringstream txt;
-						
-			txt << Day;
-			
-			if (withWeekDay)
+			static const char* const weekDays[8] = 
 			{
-				switch (WeekDay)
-				{
-				default:
-					txt << " (?)";
-					break;
-				case DayOfWeek::Sun: 
-					txt << " (Sun)";
-					break;
-				case DayOfWeek::Mon: 
-					txt << " (Mon)";
-					break;
-				case DayOfWeek::Tue: 
-					txt << " (Tue)";
-					break;
-				case DayOfWeek::Wed: 
-					txt << " (Wed)";
-					break;
-				case DayOfWeek::Thu: 
-					txt << " (Thu)";
-					break;
-				case DayOfWeek::Fri: 
-					txt << " (Fri)";
-					break;
-				case DayOfWeek::Sat: 
-					txt << " (Sat)";
-					break;
-				}
-			}
-			
-			switch (Month)
+				" (?)", " (Sun)", " (Mon)", " (Tue)", " (Wed)", " (Thu)", " (Fri)", " (Sat)"
+			};
+			static const char* const months[13] = 
+			{
+				" ?", " Jan", " Feb", " Mar", " Apr", " May", " Jun", 
+				" Jul", " Aug", " Sep", " Oct", " Nov", " Dec"
+			};
+
+			RtcFormatWriter txt(buffer, size);
+
+			txt.Number(Day);
+
+			if (withWeekDay)
 			{
-			default: 
-				txt << " ?";
-				break;
-			case Months::Jan: 
-				txt << " Jan";
-				break;
-			case Months::Feb: 
-				txt << " Feb";
-				break;
-			case Months::Mar: 
-				txt << " Mar";
-				break;
-			case Months::Apr: 
-				txt << " Apr";
-				break;
-			case Months::May: 
-				txt << " May";
-				break;
-			case Months::Jun: 
-				txt << " Jun";
-				break;
-			case Months::Jul: 
-				txt << " Jul";
-				break;
-			case Months::Aug: 
-				txt << " Aug";
-				break;
-			case Months::Sep: 
-				txt << " Sep";
-				break;
-			case Months::Oct: 
-				txt << " Oct";
-				break;
-			case Months::Nov: 
-				txt << " Nov";
-				break;
-			case Months::Dec: 
-				txt << " Dec";
-				break;
+				auto weekDay = unsigned(WeekDay);
+				txt.Text(weekDays[weekDay < 8 ? weekDay : 0]);
 			}
-			
-			txt << " " << Year;
-			txt << " " << Time.AsString();
-			
-			return txt.str();
+
+			auto month = unsigned(Month);
+			txt.Text(months[month < 13 ? month : 0]);
+
+			txt.Char(' ');
+			txt.Number(Year);
+			txt.Char(' ');
+			Time.Format(txt);
+
+			return txt.Finish();
+		}
+
+		// "yyyy-mm-ddThh:mm:ss", the time on a 24 hour clock
+		int FormatIso8601(char* buffer, int size) const
+		{
+			RtcFormatWriter txt(buffer, size);
+
+			txt.Number(Year, 4);
+			txt.Char('-');
+			txt.Number(int(Month), 2);
+			txt.Char('-');
+			txt.Number(Day, 2);
+			txt.Char('T');
+			Time.FormatIso8601(txt);
+
+			return txt.Finish();
+		}
+
+		std::string AsString(bool withWeekDay = false) const
+		{
+			char buffer[FormatSize];
+			return std::string(buffer, Format(buffer, sizeof(buffer), withWeekDay));
+		}
+
+		std::string AsIso8601() const
+		{
+			char buffer[FormatSize];
+			return std::string(buffer, FormatIso8601(buffer, sizeof(buffer)));
 		}
 	};
 } //namespace rtc
@@ -0,0 +1,218 @@
+#ifndef RTCTIMESTAMP_H
+#define RTCTIMESTAMP_H
+
+#include "RtcTime.h"
+#include "RealTimeClockPrivate.h"
+#include <stdint.h>
+#include <time.h>
+#include <chrono>
+
+namespace rtc
+{
+    //Nanoseconds since 1970-01-01 00:00:00, with the clock time taken as UTC.
+    //Conversions to and from RtcDateTime go through the day count directly,
+    //so there is no per-field normalisation and no timezone lookup.
+    class RtcTimestamp
+    {
+        int64_t _ns;
+
+    public:
+        static const int64_t NsPerSecond = 1000000000LL;
+        static const int64_t SecondsPerDay = 86400;
+
+        RtcTimestamp() :
+            _ns(0)
+        {
+        }
+
+        explicit RtcTimestamp(int64_t epochNs) :
+            _ns(epochNs)
+        {
+        }
+
+        static RtcTimestamp FromEpochSeconds(int64_t seconds, int nanoseconds = 0)
+        {
+            return RtcTimestamp(seconds * NsPerSecond + nanoseconds);
+        }
+
+        static RtcTimestamp FromCivil(int year, int month, int day, int hour = 0, int minute = 0, int second = 0)
+        {
+            auto days = pvt::DaysFromCivil(year, month, day);
+
+            return FromEpochSeconds(days * SecondsPerDay + hour * 3600 + minute * 60 + second);
+        }
+
+        //the weekday is not used, wall clock hours are converted to 24 hour
+        static RtcTimestamp FromDateTime(const RtcDateTime& value)
+        {
+            return FromEpochSeconds(pvt::ToEpochSeconds(value));
+        }
+
+        static RtcTimestamp FromTimeT(time_t value)
+        {
+            return FromEpochSeconds(int64_t(value));
+        }
+
+        static RtcTimestamp FromTimePoint(std::chrono::system_clock::time_point value)
+        {
+            auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(value.time_since_epoch());
+
+            return RtcTimestamp(int64_t(ns.count()));
+        }
+
+        static RtcTimestamp Now()
+        {
+            return FromTimePoint(std::chrono::system_clock::now());
+        }
+
+        //Parse "YYYY-MM-DD hh:mm:ss", a 'T' may separate date and time.
+        //Returns false unless every field is present and in range.
+        static bool Parse(const char* text, RtcTimestamp& value)
+        {
+            int year, month, day, hour, minute, second;
+
+            if (!ParseField(text, 4, '-', year) ||
+                !ParseField(text, 2, '-', month) ||
+                !ParseField(text, 2, ' ', day) ||
+                !ParseField(text, 2, ':', hour) ||
+                !ParseField(text, 2, ':', minute) ||
+                !ParseField(text, 2, '\0', second))
+            {
+                return false;
+            }
+
+            if (month < 1 || month > 12 ||
+                day < 1 || day > DaysInMonth(year, month) ||
+                hour > 23 || minute > 59 || second > 59)
+            {
+                return false;
+            }
+
+            value = FromCivil(year, month, day, hour, minute, second);
+            return true;
+        }
+
+        int64_t EpochNanoseconds() const
+        {
+            return _ns;
+        }
+
+        //whole seconds, rounded towards negative infinity
+        int64_t EpochSeconds() const
+        {
+            auto seconds = _ns / NsPerSecond;
+            return _ns % NsPerSecond < 0
+                ? seconds - 1
+                : seconds;
+        }
+
+        //nanoseconds into the current second, 0 - 999999999
+        int Nanoseconds() const
+        {
+            return int(_ns - EpochSeconds() * NsPerSecond);
+        }
+
+        time_t ToTimeT() const
+        {
+            return time_t(EpochSeconds());
+        }
+
+        std::chrono::system_clock::time_point ToTimePoint() const
+        {
+            return std::chrono::system_clock::time_point(
+                std::chrono::duration_cast<std::chrono::system_clock::duration>(std::chrono::nanoseconds(_ns)));
+        }
+
+        //the weekday is derived from the date
+        void ToDateTime(RtcDateTime& value, ClockMode mode = ClockMode::MilitaryClock) const
+        {
+            pvt::FromEpochSeconds(EpochSeconds(), mode, value);
+        }
+
+        RtcDateTime ToDateTime(ClockMode mode = ClockMode::MilitaryClock) const
+        {
+            RtcDateTime value;
+            ToDateTime(value, mode);
+            return value;
+        }
+
+        //Express a time in the other clock mode: 0-23 for military,
+        //1-12 plus AM/PM for wall clock.
+        static void Normalize(RtcTime& time, ClockMode mode)
+        {
+            pvt::SetHour(time, pvt::ToMilitaryHour(time), mode);
+        }
+
+        static bool IsLeapYear(int year)
+        {
+            return (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+        }
+
+        static int DaysInMonth(int year, int month)
+        {
+            static const byte days[13] = { 0, 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+
+            return month == 2 && IsLeapYear(year)
+                ? 29
+                : days[month];
+        }
+
+        RtcTimestamp& operator+=(int64_t ns)
+        {
+            _ns += ns;
+            return *this;
+        }
+
+        RtcTimestamp operator+(int64_t ns) const
+        {
+            return RtcTimestamp(_ns + ns);
+        }
+
+        //difference in nanoseconds
+        int64_t operator-(const RtcTimestamp& other) const
+        {
+            return _ns - other._ns;
+        }
+
+        bool operator==(const RtcTimestamp& other) const { return _ns == other._ns; }
+        bool operator!=(const RtcTimestamp& other) const { return _ns != other._ns; }
+        bool operator<(const RtcTimestamp& other) const { return _ns < other._ns; }
+        bool operator<=(const RtcTimestamp& other) const { return _ns <= other._ns; }
+        bool operator>(const RtcTimestamp& other) const { return _ns > other._ns; }
+        bool operator>=(const RtcTimestamp& other) const { return _ns >= other._ns; }
+
+    private:
+        //fixed width decimal field followed by a separator, advances text
+        static bool ParseField(const char*& text, int width, char separator, int& value)
+        {
+            value = 0;
+            for (auto idx = 0; idx < width; idx++)
+            {
+                auto digit = text[idx] - '0';
+                if (digit < 0 || digit > 9)
+                {
+                    return false;
+                }
+                value = value * 10 + digit;
+            }
+
+            text += width;
+
+            auto matched = *text == separator ||
+                (separator == ' ' && *text == 'T');
+            if (!matched)
+            {
+                return false;
+            }
+
+            if (separator != '\0')
+            {
+                text++;
+            }
+
+            return true;
+        }
+    };
+} //namespace rtc
+
+#endif // RTCTIMESTAMP_H
@@ -0,0 +1,162 @@
+#include "RtcTrace.h"
+#include <string.h>
+#include <chrono>
+#include <iomanip>
+
+namespace rtc
+{
+    namespace trace
+    {
+        std::atomic<unsigned> pvt::SampleEvery(0);
+
+        Ring::Ring() :
+            _next(0)
+        {
+            Clear();
+        }
+
+        void Ring::Write(const Record& record)
+        {
+            uint64_t words[RecordWords];
+            memcpy(words, &record, sizeof(words));
+
+            auto index = _next.fetch_add(1, std::memory_order_relaxed);
+            auto& slot = _slots[index & Mask];
+
+            slot.Sequence.store(2 * index + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+
+            for (size_t idx = 0; idx < RecordWords; idx++)
+            {
+                slot.Words[idx].store(words[idx], std::memory_order_relaxed);
+            }
+
+            slot.Sequence.store(2 * (index + 1), std::memory_order_release);
+        }
+
+        void Ring::Snapshot(std::vector<Record>& records) const
+        {
+            records.clear();
+
+            auto next = _next.load(std::memory_order_acquire);
+            auto first = next > Capacity ? next - Capacity : 0;
+
+            records.reserve(next - first);
+
+            for (auto index = first; index < next; index++)
+            {
+                auto& slot = _slots[index & Mask];
+
+                auto sequence = slot.Sequence.load(std::memory_order_acquire);
+                if (sequence != 2 * (index + 1))
+                {
+                    continue;
+                }
+
+                uint64_t words[RecordWords];
+                for (size_t idx = 0; idx < RecordWords; idx++)
+                {
+                    words[idx] = slot.Words[idx].load(std::memory_order_relaxed);
+                }
+
+                //overwritten while it was copied
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (slot.Sequence.load(std::memory_order_relaxed) != sequence)
+                {
+                    continue;
+                }
+
+                Record record;
+                memcpy(&record, words, sizeof(words));
+                records.push_back(record);
+            }
+        }
+
+        //not safe against concurrent writers
+        void Ring::Clear()
+        {
+            for (auto& slot : _slots)
+            {
+                slot.Sequence.store(0, std::memory_order_relaxed);
+            }
+
+            _next.store(0, std::memory_order_release);
+        }
+
+        void SetSampling(unsigned every)
+        {
+            pvt::SampleEvery.store(every, std::memory_order_relaxed);
+        }
+
+        Ring& Buffer()
+        {
+            static Ring ring;
+            return ring;
+        }
+
+        void Emit(Event type, byte reg, const byte* data, int count, Status result)
+        {
+            Record record;
+            memset(&record, 0, sizeof(record));
+
+            record.TimestampNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+            record.Type = type;
+            record.Register = reg;
+            record.Count = byte(count);
+            record.Result = int32_t(result);
+
+            auto length = count;
+            if (length > Record::DataLength)
+            {
+                length = Record::DataLength;
+            }
+
+            if (data != nullptr && length > 0)
+            {
+                memcpy(record.Data, data, length);
+            }
+
+            Buffer().Write(record);
+        }
+
+        const char* EventName(Event type)
+        {
+            switch (type)
+            {
+            case Event::RegisterRead:
+                return "read";
+            case Event::RegisterWrite:
+                return "write";
+            }
+
+            return "unknown";
+        }
+
+        void Print(std::ostream& out, const Record& record)
+        {
+            auto flags = out.flags();
+            auto fill = out.fill();
+
+            out << record.TimestampNs << ' ' << EventName(record.Type)
+                << " 0x" << std::hex << std::setfill('0') << std::setw(2) << int(record.Register)
+                << std::dec << ' ' << int(record.Count) << ' ' << record.Result << ':';
+
+            int length = record.Count;
+            if (length > Record::DataLength)
+            {
+                length = Record::DataLength;
+            }
+
+            for (int idx = 0; idx < length; idx++)
+            {
+                out << ' ' << std::hex << std::setw(2) << int(record.Data[idx]) << std::dec;
+            }
+
+            out << '\n';
+
+            out.flags(flags);
+            out.fill(fill);
+        }
+    } //namespace trace
+} //namespace rtc
@@ -0,0 +1,146 @@
+#ifndef RTCTRACE_H
+#define RTCTRACE_H
+
+#include "IoError.h"
+#include "LocalTypes.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <ostream>
+#include <vector>
+
+//Register traffic tracing. Build with DEFINES += RTC_TRACE to compile the
+//RTC_TRACE_* macros in, otherwise they expand to nothing and their
+//arguments are not evaluated.
+//
+//When compiled in, tracing is off until SetSampling is called. Sampled
+//transfers are stored as fixed size binary records in a process wide ring
+//that keeps the newest records; nothing is formatted until the ring is
+//read back with Snapshot and Print.
+namespace rtc
+{
+    namespace trace
+    {
+#if defined(RTC_TRACE)
+        static const bool Compiled = true;
+#else
+        static const bool Compiled = false;
+#endif
+
+        enum class Event : uint16_t
+        {
+            RegisterRead,
+            RegisterWrite
+        };
+
+        //one slot's worth, the register bytes past DataLength are dropped
+        struct Record
+        {
+            static const int DataLength = 40;
+
+            int64_t TimestampNs;
+            Event Type;
+            byte Register;
+            byte Count;
+            int32_t Result;
+            byte Data[DataLength];
+        };
+
+        static_assert(sizeof(Record) % sizeof(uint64_t) == 0, "Record is copied in whole words");
+
+        //Lock-free ring for any number of writer threads. A writer claims
+        //the next slot with one atomic add and overwrites whatever was
+        //there. Readers skip slots that are being written, a writer lapped
+        //by the whole ring while still writing can tear its record.
+        class Ring
+        {
+        public:
+            static const size_t Capacity = 4096;
+
+        private:
+            static const size_t Mask = Capacity - 1;
+            static const size_t RecordWords = sizeof(Record) / sizeof(uint64_t);
+
+            //the sequence is odd while the slot is written, and
+            //2 * (index + 1) once record index is complete
+            struct alignas(64) Slot
+            {
+                std::atomic<uint64_t> Sequence;
+                std::atomic<uint64_t> Words[RecordWords];
+            };
+
+            alignas(64) std::atomic<uint64_t> _next;
+            Slot _slots[Capacity];
+
+        public:
+            Ring();
+
+            Ring(const Ring&) = delete;
+
+            void Write(const Record& record);
+
+            //the complete records still in the ring, oldest first
+            void Snapshot(std::vector<Record>& records) const;
+
+            //records written since the start, including overwritten ones
+            uint64_t Written() const
+            {
+                return _next.load(std::memory_order_relaxed);
+            }
+
+            void Clear();
+        };
+
+        namespace pvt
+        {
+            extern std::atomic<unsigned> SampleEvery;
+        }
+
+        //record every Nth traced transfer on each thread, 0 turns tracing
+        //off. Has no effect unless built with RTC_TRACE.
+        void SetSampling(unsigned every);
+
+        inline bool Sample()
+        {
+            auto every = pvt::SampleEvery.load(std::memory_order_relaxed);
+            if (every == 0)
+            {
+                return false;
+            }
+
+            static thread_local unsigned count = 0;
+            return ++count % every == 0;
+        }
+
+        Ring& Buffer();
+
+        void Emit(Event type, byte reg, const byte* data, int count, Status result);
+
+        const char* EventName(Event type);
+
+        //one line per record, e.g. "1234567890 read 0x00 7 0: 12 34 ..."
+        void Print(std::ostream& out, const Record& record);
+    } //namespace trace
+} //namespace rtc
+
+#if defined(RTC_TRACE)
+
+#define RTC_TRACE_REGISTERS(type, reg, data, count, result) \
+    do \
+    { \
+        if (rtc::trace::Sample()) \
+        { \
+            rtc::trace::Emit(rtc::trace::Event::type, reg, data, count, result); \
+        } \
+    } while (0)
+
+#else
+
+#define RTC_TRACE_REGISTERS(type, reg, data, count, result) \
+    do \
+    { \
+    } while (0)
+
+#endif
+
+#endif // RTCTRACE_H
@@ -166,14 +166,114 @@ static void I2C_delay(wfRx_t *w)
 	myGpioDelay(w->I.delay);
 }
 
+/* clock stretching, see bbI2CGetStretch -------------------------------- */
+
+#define BB_I2C_STRETCH_TIMEOUT 10000
+
+/* shorter waits are the SCL rise time or tick rounding */
+#define BB_I2C_STRETCH_MIN 2
+
+/* clean bbI2CZip calls before a device is sped up */
+#define BB_I2C_SPEEDUP 16
+
+#define BB_I2C_MAX_DELAY (500000 / PI_BB_I2C_MIN_BAUD)
+
+typedef struct
+{
+	bbI2CStretch_t s;
+	uint32_t       clean; /* calls since the last back off */
+} bbI2CDevice_t;
+
+/* per SDA gpio, indexed by address */
+static bbI2CDevice_t *bbI2CDevices[PI_MAX_USER_GPIO + 1];
+
 static void I2C_clock_stretch(wfRx_t *w)
 {
-	uint32_t now, max_stretch = 10000;
+	uint32_t now, waited, step;
+	bbI2CDevice_t *d;
 
 	myGpioSetMode(w->I.SCL, PI_INPUT);
 	now = gpioTick();
-	while ((gpioRead(w->I.SCL) == 0) && ((gpioTick() - now) < max_stretch))
-		;
+	waited = 0;
+
+	while (gpioRead(w->I.SCL) == 0)
+	{
+		waited = gpioTick() - now;
+
+		if (waited >= BB_I2C_STRETCH_TIMEOUT)
+		{
+			w->I.timeouts++;
+			break;
+		}
+
+		/* spin for a few bits, then wait a quarter of the time so far
+		   between polls, which sleeps once that is long */
+		step = waited / 4;
+		if (step > w->I.delay) myGpioDelay(step);
+	}
+
+	w->I.bits++;
+
+	if (waited >= BB_I2C_STRETCH_MIN)
+	{
+		w->I.stretches++;
+
+		d = &bbI2CDevices[w->gpio][w->I.addr];
+
+		d->s.stretches++;
+		d->s.totalMicros += waited;
+		if (waited > d->s.maxMicros) d->s.maxMicros = waited;
+	}
+}
+
+/* starts counting for addr and switches to its bit timing */
+static void stretchBegin(wfRx_t *w, int addr)
+{
+	bbI2CDevice_t *d = &bbI2CDevices[w->gpio][addr & PI_MAX_I2C_ADDR];
+
+	if (!d->s.delay)
+		d->s.delay = 500000 / w->baud;
+
+	w->I.addr = addr & PI_MAX_I2C_ADDR;
+	w->I.delay = d->s.delay;
+	w->I.bits = 0;
+	w->I.stretches = 0;
+	w->I.timeouts = 0;
+}
+
+/* backs off or speeds up the device counted since stretchBegin */
+static void stretchEnd(wfRx_t *w)
+{
+	bbI2CDevice_t *d = &bbI2CDevices[w->gpio][w->I.addr];
+	uint32_t delay = d->s.delay;
+
+	if (!w->I.bits)
+		return;
+
+	d->s.transfers++;
+	d->s.bits += w->I.bits;
+	d->s.timeouts += w->I.timeouts;
+
+	if (w->I.timeouts)
+	{
+		delay *= 2;
+		d->clean = 0;
+	}
+	else if ((w->I.stretches * 9) > w->I.bits)
+	{
+		delay += 1;
+		d->clean = 0;
+	}
+	else if (++d->clean >= BB_I2C_SPEEDUP)
+	{
+		if (delay > (500000 / w->baud)) delay -= 1;
+		d->clean = 0;
+	}
+
+	if (delay > BB_I2C_MAX_DELAY)
+		delay = BB_I2C_MAX_DELAY;
+
+	d->s.delay = delay;
 }
 
 static void I2CStart(wfRx_t *w)
@@ -262,6 +362,375 @@ static uint8_t I2CGetByte(wfRx_t *w, int nack)
 	return byte;
 }
 
+/* ----------------------------------------------------------------------- */
+
+/*
+In wave mode bbI2CZip compiles its commands into pulses and runs them as
+one shot DMA waves rather than driving the gpios from the CPU.  The lines
+stay open drain, their output levels are 0 and the wave switches each
+between input (released) and output (pulled low) with WAVE_FLAG_FSEL
+pulses.  SDA is sampled into the wave's level buffer at the end of each
+SCL high and the acks and read data are picked up when the wave is done.
+
+The waves have microsecond resolution.  SCL is high for the bbI2COpen
+half bit and low for at least 2 micros (fast mode needs 1.3), so the
+fastest clock is 333k.  Clock stretching is not seen during a wave, and a
+nack is only known once the wave is done, by when the commands compiled
+after it have run too.  The wave machinery is taken over while a wave
+runs, it can't be shared with other waveform users.
+*/
+
+#define BB_I2C_WAVE_PULSES 2048
+
+/* room for a start, stop or one byte, 9 bits of at most 4 pulses */
+#define BB_I2C_WAVE_STEP 40
+
+#define BB_I2C_WAVE_MIN_LOW 2
+
+/* micros between polls once the wave should be done */
+#define BB_I2C_WAVE_POLL 5
+
+/* what a SDA sample is for, read data samples hold the outBuf index */
+#define BB_I2C_SAMPLE_NONE       -1
+#define BB_I2C_SAMPLE_READ_ADDR  -2
+#define BB_I2C_SAMPLE_WRITE_ADDR -3
+#define BB_I2C_SAMPLE_WRITE_DATA -4
+
+typedef struct
+{
+	int       sda;     /* line levels, 1 released */
+	int       scl;
+	int       low;     /* micros */
+	int       high;    /* micros */
+	uint32_t  fsel[6]; /* function select words with SDA and SCL as inputs */
+	uint32_t  micros;
+	int       pulses;
+	int       samples;
+	rawWave_t pulse[BB_I2C_WAVE_PULSES];
+	int       sample[BB_I2C_WAVE_PULSES];
+} bbI2CWave_t;
+
+static bbI2CWave_t bbI2CWave;
+
+static uint32_t waveFselBase(wfRx_t *w, int reg)
+{
+	int gpio;
+	uint32_t word = 0;
+
+	for (gpio = reg * 10; (gpio < (reg + 1) * 10) && (gpio <= PI_MAX_GPIO); gpio++)
+	{
+		if ((gpio != w->I.SDA) && (gpio != w->I.SCL))
+			word |= gpioGetMode(gpio) << ((gpio % 10) * 3);
+	}
+
+	return word;
+}
+
+static uint32_t waveFsel(wfRx_t *w, bbI2CWave_t *v, int reg)
+{
+	uint32_t word = v->fsel[reg];
+
+	if (((w->I.SDA / 10) == reg) && !v->sda)
+		word |= PI_OUTPUT << ((w->I.SDA % 10) * 3);
+
+	if (((w->I.SCL / 10) == reg) && !v->scl)
+		word |= PI_OUTPUT << ((w->I.SCL % 10) * 3);
+
+	return word;
+}
+
+static void waveBegin(wfRx_t *w, bbI2CWave_t *v)
+{
+	v->sda = (gpioGetMode(w->I.SDA) == PI_INPUT);
+	v->scl = (gpioGetMode(w->I.SCL) == PI_INPUT);
+
+	/* the wave can't see stretching, it keeps the bbI2COpen timing */
+	v->high = 500000 / w->baud;
+	v->low = v->high;
+
+	if (v->low < BB_I2C_WAVE_MIN_LOW)
+		v->low = BB_I2C_WAVE_MIN_LOW;
+
+	v->fsel[w->I.SDA / 10] = waveFselBase(w, w->I.SDA / 10);
+	v->fsel[w->I.SCL / 10] = waveFselBase(w, w->I.SCL / 10);
+
+	v->micros = 0;
+	v->pulses = 0;
+	v->samples = 0;
+}
+
+static void waveAdd(
+	bbI2CWave_t *v, uint32_t on, uint32_t off, uint32_t flags, uint32_t delay)
+{
+	rawWave_t *p = &v->pulse[v->pulses++];
+
+	p->gpioOn = on;
+	p->gpioOff = off;
+	p->flags = flags;
+	p->usDelay = delay;
+
+	v->micros += delay;
+}
+
+static void waveDelay(bbI2CWave_t *v, uint32_t delay)
+{
+	if (!delay)
+		return;
+
+	if (v->pulses)
+	{
+		v->pulse[v->pulses - 1].usDelay += delay;
+		v->micros += delay;
+	}
+	else
+		waveAdd(v, 0, 0, 0, delay);
+}
+
+static void waveSDA(wfRx_t *w, bbI2CWave_t *v, int level, uint32_t delay)
+{
+	if (level != v->sda)
+	{
+		v->sda = level;
+		waveAdd(v,
+			w->I.SDA / 10,
+			waveFsel(w, v, w->I.SDA / 10),
+			WAVE_FLAG_FSEL,
+			delay);
+	}
+	else
+		waveDelay(v, delay);
+}
+
+static void waveSCL(wfRx_t *w, bbI2CWave_t *v, int level, uint32_t delay)
+{
+	if (level != v->scl)
+	{
+		v->scl = level;
+		waveAdd(v,
+			w->I.SCL / 10,
+			waveFsel(w, v, w->I.SCL / 10),
+			WAVE_FLAG_FSEL,
+			delay);
+	}
+	else
+		waveDelay(v, delay);
+}
+
+static void waveStart(wfRx_t *w, bbI2CWave_t *v)
+{
+	if (w->I.started)
+	{
+		waveSDA(w, v, 1, v->low);
+		waveSCL(w, v, 1, v->high);
+	}
+
+	waveSDA(w, v, 0, v->high);
+	waveSCL(w, v, 0, 0);
+
+	w->I.started = 1;
+}
+
+static void waveStop(wfRx_t *w, bbI2CWave_t *v)
+{
+	waveSDA(w, v, 0, v->low);
+	waveSCL(w, v, 1, v->high);
+	waveSDA(w, v, 1, v->low);
+
+	w->I.started = 0;
+}
+
+static void wavePutBit(wfRx_t *w, bbI2CWave_t *v, int bit)
+{
+	waveSDA(w, v, bit ? 1 : 0, v->low);
+	waveSCL(w, v, 1, v->high);
+	waveSCL(w, v, 0, 0);
+}
+
+static void waveGetBit(wfRx_t *w, bbI2CWave_t *v, int target)
+{
+	waveSDA(w, v, 1, v->low); /* let SDA float */
+	waveSCL(w, v, 1, v->high);
+
+	v->sample[v->samples++] = target;
+	waveAdd(v, 0, 0, WAVE_FLAG_READ, 0);
+
+	waveSCL(w, v, 0, 0);
+}
+
+static void wavePutByte(wfRx_t *w, bbI2CWave_t *v, int byte, int target)
+{
+	int bit;
+
+	for (bit = 0; bit < 8; bit++)
+	{
+		wavePutBit(w, v, byte & 0x80);
+		byte <<= 1;
+	}
+
+	waveGetBit(w, v, target);
+}
+
+static void waveGetByte(wfRx_t *w, bbI2CWave_t *v, char *outBuf, int pos, int nack)
+{
+	int bit;
+
+	outBuf[pos] = 0;
+
+	for (bit = 0; bit < 8; bit++)
+	{
+		waveGetBit(w, v, pos);
+	}
+
+	wavePutBit(w, v, nack);
+}
+
+static int waveFlush(wfRx_t *w, bbI2CWave_t *v, char *outBuf)
+{
+	int i, wid, bit, target, status;
+	rawWaveInfo_t info;
+
+	if (!v->pulses)
+		return 0;
+
+	gpioWaveAddNew();
+
+	status = rawWaveAddGeneric(v->pulses, v->pulse);
+
+	if (status >= 0)
+		status = wid = gpioWaveCreate();
+
+	if (status >= 0)
+	{
+		/* a line is pulled low by making it an output */
+		myGpioWrite(w->I.SDA, 0);
+		myGpioWrite(w->I.SCL, 0);
+
+		status = gpioWaveTxSend(wid, PI_WAVE_MODE_ONE_SHOT);
+
+		if (status >= 0)
+		{
+			status = 0;
+
+			/* sleeps rather than spins for all but short waves */
+			myGpioDelay(v->micros);
+
+			while (gpioWaveTxBusy())
+				myGpioDelay(BB_I2C_WAVE_POLL);
+
+			/* the levels are stored downwards from the top of the wave's OOL */
+			info = rawWaveInfo(wid);
+
+			for (i = 0; i < v->samples; i++)
+			{
+				bit = (rawWaveGetOut(info.topOOL - 1 - i) >> w->I.SDA) & 1;
+				target = v->sample[i];
+
+				if (target >= 0)
+					outBuf[target] = (outBuf[target] << 1) | bit;
+				else if (bit && !status)
+				{
+					if (target == BB_I2C_SAMPLE_READ_ADDR)
+						status = PI_I2C_READ_FAILED;
+					else if (target != BB_I2C_SAMPLE_NONE)
+						status = PI_I2C_WRITE_FAILED;
+				}
+			}
+		}
+
+		gpioWaveDelete(wid);
+	}
+
+	v->micros = 0;
+	v->pulses = 0;
+	v->samples = 0;
+
+	return status;
+}
+
+/* runs what has been compiled when there is no room for another step */
+static int waveRoom(wfRx_t *w, bbI2CWave_t *v, char *outBuf)
+{
+	if ((v->pulses + BB_I2C_WAVE_STEP) > BB_I2C_WAVE_PULSES)
+		return waveFlush(w, v, outBuf);
+
+	return 0;
+}
+
+static int waveRead(
+	wfRx_t *w,
+	bbI2CWave_t *v,
+	int addr,
+	int bytes,
+	char *outBuf,
+	int *outPos,
+	unsigned outLen)
+{
+	int i, status;
+
+	if (bytes < 0)
+		return PI_BAD_I2C_CMD;
+
+	status = waveRoom(w, v, outBuf);
+	if (status) return status;
+
+	wavePutByte(w, v, (addr << 1) | 1, BB_I2C_SAMPLE_READ_ADDR);
+
+	if (!bytes)
+		return PI_BAD_I2C_CMD;
+
+	if ((bytes + *outPos) >= outLen)
+		return PI_BAD_I2C_RLEN;
+
+	for (i = 0; i < bytes; i++)
+	{
+		status = waveRoom(w, v, outBuf);
+		if (status) return status;
+
+		waveGetByte(w, v, outBuf, (*outPos)++, i == (bytes - 1));
+	}
+
+	return 0;
+}
+
+static int waveWrite(
+	wfRx_t *w,
+	bbI2CWave_t *v,
+	int addr,
+	int bytes,
+	char *inBuf,
+	int *inPos,
+	unsigned inLen,
+	char *outBuf)
+{
+	int i, status;
+
+	if (bytes < 0)
+		return PI_BAD_I2C_CMD;
+
+	status = waveRoom(w, v, outBuf);
+	if (status) return status;
+
+	wavePutByte(w, v, addr << 1, BB_I2C_SAMPLE_WRITE_ADDR);
+
+	if (!bytes)
+		return PI_BAD_I2C_CMD;
+
+	if ((bytes + *inPos) >= inLen)
+		return PI_BAD_I2C_RLEN;
+
+	for (i = 0; i < bytes; i++)
+	{
+		status = waveRoom(w, v, outBuf);
+		if (status) return status;
+
+		/* like bit banging, the last byte's ack isn't checked */
+		wavePutByte(w, v, inBuf[(*inPos)++],
+			(i < (bytes - 1)) ? BB_I2C_SAMPLE_WRITE_DATA : BB_I2C_SAMPLE_NONE);
+	}
+
+	return 0;
+}
+
 int bbI2COpen(unsigned SDA, unsigned SCL, unsigned baud)
 {
 	DBG(DBG_USER, "SDA=%d SCL=%d baud=%d", SDA, SCL, baud);
@@ -286,11 +755,18 @@ int bbI2COpen(unsigned SDA, unsigned SCL, unsigned baud)
 	if ((wfRx[SCL].mode != PI_WFRX_NONE)  || (SCL == SDA))
 		SOFT_ERROR(PI_GPIO_IN_USE, "gpio %d is already being used", SCL);
 
+	bbI2CDevices[SDA] = calloc(PI_MAX_I2C_ADDR + 1, sizeof(bbI2CDevice_t));
+
+	if (!bbI2CDevices[SDA])
+		SOFT_ERROR(PI_NO_MEMORY, "SDA %d, can't allocate stretch counts", SDA);
+
 	wfRx[SDA].gpio = SDA;
 	wfRx[SDA].mode = PI_WFRX_I2C;
 	wfRx[SDA].baud = baud;
 
 	wfRx[SDA].I.started = 0;
+	wfRx[SDA].I.wave = 0;
+	wfRx[SDA].I.addr = 0;
 	wfRx[SDA].I.SDA = SDA;
 	wfRx[SDA].I.SCL = SCL;
 	wfRx[SDA].I.delay = 500000 / baud;
@@ -329,6 +805,9 @@ int bbI2CClose(unsigned SDA)
 		wfRx[wfRx[SDA].I.SDA].mode = PI_WFRX_NONE;
 		wfRx[wfRx[SDA].I.SCL].mode = PI_WFRX_NONE;
 
+		free(bbI2CDevices[SDA]);
+		bbI2CDevices[SDA] = NULL;
+
 		break;
 
 	default:
@@ -344,6 +823,53 @@ int bbI2CClose(unsigned SDA)
 
 /*-------------------------------------------------------------------------*/
 
+int bbI2CGetStretch(unsigned SDA, unsigned addr, bbI2CStretch_t *stretch)
+{
+	DBG(DBG_USER, "SDA=%d addr=%d", SDA, addr);
+
+	CHECK_INITED;
+
+	if (SDA > PI_MAX_USER_GPIO)
+		SOFT_ERROR(PI_BAD_USER_GPIO, "bad gpio (%d)", SDA);
+
+	if (wfRx[SDA].mode != PI_WFRX_I2C)
+		SOFT_ERROR(PI_NOT_I2C_GPIO, "no I2C on gpio (%d)", SDA);
+
+	if (addr > PI_MAX_I2C_ADDR)
+		SOFT_ERROR(PI_BAD_I2C_ADDR, "bad I2C address (%d)", addr);
+
+	if (!stretch)
+		SOFT_ERROR(PI_BAD_POINTER, "stretch can't be NULL");
+
+	*stretch = bbI2CDevices[SDA][addr].s;
+
+	if (!stretch->delay)
+		stretch->delay = 500000 / wfRx[SDA].baud;
+
+	return 0;
+}
+
+/*-------------------------------------------------------------------------*/
+
+int bbI2CSetWave(unsigned SDA, unsigned wave)
+{
+	DBG(DBG_USER, "SDA=%d wave=%d", SDA, wave);
+
+	CHECK_INITED;
+
+	if (SDA > PI_MAX_USER_GPIO)
+		SOFT_ERROR(PI_BAD_USER_GPIO, "bad gpio (%d)", SDA);
+
+	if (wfRx[SDA].mode != PI_WFRX_I2C)
+		SOFT_ERROR(PI_NOT_I2C_GPIO, "no I2C on gpio (%d)", SDA);
+
+	wfRx[SDA].I.wave = wave ? 1 : 0;
+
+	return 0;
+}
+
+/*-------------------------------------------------------------------------*/
+
 int bbI2CZip(
    unsigned SDA,
 	char *inBuf,
@@ -354,6 +880,7 @@ int bbI2CZip(
 	int i, ack, inPos, outPos, status, bytes;
 	int addr, flags, esc, setesc;
 	wfRx_t *w;
+	bbI2CWave_t *v;
 
 	DBG(DBG_USER,
 		"gpio=%d inBuf=%s outBuf=%08X len=%d",
@@ -378,6 +905,16 @@ int bbI2CZip(
 
 	w = &wfRx[SDA];
 
+	v = NULL;
+
+	if (w->I.wave)
+	{
+		v = &bbI2CWave;
+		waveBegin(w, v);
+	}
+
+	stretchBegin(w, 0);
+
 	inPos = 0;
 	outPos = 0;
 	status = 0;
@@ -405,16 +942,33 @@ int bbI2CZip(
 			break;
 
 		case PI_I2C_START:
-			I2CStart(w);
+			if (v)
+			{
+				status = waveRoom(w, v, outBuf);
+				if (!status) waveStart(w, v);
+			}
+			else
+				I2CStart(w);
 			break;
 
 		case PI_I2C_STOP:
-			I2CStop(w);
+			if (v)
+			{
+				status = waveRoom(w, v, outBuf);
+				if (!status) waveStop(w, v);
+			}
+			else
+				I2CStop(w);
 			break;
 
 		case PI_I2C_ADDR:
 			addr = myI2CGetPar(inBuf, &inPos, inLen, &esc);
 			if (addr < 0) status = PI_BAD_I2C_CMD;
+			else
+			{
+				stretchEnd(w);
+				stretchBegin(w, addr);
+			}
 			break;
 
 		case PI_I2C_FLAGS:
@@ -432,6 +986,12 @@ int bbI2CZip(
 
 			bytes = myI2CGetPar(inBuf, &inPos, inLen, &esc);
 
+			if (v)
+			{
+				status = waveRead(w, v, addr, bytes, outBuf, &outPos, outLen);
+				break;
+			}
+
 			if (bytes >= 0)
 				ack = I2CPutByte(w, (addr << 1) | 1);
 
@@ -461,6 +1021,12 @@ int bbI2CZip(
 
 			bytes = myI2CGetPar(inBuf, &inPos, inLen, &esc);
 
+			if (v)
+			{
+				status = waveWrite(w, v, addr, bytes, inBuf, &inPos, inLen, outBuf);
+				break;
+			}
+
 			if (bytes >= 0)
 				ack = I2CPutByte(w, addr << 1);
 
@@ -499,6 +1065,15 @@ int bbI2CZip(
 		setesc = 0;
 	}
 
+	/* the commands before a bad one still go out, as when bit banging */
+	if (v)
+	{
+		i = waveFlush(w, v, outBuf);
+		if ((status >= 0) && (i < 0)) status = i;
+	}
+
+	stretchEnd(w);
+
 	if (status >= 0) 
 		status = outPos;
 
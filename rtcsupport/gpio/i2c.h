@@ -44,6 +44,19 @@ typedef struct
    uint8_t  *buf;  /* pointer to msg data */
 } pi_i2c_msg_t;
 
+/* bit banged clock stretching by one device, see bbI2CGetStretch */
+
+typedef struct
+{
+   uint32_t delay;       /* micros per half bit now used */
+   uint32_t transfers;
+   uint32_t bits;
+   uint32_t stretches;   /* bits the device held SCL low for */
+   uint32_t timeouts;    /* stretches given up on */
+   uint32_t totalMicros; /* time SCL was held low */
+   uint32_t maxMicros;
+} bbI2CStretch_t;
+
 /*F*/
 int i2cOpen(unsigned i2cBus, unsigned i2cAddr, unsigned i2cFlags);
 /*D
@@ -557,6 +570,60 @@ SDA: 0-31, the SDA gpio used in a prior call to [*bbI2COpen*]
 Returns 0 if OK, otherwise PI_BAD_USER_GPIO, or PI_NOT_I2C_GPIO.
 D*/
 
+/*F*/
+int bbI2CGetStretch(unsigned SDA, unsigned addr, bbI2CStretch_t *stretch);
+/*D
+This function gets the clock stretching seen from a device on a pair
+of gpios previously opened with [*bbI2COpen*], and the bit timing now
+used for it.
+
+. .
+    SDA: 0-31, the SDA gpio used in a prior call to [*bbI2COpen*]
+   addr: 0x00-0x7F
+stretch: pointer to the statistics
+. .
+
+Returns 0 if OK, otherwise PI_BAD_USER_GPIO, PI_NOT_I2C_GPIO,
+PI_BAD_I2C_ADDR, or PI_BAD_POINTER.
+
+Each device starts at the [*bbI2COpen*] baud.  A device which stretches
+the clock more than once a byte during a [*bbI2CZip*] call can't keep
+up, and its half bit is made a microsecond longer.  A stretch of more
+than 10 milliseconds is given up on and doubles it.  After 16 calls
+without either the half bit is made a microsecond shorter again, down
+to the [*bbI2COpen*] baud.  Stretching once a byte, usually before the
+ack, is the device's processing time and leaves the rate alone.
+
+The statistics are cleared by [*bbI2CClose*].
+D*/
+
+/*F*/
+int bbI2CSetWave(unsigned SDA, unsigned wave);
+/*D
+This function selects how [*bbI2CZip*] drives a pair of gpios
+previously opened with [*bbI2COpen*].
+
+. .
+ SDA: 0-31, the SDA gpio used in a prior call to [*bbI2COpen*]
+wave: 0 bit bangs from the CPU, 1 runs the transfers as DMA waves
+. .
+
+Returns 0 if OK, otherwise PI_BAD_USER_GPIO, or PI_NOT_I2C_GPIO.
+
+With waves the commands are compiled into waveforms of up to about 50
+bytes each and the timing no longer depends on the CPU.  The clock has
+microsecond resolution with a low of at least 2 microseconds, so the
+fastest rate is 333k.
+
+NOTE:
+
+Clock stretching is not supported with waves, and a nack is only seen
+after the waveform holding it has been sent.  The waveform functions
+can't be used by anything else while a transfer runs, and the gpios
+which share a function select register with SDA or SCL (gpios 0-9,
+10-19, and so on) must not change mode during one.
+D*/
+
 /*F*/
 int bbI2CZip(
    unsigned SDA,
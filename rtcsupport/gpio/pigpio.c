@@ -1732,8 +1732,12 @@ static void waveCBsOOLs(int *numCBs, int *numBOOLs, int *numTOOLs)
 
    for (i=0; i<numWaves; i++)
    {
-      if (waves[i].gpioOn)                 {numCB++; numBOOL++;}
-      if (waves[i].gpioOff)                {numCB++; numBOOL++;}
+      if (waves[i].flags & WAVE_FLAG_FSEL) {numCB++; numBOOL++;}
+      else
+      {
+         if (waves[i].gpioOn)              {numCB++; numBOOL++;}
+         if (waves[i].gpioOff)             {numCB++; numBOOL++;}
+      }
       if (waves[i].flags & WAVE_FLAG_READ) {numCB++; numTOOL++;}
       if (waves[i].flags & WAVE_FLAG_TICK) {numCB++; numTOOL++;}
       if (waves[i].usDelay)                {numCB++;           }
@@ -1790,7 +1794,19 @@ static int wave2Cbs(unsigned wave_mode, int *CB, int *BOOL, int *TOOL)
 
    for (i=0; i<numWaves; i++)
    {
-      if (waves[i].gpioOn)
+      if (waves[i].flags & WAVE_FLAG_FSEL)
+      {
+         waveSetOOL(botOOL, waves[i].gpioOff);
+
+         p = rawWaveCBAdr(botCB++);
+
+         p->info   = NORMAL_DMA;
+         p->src    = waveOOLPOadr(botOOL++);
+         p->dst    = ((GPIO_BASE + ((GPFSEL0+waves[i].gpioOn)*4)) & 0x00ffffff) | PI_PERI_BUS;
+         p->length = 4;
+         p->next   = waveCbPOadr(botCB);
+      }
+      else if (waves[i].gpioOn)
       {
          waveSetOOL(botOOL, waves[i].gpioOn);
 
@@ -1803,7 +1819,7 @@ static int wave2Cbs(unsigned wave_mode, int *CB, int *BOOL, int *TOOL)
          p->next   = waveCbPOadr(botCB);
       }
 
-      if (waves[i].gpioOff)
+      if (waves[i].gpioOff && !(waves[i].flags & WAVE_FLAG_FSEL))
       {
          waveSetOOL(botOOL, waves[i].gpioOff);
 
@@ -2050,9 +2066,13 @@ int rawWaveAddGeneric(unsigned numIn1, rawWave_t *in1)
 
       cbs++; /* one cb for delay */
 
-      if (out[outPos].gpioOn) cbs++; /* one cb if gpio on */
+      if (out[outPos].flags & WAVE_FLAG_FSEL) cbs++; /* one cb if mode */
+      else
+      {
+         if (out[outPos].gpioOn) cbs++; /* one cb if gpio on */
 
-      if (out[outPos].gpioOff) cbs++; /* one cb if gpio off */
+         if (out[outPos].gpioOff) cbs++; /* one cb if gpio off */
+      }
 
       if (out[outPos].flags & WAVE_FLAG_READ)
       {
@@ -385,6 +385,17 @@ typedef struct
 
 #define WAVE_FLAG_READ  1
 #define WAVE_FLAG_TICK  2
+#define WAVE_FLAG_FSEL  4
+
+/*
+With WAVE_FLAG_FSEL set, gpioOn is a function select register (0-5) and
+gpioOff is the word written to it, rather than gpios to set and clear.
+This lets a wave switch gpios between input and output, e.g. to drive an
+open drain line.  The other gpios in the register are written too.
+
+Pulses with WAVE_FLAG_FSEL can't be merged into a waveform which already
+has pulses, start a new one with gpioWaveAddNew.
+*/
 
 typedef struct
 {
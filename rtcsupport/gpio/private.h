@@ -146,6 +146,11 @@ typedef struct
 	int SDAMode;
 	int SCLMode;
 	int started;
+	int wave; /* transfers run as DMA waves, see bbI2CSetWave */
+	int addr; /* device the counts below are for */
+	int bits;
+	int stretches;
+	int timeouts;
 } wfRxI2C_t;
 
 typedef struct
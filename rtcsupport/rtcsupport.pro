@@ -6,12 +6,23 @@ CONFIG -= lib_bundle
 CONFIG -= qt
 CONFIG += staticlib
 
+#DS3231AsyncClock and RtcEventLoop need C++20 coroutines and are left
+#out of the default C++11 build. Enable with: qmake CONFIG+=coroutines
+coroutines {
+    CONFIG -= c++11
+    CONFIG += c++2a
+
+    #gcc 10 does not turn coroutines on with the language level
+    *g++*: QMAKE_CXXFLAGS += -fcoroutines
+}
+
 VERSION=
 
 include(../common.pri)
 
 SOURCES += \
     I2CBuffer.cpp \
+    I2CBufferPool.cpp \
     IoBuffer.cpp \
     DS3231RealTimeClock.cpp \
     gpio/i2c.c \
@@ -24,27 +35,73 @@ SOURCES += \
     I2CGpioSoftwareBus.cpp \
     I2CGpioBus.cpp \
     RegisterSet.cpp \
-    RtcDebugger.cpp
+    RtcDebugger.cpp \
+    I2CBus.cpp \
+    CachedRealTimeClock.cpp \
+    GpioEdgeSource.cpp \
+    RtcAlarmMonitor.cpp \
+    RtcManager.cpp \
+    DS3231Simulator.cpp \
+    I2CSimulatedBus.cpp \
+    I2CDevice.cpp \
+    I2CSimulatedDevice.cpp \
+    I2CProfilingDevice.cpp \
+    I2CLatencyHistogram.cpp \
+    I2CBusScheduler.cpp \
+    I2CInstrumentedBus.cpp \
+    I2CAsyncBus.cpp \
+    RtcEventLoop.cpp \
+    DS3231AsyncClock.cpp \
+    RtcTrace.cpp \
+    RtcLog.cpp
 
 HEADERS += \
     I2CBuffer.h \
+    I2CBufferPool.h \
+    I2CZipFrame.h \
     I2CBus.h \
+    I2CTransaction.h \
+    I2CSpan.h \
+    I2CRing.h \
+    I2CAsyncBus.h \
+    RtcTask.h \
+    RtcEventLoop.h \
+    RtcTrace.h \
+    RtcLog.h \
     IoBuffer.h \
     RealTimeClock.h \
     RealTimeClockPrivate.h \
     RtcAlarm.h \
     RtcTime.h \
+    RtcTimestamp.h \
     DS3231RealTimeClock.h \
+    CachedRealTimeClock.h \
+    RtcEdgeSource.h \
+    GpioEdgeSource.h \
+    RtcAlarmMonitor.h \
+    RtcManager.h \
     DS3231RegisterSet.h \
+    DS3231RegisterCache.h \
     DS3231Registers.h \
+    BcdCodec.h \
+    DS3231TimeCodec.h \
+    DS3231AsyncClock.h \
     gpio/pierrors.h \
     gpio/pigpio.h \
     gpio/private.h \
     I2CSmbus.h \
+    I2CDevice.h \
+    I2CSimulatedDevice.h \
+    I2CProfilingDevice.h \
+    I2CLatencyHistogram.h \
+    I2CBusScheduler.h \
+    I2CInstrumentedBus.h \
     gpio/i2c.h \
     I2CGpioHardwareBus.h \
     I2CGpioSoftwareBus.h \
     I2CGpioBus.h \
+    I2CSimulatedBus.h \
+    DS3231Simulator.h \
     IoError.h \
     LogSupport.h \
     LocalTypes.h \
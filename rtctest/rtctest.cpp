@@ -4,9 +4,22 @@
 #include <glog/logging.h>
 #include <RealTimeClockPrivate.h>
 #include <RtcDebugger.h>
-#include <boost/date_time/local_time/local_time.hpp>
-#include <boost/date_time/posix_time/time_parsers.hpp>
-#include <boost/date_time/posix_time/ptime.hpp>
+#include <DS3231TimeCodec.h>
+#include <RtcTimestamp.h>
+#include <RtcManager.h>
+#include <CachedRealTimeClock.h>
+#include <I2CSimulatedBus.h>
+#include <I2CSimulatedDevice.h>
+#include <I2CProfilingDevice.h>
+#include <I2CTransaction.h>
+#include <I2CAsyncBus.h>
+#include <I2CInstrumentedBus.h>
+#include <I2CBufferPool.h>
+#include <I2CBusScheduler.h>
+#include <RtcAlarmMonitor.h>
+#include <DS3231AsyncClock.h>
+#include <RtcTrace.h>
+#include <RtcLog.h>
 
 #include <sys/ioctl.h>
 #include <errno.h>
@@ -16,89 +29,80 @@
 #include <unistd.h>
 #include <linux/i2c-dev.h>
 #include <fcntl.h>
+#include <algorithm>
+#include <chrono>
+#include <sstream>
+#include <iomanip>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 #include <LocalTypes.h>
 
-using namespace std;
+//not all of std, byte would clash with std::byte under C++17 and later
+using std::cout;
+using std::endl;
 using namespace rtc;
-using namespace boost::posix_time;
 
 DECLARE_string(set);
 DECLARE_bool(am);
 DECLARE_bool(pm);
 DECLARE_bool(dump);
+DECLARE_bool(bench);
+DECLARE_string(devices);
+DECLARE_int32(iobench);
+DECLARE_int32(adapter);
+DECLARE_int32(trace);
+DECLARE_bool(edges);
+DECLARE_bool(schedule);
+DECLARE_int32(sessions);
+DECLARE_bool(selftest);
 
 DEFINE_string(set, std::string(), "Set the date/time. Format YYY-MM-DD hh:mm:ss. Use -am or -pm to indicate a 12 hour clock.");
 DEFINE_bool(am, false, "Indicates a 12 hour clock, AM");
 DEFINE_bool(pm, false, "Indicates a 12 hour clock, PM");
 DEFINE_bool(dump, false, "Dump registers");
+DEFINE_bool(bench, false, "Benchmark the codec, formatting and clock stack against a simulated device");
+DEFINE_int32(iobench, 0, "Time every I2CSmbus method this many times and print a syscall latency report");
+DEFINE_int32(adapter, -1, "Adapter for --iobench, e.g. one created by i2c-stub. -1 uses an in-process stand-in");
+DEFINE_int32(trace, 0, "Trace every Nth register transfer and print the trace on exit. Needs a build with RTC_TRACE");
+DEFINE_bool(edges, false, "Check that the cached clock phase aligns to square wave edges from a simulated device");
+DEFINE_bool(schedule, false, "Check the I2CBusScheduler grant order and starvation limit against a stand-in adapter");
+DEFINE_bool(selftest, false, "Run the checks that need no hardware against simulated devices");
+DEFINE_int32(sessions, 0, "Run this many DS3231AsyncClock sessions on one event loop over simulated devices. Needs a build with CONFIG+=coroutines");
+DEFINE_string(devices, std::string(), "Read several clocks at once. Format adapter:address[,adapter:address...], e.g. 1:0x68,3:0x68");
 
 
 I2CSmbus i2cBus(1, 0x68);
 DS3231RealTimeClock rtclock(&i2cBus);
 
-RtcDateTime MakeDateTime(ptime time, Meridiem period)
+//The time is given on a 24 hour clock. With -am/-pm the hour is kept and
+//only the period is taken from the flag.
+RtcDateTime MakeDateTime(const RtcTimestamp& time, Meridiem period)
 {
-	auto d = time.time_of_day();
-	
-	auto hour = d.hours();
-	auto minute = d.minutes();
-	auto second = d.seconds();
-	auto mode = period == Meridiem::None 
-		? ClockMode::MilitaryClock
-		: ClockMode::WallClock;
-	
-	if (period != Meridiem::None)
-	{
-		if (hour == 0 && minute <= 59)
-		{
-			hour += 12;
-		}
-		else if (hour >= 13 && hour <= 23)
-		{
-			hour -= 12;
-		}
-	}
-	
-    auto doy = byte(time.date().day_of_week());
-    auto mon = byte(time.date().month());
-    auto weekDay = pvt::ToDayOfWeek(doy);
-    auto month = pvt::ToMonth(mon);
-	auto day = int(time.date().day());
-	auto year = int(time.date().year());
-	
-    printf("y: %d, m: %d, dy: %d, dt: %d, hh: %d, mm: %d, ss: %d\n",
-           year, mon, doy, day, hour, minute, second);
-
-	RtcDateTime result(RtcTime(period, hour, minute, second, mode),
-		day,
-		weekDay,
-		month,
-		year);
-	
-    printf("rtc datetime: %s\n", result.AsString().c_str());
+    auto result = time.ToDateTime();
 
-	return result;
-}
+    if (period != Meridiem::None)
+    {
+        RtcTimestamp::Normalize(result.Time, ClockMode::WallClock);
+        result.Time.Period = period;
+    }
 
-bool SetTime()
-{
-	if (FLAGS_set.empty())
-	{
-		return false;
-	}
-	
-	auto time = time_from_string(FLAGS_set);
-	if (time.is_not_a_date_time())
-	{
-		cout << "Invalid date/time format." << endl;
-		exit(1);
-	}
-	
-	return true;
+    printf("rtc datetime: %s\n", result.AsString(true).c_str());
+
+    return result;
 }
 
 void dump();
+void bench();
+int readDevices();
+int ioBench();
+int edgeCheck();
+int scheduleCheck();
+int sessionCheck();
+int selfTest();
 
 int main(int argc, char *argv[])
 {
@@ -107,6 +111,7 @@ int main(int argc, char *argv[])
 	FLAGS_log_dir = "/home/pi/clock/logs";
 	
 	google::InitGoogleLogging(argv[0]);
+    logging::SetVerbosity(FLAGS_v);
 
     if (FLAGS_dump)
     {
@@ -114,6 +119,52 @@ int main(int argc, char *argv[])
         return 0;
     }
 
+    if (FLAGS_bench)
+    {
+        bench();
+        return 0;
+    }
+
+    if (FLAGS_iobench > 0)
+    {
+        return ioBench();
+    }
+
+    if (!FLAGS_devices.empty())
+    {
+        return readDevices();
+    }
+
+    if (FLAGS_edges)
+    {
+        return edgeCheck();
+    }
+
+    if (FLAGS_schedule)
+    {
+        return scheduleCheck();
+    }
+
+    if (FLAGS_sessions > 0)
+    {
+        return sessionCheck();
+    }
+
+    if (FLAGS_selftest)
+    {
+        return selfTest();
+    }
+
+    if (FLAGS_trace > 0)
+    {
+        if (!trace::Compiled)
+        {
+            std::cout << "Tracing is not compiled in, rebuild with DEFINES += RTC_TRACE" << std::endl;
+        }
+
+        trace::SetSampling(FLAGS_trace);
+    }
+
     auto status = i2cBus.Initialize();
     if (!status)
     {
@@ -146,8 +197,8 @@ int main(int argc, char *argv[])
 	{
 		cout << "set time to: " << FLAGS_set << endl;
 		
-		auto time = time_from_string(FLAGS_set);
-		if (time.is_not_a_date_time())
+		RtcTimestamp time;
+		if (!RtcTimestamp::Parse(FLAGS_set.c_str(), time))
 		{
 			cout << "Invalid date/time format." << endl;
 		}
@@ -169,10 +220,1106 @@ int main(int argc, char *argv[])
 	}
 
 	rtclock.Shutdown();
+
+    if (FLAGS_trace > 0)
+    {
+        std::vector<trace::Record> records;
+        trace::Buffer().Snapshot(records);
+
+        for (auto& record : records)
+        {
+            trace::Print(std::cout, record);
+        }
+    }
 	
 	return 0;
 }
 
+int readDevices()
+{
+    RtcManager manager;
+
+    auto text = FLAGS_devices.c_str();
+    while (*text != '\0')
+    {
+        char* end;
+        auto adapter = int(strtol(text, &end, 0));
+        if (*end != ':')
+        {
+            cout << "Invalid device list." << endl;
+            return 1;
+        }
+
+        auto address = int(strtol(end + 1, &end, 0));
+        if (*end != ',' && *end != '\0')
+        {
+            cout << "Invalid device list." << endl;
+            return 1;
+        }
+
+        if (manager.AddDevice(adapter, address) < 0)
+        {
+            cout << "Could not open i2c-" << adapter << " address " << address << endl;
+            return 1;
+        }
+
+        text = *end == ',' ? end + 1 : end;
+    }
+
+    if (!manager.Start())
+    {
+        cout << "Could not initialize the rtc instances" << endl;
+        return 1;
+    }
+
+    RtcSnapshot snapshot;
+    auto result = manager.Snapshot(snapshot);
+
+    char buffer[RtcDateTime::FormatSize];
+
+    for (const auto& reading : snapshot.Readings)
+    {
+        if (reading.Result == Status::Ok)
+        {
+            reading.Value.FormatIso8601(buffer, sizeof(buffer));
+        }
+        else
+        {
+            snprintf(buffer, sizeof(buffer), "read failed");
+        }
+
+        printf("%d i2c-%d %s +%.3fms latency %.3fms\n",
+               reading.Device,
+               reading.Adapter,
+               buffer,
+               (reading.ReadNs - snapshot.StartNs) / 1e6,
+               reading.LatencyNs / 1e6);
+    }
+
+    manager.Stop();
+
+    return result ? 0 : 1;
+}
+
+//Writes go to the alarm 1 registers, so only point this at i2c-stub
+//or a clock whose alarms are not in use
+int ioBench()
+{
+    DS3231Simulator device(DS3231Simulator::TimeSource::RealTime);
+    I2CSimulatedDevice standIn(&device);
+    I2CDevFile file;
+
+    I2CProfilingDevice profiler(FLAGS_adapter < 0
+        ? static_cast<I2CDevice*>(&standIn)
+        : static_cast<I2CDevice*>(&file));
+
+    I2CSmbus bus(FLAGS_adapter, 0x68, &profiler);
+    if (!bus.Initialize())
+    {
+        cout << "Could not open i2c-" << FLAGS_adapter << endl;
+        return 1;
+    }
+
+    const auto alarm = byte(DS3231RegisterId::Alarm1Seconds);
+    const auto seconds = byte(DS3231RegisterId::Seconds);
+
+    byte value;
+    word wordValue;
+    byte data[I2CTransaction::MaxWriteBytes / 2] = { 0 };
+
+    auto start = std::chrono::steady_clock::now();
+
+    for (auto idx = 0; idx < FLAGS_iobench; idx++)
+    {
+        bus.Send(alarm);
+        bus.Receive(value);
+        bus.Send(alarm, byte(0));
+        bus.Receive(alarm, value);
+        bus.Send(alarm, word(0));
+        bus.Receive(alarm, wordValue);
+        bus.Send(alarm, data, 4);
+        bus.Receive(seconds, data, 7);
+
+        I2CTransaction transaction;
+        transaction.Write(alarm, data, 4);
+        transaction.Read(seconds, data, 7);
+        bus.Submit(transaction);
+    }
+
+    auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    bus.Close();
+
+    profiler.Report(cout);
+    printf("%d rounds in %.3fs\n", FLAGS_iobench, elapsed);
+
+    return 0;
+}
+
+static void SleepUntil(int64_t monotonicNs)
+{
+    auto remaining = monotonicNs - CachedRealTimeClock::MonotonicNs();
+    if (remaining > 0)
+    {
+        usleep(useconds_t(remaining / 1000));
+    }
+}
+
+//The simulated second starts when the time is set, so the true time is
+//known at every instant and the cached clock can be checked against it.
+int edgeCheck()
+{
+    const int64_t NsPerMs = 1000000LL;
+    const int64_t NsPerSecond = 1000 * NsPerMs;
+    const int64_t BoundNs = 2 * NsPerMs;
+
+    DS3231Simulator device(DS3231Simulator::TimeSource::RealTime);
+    I2CSimulatedBus simulatedBus(&device);
+    DS3231RealTimeClock simulatedClock(&simulatedBus);
+    CachedRealTimeClock cachedClock(&simulatedClock);
+
+    simulatedClock.Initialize();
+    cachedClock.Initialize();
+
+    RtcDateTime value(RtcTime(Meridiem::None, 12, 0, 0, ClockMode::MilitaryClock), 1, DayOfWeek::Mon, Months::Jan, 2024);
+    device.SetDateTime(value);
+
+    auto startNs = device.NowNs();
+    auto startEpochNs = pvt::ToEpochSeconds(value) * NsPerSecond;
+
+    auto errorNs = [&]()
+    {
+        auto cachedNs = cachedClock.GetEpochNanoseconds();
+        return cachedNs - (startEpochNs + CachedRealTimeClock::MonotonicNs() - startNs);
+    };
+
+    auto failed = false;
+    auto check = [&](const char* what, int64_t error)
+    {
+        auto ok = llabs(error) <= BoundNs;
+        printf("%-28s %9.3f ms %s\n", what, error / 1e6, ok ? "ok" : "FAILED");
+        failed = failed || !ok;
+    };
+
+    //without edges the anchor is the read, somewhere inside the second
+    SleepUntil(startNs + 400 * NsPerMs);
+    printf("%-28s %9.3f ms\n", "unaligned anchor", errorNs() / 1e6);
+
+    //an edge fired by hand, reported a little late with the right time
+    SimulatedEdgeSource edges;
+    cachedClock.AttachEdgeSource(&edges);
+
+    SleepUntil(startNs + NsPerSecond + NsPerMs);
+    edges.Fire(startNs + NsPerSecond);
+    check("simulated edge", errorNs());
+
+    //a late edge still counts as the nearest second, the extrapolation
+    //lags by the jitter until the next edge
+    SleepUntil(startNs + 2 * NsPerSecond + NsPerMs);
+    edges.Fire(startNs + 2 * NsPerSecond + NsPerMs / 2);
+    check("jittered edge", errorNs() + NsPerMs / 2);
+
+    cachedClock.DetachEdgeSource();
+
+    //the device's own 1Hz square wave, the resync lands on an edge
+    simulatedClock.SetSquareWave(SquareWaveRate::Rate1Hz);
+    cachedClock.AttachEdgeSource(&device);
+    cachedClock.Invalidate();
+
+    SleepUntil(startNs + 3 * NsPerSecond + 300 * NsPerMs);
+    check("device edge at resync", errorNs());
+
+    //edges are delivered as the device is accessed, each one re-phases
+    //the extrapolation
+    for (auto second = 4; second < 7; second++)
+    {
+        SleepUntil(startNs + second * NsPerSecond + 200 * NsPerMs);
+        device.InterruptAsserted();
+        check("device edge", errorNs());
+    }
+
+    cachedClock.DetachEdgeSource();
+
+    return failed ? 1 : 0;
+}
+
+//Stand-in adapter for the scheduler check. Each SMBus byte write is
+//recorded in the order the scheduler granted it, and the first write
+//after Hold is kept on the bus until Release so other clients queue up.
+class RecordingAdapter : public I2CDevice
+{
+    std::mutex _lock;
+    std::condition_variable _changed;
+    bool _hold;
+    bool _holding;
+    std::string _order;
+
+public:
+    RecordingAdapter() :
+        _hold(false),
+        _holding(false)
+    {
+    }
+
+    int Open(int) override
+    {
+        return 0;
+    }
+
+    void Close() override
+    {
+    }
+
+    int Ioctl(unsigned long request, void* arg) override
+    {
+        if (request != I2C_SMBUS)
+        {
+            return 0;
+        }
+
+        std::unique_lock<std::mutex> lock(_lock);
+
+        _order += char(static_cast<i2c_smbus_ioctl_data*>(arg)->command);
+
+        if (_hold && !_holding)
+        {
+            _holding = true;
+            _changed.notify_all();
+            _changed.wait(lock, [this] { return !_hold; });
+            _holding = false;
+        }
+
+        //long enough for a granted client to queue its next write
+        lock.unlock();
+        usleep(1000);
+
+        return 0;
+    }
+
+    //send from blocker and return once it holds the bus
+    void Hold(I2CSmbus& blocker, std::thread& thread)
+    {
+        {
+            std::lock_guard<std::mutex> lock(_lock);
+            _hold = true;
+        }
+
+        thread = std::thread([&blocker] { blocker.Send(byte('x')); });
+
+        std::unique_lock<std::mutex> lock(_lock);
+        _changed.wait(lock, [this] { return _holding; });
+    }
+
+    void Release()
+    {
+        std::lock_guard<std::mutex> lock(_lock);
+        _hold = false;
+        _changed.notify_all();
+    }
+
+    std::string Order()
+    {
+        std::lock_guard<std::mutex> lock(_lock);
+        return _order;
+    }
+
+    void Clear()
+    {
+        std::lock_guard<std::mutex> lock(_lock);
+        _order.clear();
+    }
+};
+
+//Clients queue behind a held transfer one at a time, so the order they
+//are granted in only depends on the scheduler.
+int scheduleCheck()
+{
+    const int StarvationLimit = 2;
+    const int QueueDelayUs = 20000;
+
+    RecordingAdapter adapter;
+    I2CBusScheduler scheduler(1, &adapter);
+
+    I2CSmbus blocker(1, 0x10, scheduler.AddClient(I2CPriority::High));
+    I2CSmbus high(1, 0x11, scheduler.AddClient(I2CPriority::High));
+    I2CSmbus otherHigh(1, 0x12, scheduler.AddClient(I2CPriority::High));
+    I2CSmbus normal(1, 0x13, scheduler.AddClient(I2CPriority::Normal));
+    I2CSmbus bulk(1, 0x14, scheduler.AddClient(I2CPriority::Bulk));
+
+    for (auto bus : { &blocker, &high, &otherHigh, &normal, &bulk })
+    {
+        if (!bus->Initialize())
+        {
+            cout << "Could not open a scheduled client" << endl;
+            return 1;
+        }
+    }
+
+    auto failed = false;
+    auto check = [&failed](const char* what, bool ok, const std::string& order)
+    {
+        printf("%-22s %-16s %s\n", what, order.c_str(), ok ? "ok" : "FAILED");
+        failed = failed || !ok;
+    };
+
+    //queued lowest class first, granted highest class first
+    std::thread held;
+    adapter.Hold(blocker, held);
+
+    std::vector<std::thread> clients;
+    for (auto client : { std::make_pair(&bulk, 'b'), std::make_pair(&normal, 'n'), std::make_pair(&high, 'h') })
+    {
+        clients.emplace_back([client] { client.first->Send(byte(client.second)); });
+        usleep(QueueDelayUs);
+    }
+
+    adapter.Release();
+
+    held.join();
+    for (auto& client : clients)
+    {
+        client.join();
+    }
+
+    check("priority order", adapter.Order() == "xhnb", adapter.Order());
+
+    //two high clients keep the bus busy, the bulk write still gets in
+    //once it has been passed over StarvationLimit times
+    const int HighWrites = 6;
+
+    scheduler.SetStarvationLimit(StarvationLimit);
+    adapter.Clear();
+
+    auto before = scheduler.Stats();
+
+    adapter.Hold(blocker, held);
+
+    clients.clear();
+    clients.emplace_back([&bulk] { bulk.Send(byte('b')); });
+    usleep(QueueDelayUs);
+
+    for (auto client : { std::make_pair(&high, 'h'), std::make_pair(&otherHigh, 'H') })
+    {
+        clients.emplace_back([client, HighWrites]
+        {
+            for (auto idx = 0; idx < HighWrites; idx++)
+            {
+                client.first->Send(byte(client.second));
+            }
+        });
+        usleep(QueueDelayUs);
+    }
+
+    adapter.Release();
+
+    held.join();
+    for (auto& client : clients)
+    {
+        client.join();
+    }
+
+    auto order = adapter.Order();
+    auto starved = scheduler.Stats().StarvationGrants - before.StarvationGrants;
+
+    check("starvation limit", order.find('b') == size_t(StarvationLimit + 1) && starved == 1, order);
+
+    return failed ? 1 : 0;
+}
+
+#if defined(RTC_COROUTINES)
+
+struct SessionResults
+{
+    int Passed;
+    int Failed;
+    int Wrong;
+};
+
+//set the clock, read it back a few times and exercise the alarms, all
+//from the event loop thread
+static RtcTask<void> ClockSession(DS3231AsyncClock& clock, int idx, float celsius, SessionResults& results)
+{
+    const int Reads = 5;
+
+    RtcDateTime set(RtcTime(Meridiem::None, idx % 24, idx % 60, 0, ClockMode::MilitaryClock),
+        idx % 28 + 1, DayOfWeek::Mon, Months::Mar, 2024);
+
+    if (co_await clock.SetDateTime(set) != Status::Ok)
+    {
+        results.Failed++;
+        co_return;
+    }
+
+    RtcDateTime value;
+    for (auto read = 0; read < Reads; read++)
+    {
+        if (co_await clock.GetDateTime(value) != Status::Ok)
+        {
+            results.Failed++;
+            co_return;
+        }
+    }
+
+    float temperature = 0;
+    RtcAlarm alarm(Meridiem::None, 0, 0, (idx + 1) % 60, 0, AlarmInterval::Seconds, DayOfWeek::None, ClockMode::MilitaryClock);
+    AlarmTriggerState state;
+
+    if (co_await clock.GetTemperature(temperature) != Status::Ok ||
+        co_await clock.SetAlarm(AlarmId::First, alarm) != Status::Ok ||
+        co_await clock.GetAlarmTriggerState(state) != Status::Ok)
+    {
+        results.Failed++;
+        co_return;
+    }
+
+    //the reads take well under a second, the minute cannot have moved
+    if (value.Year != set.Year ||
+        value.Month != set.Month ||
+        value.Day != set.Day ||
+        value.Time.Hour != set.Time.Hour ||
+        value.Time.Minute != set.Time.Minute ||
+        temperature != celsius)
+    {
+        printf("session %d read %s %.2fC\n", idx, value.AsString().c_str(), temperature);
+        results.Wrong++;
+        co_return;
+    }
+
+    results.Passed++;
+}
+
+//Every clock gets its own simulated device and bus, shared out over a
+//few adapter I/O threads. One session is handed a bus failure, which it
+//must report rather than hang or pass.
+int sessionCheck()
+{
+    const int Adapters = 4;
+    const int FailingClock = 1;
+    const float Celsius = 25.25f;
+
+    auto clockCount = FLAGS_sessions;
+
+    std::vector<std::unique_ptr<DS3231Simulator>> devices;
+    std::vector<std::unique_ptr<I2CSimulatedBus>> buses;
+    for (auto idx = 0; idx < clockCount; idx++)
+    {
+        devices.emplace_back(new DS3231Simulator(DS3231Simulator::TimeSource::RealTime));
+        devices.back()->SetTemperature(Celsius);
+        buses.emplace_back(new I2CSimulatedBus(devices.back().get(), I2CSimulatedBusOptions::Fast()));
+    }
+
+    RtcEventLoop loop;
+
+    std::vector<std::unique_ptr<I2CAsyncBus>> adapters;
+    for (auto idx = 0; idx < Adapters && idx < clockCount; idx++)
+    {
+        adapters.emplace_back(new I2CAsyncBus(buses[idx].get()));
+        loop.Attach(*adapters.back());
+        adapters.back()->Start();
+    }
+
+    std::vector<std::unique_ptr<DS3231AsyncClock>> clocks;
+    for (auto idx = 0; idx < clockCount; idx++)
+    {
+        clocks.emplace_back(new DS3231AsyncClock(loop, *adapters[idx % adapters.size()], buses[idx].get()));
+    }
+
+    auto failing = clockCount > FailingClock;
+    if (failing)
+    {
+        buses[FailingClock]->FailNext(1);
+    }
+
+    SessionResults results = { 0, 0, 0 };
+
+    auto start = std::chrono::steady_clock::now();
+
+    for (auto idx = 0; idx < clockCount; idx++)
+    {
+        loop.Spawn(ClockSession(*clocks[idx], idx, Celsius, results));
+    }
+
+    loop.Run();
+
+    auto elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    for (auto& adapter : adapters)
+    {
+        adapter->Stop();
+    }
+
+    uint64_t transfers = 0;
+    for (auto& bus : buses)
+    {
+        transfers += bus->Stats().Transfers;
+    }
+
+    printf("%d sessions on %d adapters in %.1fms, %llu transfers\n",
+           clockCount, int(adapters.size()), elapsedMs, (unsigned long long)transfers);
+    printf("passed %d, failed %d, wrong %d, unfinished %d\n",
+           results.Passed, results.Failed, results.Wrong, loop.TaskCount());
+
+    auto expectedFailures = failing ? 1 : 0;
+    auto ok = results.Passed == clockCount - expectedFailures &&
+        results.Failed == expectedFailures &&
+        results.Wrong == 0 &&
+        loop.TaskCount() == 0;
+
+    return ok ? 0 : 1;
+}
+
+#else
+
+int sessionCheck()
+{
+    std::cout << "Coroutines are not compiled in, rebuild with CONFIG+=coroutines" << std::endl;
+    return 1;
+}
+
+#endif // RTC_COROUTINES
+
+static void PrintCheck(const char* what, bool ok, const std::string& detail = std::string())
+{
+    printf("%-28s %-24s %s\n", what, detail.c_str(), ok ? "ok" : "FAILED");
+}
+
+//the clock's register traffic reaches the trace ring one record per segment
+static bool TraceCheck()
+{
+    if (!trace::Compiled)
+    {
+        PrintCheck("trace records", true, "not compiled in");
+        return true;
+    }
+
+    const int Reads = 5;
+
+    DS3231Simulator device;
+    device.SetTemperature(21.5f);
+
+    I2CSimulatedBus simulatedBus(&device);
+    DS3231RealTimeClock simulatedClock(&simulatedBus);
+    simulatedClock.Initialize();
+
+    trace::Buffer().Clear();
+    trace::SetSampling(1);
+
+    RtcDateTime value;
+    for (auto idx = 0; idx < Reads; idx++)
+    {
+        simulatedClock.GetDateTime(value);
+    }
+    simulatedClock.GetTemperature();
+
+    trace::SetSampling(FLAGS_trace > 0 ? FLAGS_trace : 0);
+
+    std::vector<trace::Record> records;
+    trace::Buffer().Snapshot(records);
+    trace::Buffer().Clear();
+
+    auto timeReads = 0;
+    auto temperatureReads = 0;
+    for (auto& record : records)
+    {
+        if (record.Type != trace::Event::RegisterRead || record.Result != int32_t(Status::Ok))
+        {
+            continue;
+        }
+
+        if (record.Register == byte(DS3231RegisterId::Seconds) && record.Count == DS3231TimeCodec::RegisterCount)
+        {
+            timeReads++;
+        }
+        else if (record.Register == byte(DS3231RegisterId::TempMsb) && record.Count == 2 &&
+                 record.Data[0] == device.Peek(DS3231RegisterId::TempMsb) &&
+                 record.Data[1] == device.Peek(DS3231RegisterId::TempLsb))
+        {
+            temperatureReads++;
+        }
+    }
+
+    auto ok = timeReads == Reads && temperatureReads == 1;
+    PrintCheck("trace records", ok, std::to_string(records.size()) + " records");
+
+    return ok;
+}
+
+//an armed alarm reaches a handler through the INT edge and Dispatch
+static bool AlarmCheck()
+{
+    const int AlarmSecond = 5;
+
+    DS3231Simulator device;
+    I2CSimulatedBus simulatedBus(&device);
+    DS3231RealTimeClock simulatedClock(&simulatedBus);
+    simulatedClock.Initialize();
+
+    simulatedClock.SetDateTime(RtcDateTime(RtcTime(Meridiem::None, 12, 0, 0, ClockMode::MilitaryClock), 1, DayOfWeek::Mon, Months::Jan, 2024));
+    simulatedClock.SetAlarm(AlarmId::First, RtcAlarm(Meridiem::None, 0, 0, AlarmSecond, 0, AlarmInterval::Seconds, DayOfWeek::None, ClockMode::MilitaryClock));
+    simulatedClock.SetAlarmInterruptState(AlarmInterruptState::On, AlarmInterruptState::Off);
+
+    std::vector<AlarmId> delivered;
+
+    RtcAlarmMonitor monitor(&simulatedClock, &device);
+    monitor.AddHandler([&delivered](AlarmId id) { delivered.push_back(id); });
+
+    //the status is checked once on start, nothing has fired yet
+    auto early = monitor.Start() ? monitor.Dispatch() : -1;
+
+    device.Advance((AlarmSecond - 1) * 1000000000LL);
+    auto before = monitor.Dispatch();
+
+    device.Advance(1000000000LL);
+    auto fired = monitor.Dispatch();
+
+    monitor.Stop();
+
+    auto ok = early == 0 && before == 0 && fired == 1 &&
+        delivered.size() == 1 && delivered[0] == AlarmId::First &&
+        !device.InterruptAsserted();
+    PrintCheck("alarm dispatch", ok, std::to_string(delivered.size()) + " delivered");
+
+    //alarm 2 fires between the status read and the write back, its flag
+    //has to survive clearing alarm 1
+    DS3231RegisterCache cache;
+    device.Poke(DS3231RegisterId::Status, DS3231RegisterMasks::StatusAlarm1Trigger);
+    cache.Fetch(&simulatedBus, DS3231RegisterId::Status);
+
+    device.Poke(DS3231RegisterId::Status, DS3231RegisterMasks::StatusAlarm1Trigger | DS3231RegisterMasks::StatusAlarm2Trigger);
+
+    auto state = DS3231RealTimeClock::TakeTriggerState(cache);
+    cache.Flush(&simulatedBus);
+
+    auto status = device.Peek(DS3231RegisterId::Status);
+    auto kept = state.FirstTriggered && !state.SecondTriggered &&
+        (status & DS3231RegisterMasks::StatusAlarm1Trigger) == 0 &&
+        (status & DS3231RegisterMasks::StatusAlarm2Trigger) != 0;
+    PrintCheck("alarm flag race", kept);
+
+    return ok && kept;
+}
+
+//Snapshot over simulated clocks: two sharing adapter 1, read in one
+//combined transfer, and one on adapter 2 behind a simulated bus
+static bool ManagerCheck()
+{
+    DS3231Simulator devices[3];
+
+    //each stands for its own open of adapter 1
+    I2CSimulatedDevice first(&devices[0], 0x68);
+    first.Attach(&devices[1], 0x69);
+    I2CSimulatedDevice second(&devices[1], 0x69);
+    second.Attach(&devices[0], 0x68);
+
+    RtcManager manager;
+    manager.AddDevice(1, 0x68, &first);
+    manager.AddDevice(1, 0x69, &second);
+
+    std::unique_ptr<I2CSimulatedBus> bus(new I2CSimulatedBus(&devices[2]));
+    std::unique_ptr<RealTimeClock> busClock(new DS3231RealTimeClock(bus.get()));
+    manager.AddDevice(2, std::move(bus), std::move(busClock));
+
+    //the hour tells the devices apart
+    for (auto idx = 0; idx < manager.DeviceCount(); idx++)
+    {
+        manager.Clock(idx)->SetDateTime(RtcDateTime(RtcTime(Meridiem::None, 10 + idx, 30, 0, ClockMode::MilitaryClock), 15, DayOfWeek::Mon, Months::Jan, 2024));
+    }
+
+    RtcSnapshot snapshot;
+    auto ok = manager.Start() && manager.Snapshot(snapshot) &&
+        snapshot.Readings.size() == 3;
+
+    for (auto idx = 0; ok && idx < 3; idx++)
+    {
+        const auto& reading = snapshot.Readings[idx];
+        ok = reading.Result == Status::Ok &&
+            reading.Device == idx &&
+            reading.Adapter == (idx < 2 ? 1 : 2) &&
+            reading.Value.Time.Hour == 10 + idx &&
+            reading.Value.Time.Minute == 30 &&
+            reading.Value.Year == 2024;
+    }
+
+    //the combined read times both devices by the same transfer
+    auto batched = ok &&
+        snapshot.Readings[0].ReadNs == snapshot.Readings[1].ReadNs &&
+        snapshot.Readings[0].LatencyNs == snapshot.Readings[1].LatencyNs;
+
+    manager.Stop();
+
+    PrintCheck("manager snapshot", ok && batched, batched ? "adapter 1 batched" : "adapter 1 not batched");
+
+    //Stop racing a stream of snapshots must release the caller, whichever
+    //side of the stop its last request lands on
+    auto released = true;
+    for (auto round = 0; round < 20 && released; round++)
+    {
+        if (!manager.Start())
+        {
+            released = false;
+            break;
+        }
+
+        std::mutex lock;
+        std::condition_variable done;
+        auto finished = false;
+
+        std::thread reader([&]
+        {
+            RtcSnapshot current;
+            while (manager.Snapshot(current))
+            {
+            }
+
+            std::lock_guard<std::mutex> guard(lock);
+            finished = true;
+            done.notify_one();
+        });
+
+        std::this_thread::sleep_for(std::chrono::microseconds(100 * round));
+        manager.Stop();
+
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            released = done.wait_for(guard, std::chrono::seconds(5), [&] { return finished; });
+        }
+
+        if (!released)
+        {
+            //the reader is stuck on the manager for good, neither can be
+            //torn down
+            PrintCheck("manager stop", false, "snapshot blocked after stop");
+            fflush(stdout);
+            _exit(1);
+        }
+
+        reader.join();
+    }
+
+    PrintCheck("manager stop", released, "snapshots released");
+
+    return ok && batched && released;
+}
+
+//a failed read reports nothing rather than the last value in the shadow
+static bool FailedReadCheck()
+{
+    DS3231Simulator device;
+    I2CSimulatedBus simulatedBus(&device);
+    DS3231RealTimeClock simulatedClock(&simulatedBus);
+    simulatedClock.Initialize();
+
+    device.Poke(DS3231RegisterId::TempMsb, 25);
+    device.Poke(DS3231RegisterId::Status, DS3231RegisterMasks::StatusAlarm1Trigger);
+
+    //fill the shadow, then fail the reads
+    auto temperature = simulatedClock.GetTemperature();
+    simulatedBus.FailNext(1);
+    auto failedTemperature = simulatedClock.GetTemperature();
+
+    simulatedBus.FailNext(1);
+    auto failedState = simulatedClock.GetAlarmTriggerState();
+    auto state = simulatedClock.GetAlarmTriggerState();
+
+    auto ok = temperature == 25 && failedTemperature == 0 &&
+        !failedState.Triggered() && state.FirstTriggered;
+    PrintCheck("failed reads", ok);
+
+    return ok;
+}
+
+//true when both buffers hold the same bytes and expected is their length
+static bool SameFrame(const I2CBuffer& frame, const I2CBuffer& built, int expected)
+{
+    return frame.WriteLength() == expected &&
+        built.WriteLength() == expected &&
+        memcmp(frame.Data(), built.Data(), expected) == 0;
+}
+
+//the template frames against the command by command encoding they
+//replaced, on both sides of the 255 byte escape
+static bool FrameCheck()
+{
+    const byte Address = 0x68;
+    const byte Register = 0x07;
+    const int MaxLength = 599;
+
+    std::vector<byte> payload(MaxLength);
+    for (auto idx = 0; idx < MaxLength; idx++)
+    {
+        payload[idx] = byte(idx * 7);
+    }
+
+    I2CBuffer frame(1024);
+    I2CBuffer built(1024);
+
+    auto mismatch = 0;
+    const char* shape = "";
+
+    for (auto length = 1; length <= MaxLength && mismatch == 0; length++)
+    {
+        frame.Reset();
+        built.Reset();
+        frame.ReadFrame(Address, length);
+        built.Address(Address);
+        built.Start();
+        built.Receive(length);
+        built.StopAndEnd();
+        if (!SameFrame(frame, built, I2CBuffer::ReadFrameLength(length)))
+        {
+            mismatch = length;
+            shape = "read";
+            break;
+        }
+
+        frame.Reset();
+        built.Reset();
+        frame.RegisterReadFrame(Address, Register, length);
+        built.Address(Address);
+        built.Start();
+        built.Send(1);
+        built.Put(Register);
+        built.Restart();
+        built.Receive(length);
+        built.StopAndEnd();
+        if (!SameFrame(frame, built, I2CBuffer::RegisterReadFrameLength(length)))
+        {
+            mismatch = length;
+            shape = "register read";
+            break;
+        }
+
+        frame.Reset();
+        built.Reset();
+        frame.WriteFrame(Address, payload.data(), length);
+        built.Address(Address);
+        built.Start();
+        built.Send(length);
+        built.Put(payload.data(), length);
+        built.StopAndEnd();
+        if (!SameFrame(frame, built, I2CBuffer::WriteFrameLength(length)))
+        {
+            mismatch = length;
+            shape = "write";
+            break;
+        }
+
+        frame.Reset();
+        built.Reset();
+        frame.RegisterWriteFrame(Address, Register, payload.data(), length);
+        built.Address(Address);
+        built.Start();
+        built.Send(length + 1);
+        built.Put(Register);
+        built.Put(payload.data(), length);
+        built.StopAndEnd();
+        if (!SameFrame(frame, built, I2CBuffer::RegisterWriteFrameLength(length)))
+        {
+            mismatch = length;
+            shape = "register write";
+        }
+    }
+
+    auto ok = mismatch == 0;
+    PrintCheck("zip frames", ok, ok
+        ? "lengths 1-" + std::to_string(MaxLength)
+        : std::string(shape) + " differs at " + std::to_string(mismatch));
+
+    return ok;
+}
+
+//exhaustion, hand back on move-assign, destruction and Release, and
+//blocks that never overlap
+static bool PoolCheck()
+{
+    const int Blocks = 4;
+
+    I2CBufferPool pool(Blocks, 100);
+    auto size = pool.BlockSize();
+
+    std::vector<I2CBufferPool::Handle> handles;
+    for (auto idx = 0; idx < Blocks; idx++)
+    {
+        handles.push_back(pool.Acquire());
+    }
+
+    auto exhausted = !pool.Acquire() && pool.Available() == 0;
+
+    //fill every block whole, then look for a block that was overwritten
+    auto acquired = true;
+    for (auto idx = 0; idx < Blocks; idx++)
+    {
+        acquired = acquired && handles[idx] && handles[idx]->Capacity() == size;
+        if (handles[idx])
+        {
+            memset(handles[idx]->Data(), idx + 1, size);
+        }
+    }
+
+    auto separate = acquired && size == 128;
+    for (auto idx = 0; separate && idx < Blocks; idx++)
+    {
+        auto data = handles[idx]->Data();
+        separate = std::count(data, data + size, byte(idx + 1)) == size;
+    }
+
+    //the target's block goes back, the source is left empty
+    handles[0] = std::move(handles[1]);
+    auto moved = handles[0] && !handles[1] && pool.Available() == 1;
+
+    handles[0].Release();
+    auto released = !handles[0] && pool.Available() == 2;
+
+    {
+        auto scoped = pool.Acquire();
+        released = released && scoped && pool.Available() == 1;
+    }
+
+    handles.clear();
+    auto destroyed = released && pool.Available() == Blocks;
+
+    //all 64 blocks of the bitmap, and nothing past it
+    I2CBufferPool full(I2CBufferPool::MaxBlocks + 1, 64);
+    std::vector<I2CBufferPool::Handle> all;
+    while (auto handle = full.Acquire())
+    {
+        all.push_back(std::move(handle));
+    }
+
+    auto bitmap = full.BlockCount() == I2CBufferPool::MaxBlocks &&
+        int(all.size()) == I2CBufferPool::MaxBlocks;
+
+    auto ok = exhausted && separate && moved && released && destroyed && bitmap;
+
+    std::string detail;
+    detail += exhausted ? "" : "exhaustion ";
+    detail += separate ? "" : "overlap ";
+    detail += moved ? "" : "move-assign ";
+    detail += destroyed ? "" : "release ";
+    detail += bitmap ? "" : "64 blocks ";
+    PrintCheck("buffer pool", ok, ok ? std::to_string(Blocks) + " blocks of " + std::to_string(size) : detail);
+
+    return ok;
+}
+
+//Forwards the plain transfers only, so span transfers take the default
+//staging path in I2CBus
+class StagingBus : public I2CBus
+{
+    I2CBus* _bus;
+
+public:
+    StagingBus(I2CBus* bus) :
+        _bus(bus)
+    {
+    }
+
+    Status Send(byte value) override { return _bus->Send(value); }
+    Status Send(byte cmd, byte value) override { return _bus->Send(cmd, value); }
+    Status Send(byte cmd, byte* data, int dataLen) override { return _bus->Send(cmd, data, dataLen); }
+    Status Send(byte cmd, word value) override { return _bus->Send(cmd, value); }
+
+    Status Receive(byte& value) override { return _bus->Receive(value); }
+    Status Receive(byte cmd, byte& value) override { return _bus->Receive(cmd, value); }
+    Status Receive(byte cmd, byte* data, int dataLen) override { return _bus->Receive(cmd, data, dataLen); }
+    Status Receive(byte cmd, word& value) override { return _bus->Receive(cmd, value); }
+};
+
+//a 3+2 span write read back whole and as 2/1/2 spans
+static bool SpanRoundTrip(const char* what, I2CBus* bus, byte seed)
+{
+    const int Length = 5;
+    auto cmd = byte(DS3231RegisterId::Alarm1Seconds);
+
+    byte written[Length];
+    for (auto idx = 0; idx < Length; idx++)
+    {
+        written[idx] = byte(seed + idx);
+    }
+
+    byte head[3] = { written[0], written[1], written[2] };
+    byte tail[2] = { written[3], written[4] };
+    I2CSpan writeSpans[] = { { head, 3 }, { tail, 2 } };
+
+    byte whole[Length] = {};
+    byte first[2] = {};
+    byte middle[1] = {};
+    byte last[2] = {};
+    I2CSpan readSpans[] = { { first, 2 }, { middle, 1 }, { last, 2 } };
+
+    auto sent = bus->Send(cmd, writeSpans, 2);
+    auto received = bus->Receive(cmd, whole, Length);
+    auto scattered = bus->Receive(cmd, readSpans, 3);
+
+    byte gathered[Length] = { first[0], first[1], middle[0], last[0], last[1] };
+
+    auto ok = sent == Status::Ok && received == Status::Ok && scattered == Status::Ok &&
+        memcmp(whole, written, Length) == 0 &&
+        memcmp(gathered, written, Length) == 0;
+
+    std::ostringstream detail;
+    detail << std::hex << std::setfill('0');
+    for (auto value : gathered)
+    {
+        detail << std::setw(2) << int(value) << ' ';
+    }
+
+    PrintCheck(what, ok, detail.str());
+
+    return ok;
+}
+
+static bool SpanCheck()
+{
+    DS3231Simulator device;
+    I2CSimulatedBus simulatedBus(&device);
+    StagingBus stagingBus(&simulatedBus);
+
+    I2CSimulatedDevice adapter(&device);
+    I2CSmbus rawBus(1, 0x68, &adapter);
+    rawBus.Initialize();
+    rawBus.SetMode(I2CSmbusMode::RawI2C);
+
+    I2CSmbus blockBus(1, 0x68, &adapter);
+    blockBus.Initialize();
+    blockBus.SetMode(I2CSmbusMode::Smbus);
+
+    //a different pattern each time, so a stale register shows up
+    auto ok = SpanRoundTrip("spans simulated bus", &simulatedBus, 0x10);
+    ok = SpanRoundTrip("spans staging", &stagingBus, 0x20) && ok;
+    ok = SpanRoundTrip("spans smbus raw", &rawBus, 0x30) && ok;
+    ok = SpanRoundTrip("spans smbus block", &blockBus, 0x40) && ok;
+
+    return ok;
+}
+
+//Checks that need no hardware and finish quickly. Each one prints its
+//own lines, the exit code is non-zero if any failed.
+int selfTest()
+{
+    bool (*checks[])() =
+    {
+        TraceCheck,
+        AlarmCheck,
+        ManagerCheck,
+        SpanCheck,
+        FailedReadCheck,
+        FrameCheck,
+        PoolCheck
+    };
+
+    auto failed = false;
+    for (auto check : checks)
+    {
+        if (!check())
+        {
+            failed = true;
+        }
+    }
+
+    return failed ? 1 : 0;
+}
+
 void dump()
 {
     I2CSmbus bus(1, 0x68);
@@ -206,3 +1353,299 @@ void dump()
     dbg.ShowRegister(DS3231RegisterId::TempMsb);
     dbg.ShowRegister(DS3231RegisterId::TempLsb);
 }
+
+//field by field decode with arithmetic BCD, as GetDateTime used to do it
+static byte ArithmeticFromBcd(byte value, byte msbMask, byte lsbMask)
+{
+    return (value & lsbMask) + ((value & msbMask) >> 4) * 10;
+}
+
+static void FieldDecode(const byte* registers, RtcDateTime& value)
+{
+    value.Time.Second = ArithmeticFromBcd(registers[0], DS3231RegisterMasks::SecondsMsb, DS3231RegisterMasks::SecondsLsb);
+    value.Time.Minute = ArithmeticFromBcd(registers[1], DS3231RegisterMasks::MinutesMsb, DS3231RegisterMasks::MinutesLsb);
+
+    if (registers[2] & DS3231RegisterMasks::HourMode)
+    {
+        value.Time.Mode = ClockMode::WallClock;
+        value.Time.Period = (registers[2] & DS3231RegisterMasks::HourPeriod) ? Meridiem::Pm : Meridiem::Am;
+        value.Time.Hour = ArithmeticFromBcd(registers[2], DS3231RegisterMasks::HourWallMsb, DS3231RegisterMasks::HourLsb);
+    }
+    else
+    {
+        value.Time.Mode = ClockMode::MilitaryClock;
+        value.Time.Period = Meridiem::None;
+        value.Time.Hour = ArithmeticFromBcd(registers[2], DS3231RegisterMasks::HourLinearMsb, DS3231RegisterMasks::HourLsb);
+    }
+
+    value.WeekDay = pvt::ToDayOfWeek(registers[3] & DS3231RegisterMasks::WeekDay);
+    value.Day = ArithmeticFromBcd(registers[4], DS3231RegisterMasks::DateMsb, DS3231RegisterMasks::DateLsb);
+    value.Month = pvt::ToMonth(ArithmeticFromBcd(registers[5], DS3231RegisterMasks::MonthMsb, DS3231RegisterMasks::MonthLsb));
+    value.Year = ArithmeticFromBcd(registers[6], DS3231RegisterMasks::YearMsb, DS3231RegisterMasks::YearLsb) +
+        ((registers[5] & DS3231RegisterMasks::MonthCentury) ? 2000 : 1900);
+}
+
+//stringstream formatting, as AsString used to do it
+static std::string StreamFormat(const RtcDateTime& value)
+{
+    static const char* const months[13] =
+    {
+        "?", "Jan", "Feb", "Mar", "Apr", "May", "Jun", "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"
+    };
+
+    std::stringstream txt;
+
+    txt << value.Day << " " << months[int(value.Month)] << " " << value.Year << " ";
+
+    if (value.Time.Mode == ClockMode::WallClock)
+    {
+        txt << value.Time.Hour << ":" << std::setw(2) << std::setfill('0')
+            << value.Time.Minute << ":"
+            << std::setw(2) << std::setfill('0') << value.Time.Second
+            << (value.Time.Period == Meridiem::Pm ? " PM" : " AM");
+    }
+    else
+    {
+        txt << std::setw(2) << std::setfill('0') << value.Time.Hour << ":"
+            << std::setw(2) << std::setfill('0') << value.Time.Minute << ":"
+            << std::setw(2) << std::setfill('0') << value.Time.Second;
+    }
+
+    return txt.str();
+}
+
+template<typename Decoder>
+static double TimeDecode(const byte (*samples)[DS3231TimeCodec::RegisterCount], int sampleCount, int iterations, Decoder decode)
+{
+    RtcDateTime value;
+    volatile int sink = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for (auto idx = 0; idx < iterations; idx++)
+    {
+        decode(samples[idx % sampleCount], value);
+        sink = sink + value.Time.Second + value.Year;
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+
+    return std::chrono::duration<double, std::nano>(elapsed).count() / iterations;
+}
+
+void bench()
+{
+    const int SampleCount = 64;
+    const int Iterations = 10000000;
+
+    byte samples[SampleCount][DS3231TimeCodec::RegisterCount];
+
+    //spread over both hour modes and the whole calendar
+    for (auto idx = 0; idx < SampleCount; idx++)
+    {
+        auto hour = idx % 12 + 1;
+        RtcDateTime value(RtcTime(idx % 2 ? Meridiem::Pm : Meridiem::None,
+                idx % 2 ? hour : idx % 24,
+                (idx * 7) % 60,
+                (idx * 13) % 60,
+                idx % 2 ? ClockMode::WallClock : ClockMode::MilitaryClock),
+            idx % 28 + 1,
+            DayOfWeek(idx % 7 + 1),
+            Months(idx % 12 + 1),
+            1990 + idx);
+
+        DS3231TimeCodec::Encode(value, samples[idx]);
+
+        RtcDateTime fieldValue, tableValue;
+        FieldDecode(samples[idx], fieldValue);
+        DS3231TimeCodec::Decode(samples[idx], tableValue);
+        if (fieldValue.AsString() != tableValue.AsString())
+        {
+            cout << "decode mismatch: " << fieldValue.AsString() << " != " << tableValue.AsString() << endl;
+            return;
+        }
+    }
+
+    auto fieldNs = TimeDecode(samples, SampleCount, Iterations, FieldDecode);
+    auto tableNs = TimeDecode(samples, SampleCount, Iterations, DS3231TimeCodec::Decode);
+
+    printf("field decode: %6.2f ns\n", fieldNs);
+    printf("table decode: %6.2f ns\n", tableNs);
+
+    const int FormatIterations = 1000000;
+
+    RtcDateTime values[SampleCount];
+    for (auto idx = 0; idx < SampleCount; idx++)
+    {
+        DS3231TimeCodec::Decode(samples[idx], values[idx]);
+
+        if (StreamFormat(values[idx]) != values[idx].AsString())
+        {
+            cout << "format mismatch: " << StreamFormat(values[idx]) << " != " << values[idx].AsString() << endl;
+            return;
+        }
+    }
+
+    volatile size_t sink = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for (auto idx = 0; idx < FormatIterations; idx++)
+    {
+        sink = sink + StreamFormat(values[idx % SampleCount]).size();
+    }
+    auto streamNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / FormatIterations;
+
+    char buffer[RtcDateTime::FormatSize];
+
+    start = std::chrono::steady_clock::now();
+    for (auto idx = 0; idx < FormatIterations; idx++)
+    {
+        sink = sink + values[idx % SampleCount].Format(buffer, sizeof(buffer));
+    }
+    auto bufferNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / FormatIterations;
+
+    printf("stream format: %6.2f ns\n", streamNs);
+    printf("buffer format: %6.2f ns\n", bufferNs);
+
+    //the clock stack over a simulated device, the bus costs no time so
+    //this is the CPU overhead per call
+    const int ClockIterations = 1000000;
+
+    DS3231Simulator device(DS3231Simulator::TimeSource::RealTime);
+    I2CSimulatedBus simulatedBus(&device);
+    DS3231RealTimeClock simulatedClock(&simulatedBus);
+    CachedRealTimeClock cachedClock(&simulatedClock);
+
+    simulatedClock.Initialize();
+    simulatedClock.SetDateTime(values[0]);
+    cachedClock.Initialize();
+
+    RtcDateTime now;
+
+    start = std::chrono::steady_clock::now();
+    for (auto idx = 0; idx < ClockIterations; idx++)
+    {
+        simulatedClock.GetDateTime(now);
+        sink = sink + now.Time.Second;
+    }
+    auto deviceNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / ClockIterations;
+    auto deviceTransfers = simulatedBus.Stats().Transfers;
+
+    //the first call anchors with a device read
+    cachedClock.GetDateTime(now);
+    auto transfers = simulatedBus.Stats().Transfers;
+
+    start = std::chrono::steady_clock::now();
+    for (auto idx = 0; idx < ClockIterations; idx++)
+    {
+        cachedClock.GetDateTime(now);
+        sink = sink + now.Time.Second;
+    }
+    auto cachedNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / ClockIterations;
+
+    printf("device read:   %6.2f ns, %llu transfers\n", deviceNs, (unsigned long long)deviceTransfers);
+    printf("cached read:   %6.2f ns, %llu transfers\n", cachedNs, (unsigned long long)(simulatedBus.Stats().Transfers - transfers));
+
+    //the same device read with every bus call counted and timed
+    I2CInstrumentedBus instrumentedBus(&simulatedBus, "simulated");
+    DS3231RealTimeClock instrumentedClock(&instrumentedBus);
+    instrumentedClock.Initialize();
+
+    start = std::chrono::steady_clock::now();
+    for (auto idx = 0; idx < ClockIterations; idx++)
+    {
+        instrumentedClock.GetDateTime(now);
+        sink = sink + now.Time.Second;
+    }
+    auto instrumentedNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / ClockIterations;
+
+    I2CInstrumentedBus::Snapshot snapshot;
+    instrumentedBus.GetSnapshot(snapshot);
+    const auto& submits = snapshot.Operations[int(I2CInstrumentedBus::Operation::Submit)];
+
+    printf("instrumented:  %6.2f ns, p50 %lld ns, p99 %lld ns\n", instrumentedNs,
+           (long long)submits.PercentileNs(0.5), (long long)submits.PercentileNs(0.99));
+
+    //cost of a bus log site on the calling thread, with the level off and
+    //on. Records are formatted by a counting sink between bursts.
+    const int LogBursts = 400;
+    const int LogBurst = 256;
+    byte frame[] = { 0x02, 0xd0, 0x03, 0x00, 0x01, 0x07, 0x03 };
+    uint64_t formatted = 0;
+
+    logging::SetSink([&formatted](const logging::Site&, int64_t, const std::string& text)
+    {
+        formatted += text.size();
+    });
+
+    logging::SetVerbosity(0);
+    start = std::chrono::steady_clock::now();
+    for (auto idx = 0; idx < LogBursts * LogBurst; idx++)
+    {
+        rtcVlogMed("SENDING: {}", logging::Bytes(frame, sizeof(frame)));
+    }
+    auto logOffNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / (LogBursts * LogBurst);
+
+    logging::SetVerbosity(2);
+    std::chrono::steady_clock::duration logTime(0);
+    for (auto burst = 0; burst < LogBursts; burst++)
+    {
+        start = std::chrono::steady_clock::now();
+        for (auto idx = 0; idx < LogBurst; idx++)
+        {
+            rtcVlogMed("SENDING: {}", logging::Bytes(frame, sizeof(frame)));
+        }
+        logTime += std::chrono::steady_clock::now() - start;
+
+        logging::Flush();
+    }
+    auto logOnNs = std::chrono::duration<double, std::nano>(logTime).count() / (LogBursts * LogBurst);
+
+    logging::SetVerbosity(FLAGS_v);
+    logging::SetSink(nullptr);
+
+    printf("log site:      %6.2f ns off, %6.2f ns on, %llu dropped\n", logOffNs, logOnNs, (unsigned long long)logging::Dropped());
+
+    //a control loop step that computes for about as long as a time read
+    //takes on a 100kHz bus, with the read blocking and overlapped
+    const int LoopIterations = 200;
+    const int64_t ComputeNs = 1000000;
+
+    simulatedBus.SetOptions(I2CSimulatedBusOptions::Standard());
+
+    auto compute = [ComputeNs]()
+    {
+        auto until = std::chrono::steady_clock::now() + std::chrono::nanoseconds(ComputeNs);
+        while (std::chrono::steady_clock::now() < until)
+        {
+        }
+    };
+
+    byte registers[DS3231TimeCodec::RegisterCount];
+
+    start = std::chrono::steady_clock::now();
+    for (auto idx = 0; idx < LoopIterations; idx++)
+    {
+        simulatedBus.Receive(0, registers, sizeof(registers));
+        compute();
+    }
+    auto blockingUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / LoopIterations;
+
+    I2CAsyncBus asyncBus(&simulatedBus);
+    asyncBus.Start();
+
+    I2CTransaction transaction;
+    transaction.Read(0, registers, sizeof(registers));
+
+    start = std::chrono::steady_clock::now();
+    for (auto idx = 0; idx < LoopIterations; idx++)
+    {
+        auto read = asyncBus.SubmitAsync(transaction);
+        compute();
+        sink = sink + int(read.get());
+    }
+    auto overlappedUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / LoopIterations;
+
+    asyncBus.Stop();
+
+    printf("blocking step:   %7.1f us\n", blockingUs);
+    printf("overlapped step: %7.1f us\n", overlappedUs);
+}
@@ -3,11 +3,21 @@ CONFIG += console c++11
 CONFIG -= app_bundle
 CONFIG -= qt
 
+#--sessions runs the coroutine clocks, build both projects with
+#qmake CONFIG+=coroutines
+coroutines {
+    CONFIG -= c++11
+    CONFIG += c++2a
+
+    #gcc 10 does not turn coroutines on with the language level
+    *g++*: QMAKE_CXXFLAGS += -fcoroutines
+}
+
 include(../common.pri)
 
 INCLUDEPATH += ../rtcsupport
 
-LIBS += $${VCLOCK_ROOT}/build/rtcsupport/$${CONFIGURATION}/librtcsupport.a -lglog -lgflags -lboost_date_time -lboost_system -lboost_chrono
+LIBS += $${VCLOCK_ROOT}/build/rtcsupport/$${CONFIGURATION}/librtcsupport.a -lglog -lgflags -lpthread
 
 SOURCES += \
     rtctest.cpp